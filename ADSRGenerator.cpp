@@ -1,3 +1,5 @@
+#pragma once
+
 #include <vector>
 #include <unordered_map>
 #include <memory>
@@ -9,7 +11,169 @@
 #include <cstdint>
 #include "SoundGenerator.cpp"
 
+// Linear ADSR envelope state machine. Shared by the runtime ADSRGenerator node
+// and the compile-time compose::ADSR node, and templated on the sample type so
+// both float and double render paths use the same stage logic.
+struct ADSREnvelope {
+    enum class Stage { Idle, Attack, Decay, Sustain, Release };
+
+    float attackTime;
+    float decayTime;
+    float sustainLevel;
+    float releaseTime;
+
+    Stage stage = Stage::Idle;
+    float currentAmplitude = 0.0f;
+    float velocityGain = 1.0f;
+    float releaseStartAmplitude = 0.0f;
+    float attackStartAmplitude = 0.0f;
+    float decayStartAmplitude = 0.0f;
+    uint64_t samplesSinceStageStart = 0;
+    bool active = false;
+
+    ADSREnvelope(float attack, float decay, float sustain, float release)
+        : attackTime(attack), decayTime(decay), sustainLevel(sustain), releaseTime(release) {}
+
+    void noteOn(float velocity) {
+        velocityGain = std::clamp(velocity, 0.0f, 1.0f);
+        stage = Stage::Attack;
+        attackStartAmplitude = currentAmplitude; // Start from current amplitude
+        samplesSinceStageStart = 0;
+        active = true;
+    }
+
+    void noteOff() {
+        Stage preReleaseStage = stage;
+        stage = Stage::Release;
+        samplesSinceStageStart = 0;
+        releaseStartAmplitude = (preReleaseStage == Stage::Sustain) ? sustainLevel : currentAmplitude;
+    }
+
+    bool isIdle() const { return stage == Stage::Idle; }
+
+    float level() const { return active ? currentAmplitude * velocityGain : 0.0f; }
+
+    void stop() { enterIdle(); }
+
+    // Multiplies out[0, frames) by the envelope. Stages are applied in runs so
+    // the steady stages are plain gain loops.
+    template <typename T>
+    void apply(T* out, size_t frames, float sampleRate) {
+        size_t i = 0;
+        while (i < frames) {
+            switch (stage) {
+                case Stage::Attack:
+                    i = applyAttack(out, i, frames, sampleRate);
+                    break;
+                case Stage::Decay:
+                    i = applyDecay(out, i, frames, sampleRate);
+                    break;
+                case Stage::Sustain: {
+                    currentAmplitude = std::clamp(sustainLevel, 0.0f, 1.0f);
+                    const T gain = static_cast<T>(currentAmplitude * velocityGain);
+                    for (; i < frames; ++i) {
+                        out[i] *= gain;
+                    }
+                    break;
+                }
+                case Stage::Release:
+                    i = applyRelease(out, i, frames, sampleRate);
+                    break;
+                case Stage::Idle:
+                    currentAmplitude = 0.0f;
+                    std::fill(out + i, out + frames, T(0));
+                    i = frames;
+                    break;
+            }
+        }
+    }
+
+private:
+    // Each apply* helper renders samples [i, frames) of its stage and returns the
+    // index where the stage ended (or frames). samplesSinceStageStart counts the
+    // samples already spent in the stage, so ramps survive block boundaries.
+    template <typename T>
+    size_t applyAttack(T* out, size_t i, size_t frames, float sampleRate) {
+        if (attackTime <= 0.0f || sampleRate <= 0.0f) {
+            enterDecay();
+            return i;
+        }
+        const float slope = (1.0f - attackStartAmplitude) / (attackTime * sampleRate);
+        for (; i < frames; ++i) {
+            float amplitude = attackStartAmplitude + slope * static_cast<float>(samplesSinceStageStart);
+            if (amplitude >= 1.0f) {
+                enterDecay();
+                out[i] *= static_cast<T>(currentAmplitude * velocityGain);
+                return i + 1;
+            }
+            currentAmplitude = std::max(amplitude, 0.0f);
+            out[i] *= static_cast<T>(currentAmplitude * velocityGain);
+            ++samplesSinceStageStart;
+        }
+        return i;
+    }
+
+    template <typename T>
+    size_t applyDecay(T* out, size_t i, size_t frames, float sampleRate) {
+        if (decayTime <= 0.0f || sampleRate <= 0.0f) {
+            stage = Stage::Sustain;
+            return i;
+        }
+        const float decaySamples = decayTime * sampleRate;
+        const float slope = (decayStartAmplitude - sustainLevel) / decaySamples;
+        for (; i < frames; ++i) {
+            float elapsed = static_cast<float>(samplesSinceStageStart);
+            if (elapsed >= decaySamples) {
+                currentAmplitude = std::clamp(sustainLevel, 0.0f, 1.0f);
+                stage = Stage::Sustain;
+                out[i] *= static_cast<T>(currentAmplitude * velocityGain);
+                return i + 1;
+            }
+            currentAmplitude = std::clamp(decayStartAmplitude - slope * elapsed, 0.0f, 1.0f);
+            out[i] *= static_cast<T>(currentAmplitude * velocityGain);
+            ++samplesSinceStageStart;
+        }
+        return i;
+    }
+
+    template <typename T>
+    size_t applyRelease(T* out, size_t i, size_t frames, float sampleRate) {
+        if (releaseTime <= 0.0f || sampleRate <= 0.0f) {
+            enterIdle();
+            return i;
+        }
+        const float releaseSamples = releaseTime * sampleRate;
+        const float slope = releaseStartAmplitude / releaseSamples;
+        for (; i < frames; ++i) {
+            float elapsed = static_cast<float>(samplesSinceStageStart);
+            if (elapsed >= releaseSamples) {
+                enterIdle();
+                out[i] = T(0);
+                return i + 1;
+            }
+            currentAmplitude = std::clamp(releaseStartAmplitude - slope * elapsed, 0.0f, 1.0f);
+            out[i] *= static_cast<T>(currentAmplitude * velocityGain);
+            ++samplesSinceStageStart;
+        }
+        return i;
+    }
+
+    void enterDecay() {
+        currentAmplitude = 1.0f;
+        stage = Stage::Decay;
+        samplesSinceStageStart = 0;
+        decayStartAmplitude = currentAmplitude;
+    }
+
+    void enterIdle() {
+        currentAmplitude = 0.0f;
+        stage = Stage::Idle;
+        active = false;
+    }
+};
+
 class ADSRGenerator : public SoundGenerator {
+    friend class VoiceCompiler;
 public:
     ADSRGenerator(std::shared_ptr<SoundGenerator> source,
                   float attack = 0.1f,
@@ -17,66 +181,57 @@ public:
                   float sustain = 0.7f,
                   float release = 0.3f)
         : sourceGenerator(source),
-          attackTime(attack),
-          decayTime(decay),
-          sustainLevel(sustain),
-          releaseTime(release),
-          stage(Stage::Idle),
-          currentAmplitude(0.0f),
-          velocityGain(1.0f),
-          active(false),
-          deactivationRequested(false) {
-        
+          envelope(attack, decay, sustain, release) {
+
         // Initialize ADSR parameters with callbacks
         Attack = addParam(std::make_unique<Parameter>("Attack", attack, 0.01f, 10.0f, 0.01f, "s", [this](float newValue) {
-            attackTime = newValue;
+            envelope.attackTime = newValue;
         }));
         Decay = addParam(std::make_unique<Parameter>("Decay", decay, 0.01f, 10.0f, 0.01f, "s", [this](float newValue) {
-            decayTime = newValue;
+            envelope.decayTime = newValue;
         }));
         Sustain = addParam(std::make_unique<Parameter>("Sustain", sustain, 0.0f, 1.0f, 0.01f, "", [this](float newValue) {
-            sustainLevel = newValue;
+            envelope.sustainLevel = newValue;
         }));
         Release = addParam(std::make_unique<Parameter>("Release", release, 0.01f, 10.0f, 0.01f, "s", [this](float newValue) {
-            releaseTime = newValue;
+            envelope.releaseTime = newValue;
         }));
 
         // Add child generator
         addChildGenerator(sourceGenerator);
     }
 
-    float generateSample(float sampleRate) override {
-        if (stage == Stage::Idle) {
-            return 0.0f;
+    void process(float* out, size_t frames, float sampleRate) override {
+        if (envelope.isIdle()) {
+            std::fill(out, out + frames, 0.0f);
+            return;
         }
 
-        float sample = sourceGenerator->generateSample(sampleRate);
-
-        // Update envelope on every sample for accurate timing
-        updateEnvelope(sampleRate);
-
-        return sample * currentAmplitude * velocityGain;
+        sourceGenerator->render(out, frames, sampleRate);
+        envelope.apply(out, frames, sampleRate);
     }
 
     void noteOn(float velocity) override {
-        velocityGain = std::clamp(velocity, 0.0f, 1.0f);
-        sourceGenerator->noteOn(velocityGain);
-        stage = Stage::Attack;
-        attackStartAmplitude = currentAmplitude; // Start from current amplitude
-        samplesSinceStageStart = 0;
-        active = true;
+        sourceGenerator->noteOn(std::clamp(velocity, 0.0f, 1.0f));
+        envelope.noteOn(velocity);
     }
 
     void noteOff() override {
         sourceGenerator->noteOff();
-        Stage preReleaseStage = stage;
-        stage = Stage::Release;
-        samplesSinceStageStart = 0;
-        releaseStartAmplitude = (preReleaseStage == Stage::Sustain) ? sustainLevel : currentAmplitude;
+        envelope.noteOff();
+    }
+
+    bool isActive() const override {
+        return envelope.active;
+    }
+
+    float getLevel() const override {
+        return envelope.level();
     }
 
-    bool isActive() const {
-        return active;
+    void stop() override {
+        sourceGenerator->stop();
+        envelope.stop();
     }
 
     // Expose ADSR parameters
@@ -86,85 +241,6 @@ public:
     std::shared_ptr<Parameter> Release;
 
 private:
-    enum class Stage { Idle, Attack, Decay, Sustain, Release };
-
     std::shared_ptr<SoundGenerator> sourceGenerator;
-
-    float attackTime;
-    float decayTime;
-    float sustainLevel;
-    float releaseTime;
-
-    Stage stage;
-    float currentAmplitude;
-    float velocityGain;
-    float releaseStartAmplitude;
-    float attackStartAmplitude;
-    float decayStartAmplitude;
-    uint64_t samplesSinceStageStart;
-
-    bool active;
-    bool deactivationRequested;
-
-    void updateEnvelope(float sampleRate) {
-        Stage previousStage = stage;
-        float elapsedSeconds = (sampleRate > 0.0f) ? (static_cast<float>(samplesSinceStageStart) / sampleRate) : 0.0f;
-
-        switch (stage) {
-            case Stage::Attack:
-                if (attackTime > 0.0f) {
-                    currentAmplitude = attackStartAmplitude + (1.0f - attackStartAmplitude) * (elapsedSeconds / attackTime);
-                    if (currentAmplitude >= 1.0f) {
-                        currentAmplitude = 1.0f;
-                        stage = Stage::Decay;
-                        samplesSinceStageStart = 0;
-                        decayStartAmplitude = currentAmplitude; // Set decay start amplitude
-                    }
-                } else {
-                    currentAmplitude = 1.0f;
-                    stage = Stage::Decay;
-                    samplesSinceStageStart = 0;
-                    decayStartAmplitude = currentAmplitude; // Set decay start amplitude
-                }
-                break;
-            case Stage::Decay:
-                if (decayTime > 0.0f) {
-                    currentAmplitude = decayStartAmplitude - (decayStartAmplitude - sustainLevel) * (elapsedSeconds / decayTime);
-                    if (elapsedSeconds >= decayTime) {
-                        currentAmplitude = sustainLevel;
-                        stage = Stage::Sustain;
-                    }
-                } else {
-                    currentAmplitude = sustainLevel;
-                    stage = Stage::Sustain;
-                }
-                break;
-            case Stage::Sustain:
-                currentAmplitude = sustainLevel;
-                break;
-            case Stage::Release:
-                if (releaseTime > 0.0f) {
-                    currentAmplitude = releaseStartAmplitude * (1.0f - (elapsedSeconds / releaseTime));
-                    if (elapsedSeconds >= releaseTime) {
-                        currentAmplitude = 0.0f;
-                        stage = Stage::Idle;
-                        active = false;
-                    }
-                } else {
-                    currentAmplitude = 0.0f;
-                    stage = Stage::Idle;
-                    active = false;
-                }
-                break;
-            case Stage::Idle:
-                currentAmplitude = 0.0f;
-                break;
-        }
-
-        currentAmplitude = std::clamp(currentAmplitude, 0.0f, 1.0f);
-
-        if (stage == previousStage && stage != Stage::Idle) {
-            ++samplesSinceStageStart;
-        }
-    }
+    ADSREnvelope envelope;
 };
@@ -1,13 +1,27 @@
 #pragma once
 
 #include <vector>
+#include <array>
+#include <unordered_map>
+#include <unordered_set>
 #include <memory>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <mutex>
+#include <thread>
+#include <condition_variable>
 #include <iostream>
 #include <functional>
 #include <cmath>
 #include <random>
 #include "SoundGenerator.cpp"
+#include "VoiceCompiler.cpp"
+#include "SimdVoices.cpp"
+#include "LockFreeQueue.cpp"
+#include "Smoothing.cpp"
+#include "ParameterRegistry.cpp"
+#include "VoiceRenderPool.cpp"
 
 // Total number of MIDI notes
 constexpr int MIDI_NOTE_COUNT = 128;
@@ -15,26 +29,114 @@ constexpr int MIDI_NOTE_COUNT = 128;
 // Predefine maximum channels if needed
 // constexpr int MAX_CHANNELS = 16;
 
+// Which sounding voice gives way when a note arrives at full polyphony
+enum class VoiceStealMode { Oldest, Quietest };
+
+// A note change sent from a control thread (MIDI, keyboard, HTTP) to the audio thread
+struct NoteEvent {
+    enum class Type : uint8_t { NoteOn, NoteOff };
+
+    Type type = Type::NoteOn;
+    uint8_t note = 0;
+    float velocity = 0.0f;
+    int64_t timestamp = 0; // steady_clock nanoseconds; 0 plays at the start of the next block
+};
+
+inline int64_t noteEventClock() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Threading: noteOn/noteOff and the preset setters run on control threads and
+// only push to lock-free queues or swap pointers. process() runs on the audio
+// thread and takes no locks; it drains the note queue once per block and
+// adopts a newly built voice set at the block boundary. The replaced set keeps
+// rendering until its sounding notes have finished their release, so only new
+// notes use the new preset.
 class ActiveTones : public SoundGenerator {
 public:
     using SoundGeneratorFactory = std::function<std::shared_ptr<SoundGenerator>(float frequency, float volume)>;
+    using ReadyCallback = std::function<void()>;
 
-    ActiveTones(SoundGeneratorFactory factory) : smoothedGainFactor(1.0f) {
+    ActiveTones(SoundGeneratorFactory factory) {
         setVoiceGenerator(factory);
     }
 
-    float generateSample(float sampleRate) override {
-        std::lock_guard<std::mutex> lock(tonesMutex);
-        float sample = 0.0f;
-        int loudToneCount = 0;
+    ~ActiveTones() override {
+        {
+            std::lock_guard<std::mutex> lock(buildMutex);
+            stopBuilder = true;
+        }
+        buildRequested.notify_one();
+        if (builderThread.joinable()) {
+            builderThread.join();
+        }
+        // Nothing renders or applies parameter changes any more, so every set
+        // can go at once
+        delete pendingVoices.exchange(nullptr);
+        VoiceSet* retired = nullptr;
+        while (retiredVoices.pop(retired)) {
+            delete retired;
+        }
+        for (VoiceSet* voiceSet : retiringVoices) {
+            delete voiceSet;
+        }
+        for (size_t i = 0; i < drainingCount; ++i) {
+            delete drainingVoices[i];
+        }
+        delete liveVoices;
+        delete pendingRenderPool.exchange(nullptr);
+        collectRetiredRenderPools();
+        delete renderPool;
+    }
+
+    // Only the voices in soundingVoices are rendered, so a 2-note passage costs
+    // 2 voices. Voices leave the list once their envelope (and any delay tail)
+    // has finished, or when a steal fade reaches zero, and return to the pool.
+    void process(float* out, size_t frames, float sampleRate) override {
+        adoptPendingVoices();
+        adoptRenderPool();
+        currentSampleRate = sampleRate;
+        std::fill(out, out + frames, 0.0f);
+
+        // Events are placed at their timestamp's offset within the previous
+        // block period, giving a constant one-block latency instead of jitter.
+        // Offsets snap to EVENT_GRID_FRAMES so a burst of events does not
+        // split the block into dozens of tiny renders.
+        const int64_t blockStart = noteEventClock();
+        const double framesPerNanosecond = sampleRate * 1e-9;
+        size_t rendered = 0;
+        NoteEvent event;
+        while (noteEvents.pop(event)) {
+            size_t offset = 0;
+            if (event.timestamp > previousBlockStart && previousBlockStart > 0) {
+                offset = static_cast<size_t>((event.timestamp - previousBlockStart) * framesPerNanosecond);
+                offset = std::min(offset - offset % EVENT_GRID_FRAMES, frames - 1);
+            }
+            if (offset > rendered) {
+                renderAllVoices(out + rendered, offset - rendered, sampleRate);
+                rendered = offset;
+            }
+            applyNoteEvent(event);
+        }
+        renderAllVoices(out + rendered, frames - rendered, sampleRate);
+        previousBlockStart = blockStart;
 
-        for (auto& adsrGenerator : activeTones) {
-            float temp_sample = adsrGenerator->generateSample(sampleRate);
-            sample += temp_sample;
-            if (std::fabs(temp_sample) > 1e-4f) { // gate out very quiet voices (~-80 dB)
-                ++loudToneCount;
+        size_t sounding = retireFinishedVoices(*liveVoices);
+        for (size_t i = 0; i < drainingCount;) {
+            if (retireFinishedVoices(*drainingVoices[i]) == 0) {
+                removeDrainingSet(i);
+            } else {
+                sounding += drainingVoices[i]->soundingVoices.size();
+                ++i;
             }
         }
+        soundingVoiceCount.store(sounding, std::memory_order_relaxed);
+
+        int loudToneCount = countLoudVoices(*liveVoices);
+        for (size_t i = 0; i < drainingCount; ++i) {
+            loudToneCount += countLoudVoices(*drainingVoices[i]);
+        }
 
         // 1/sqrt(N_loud) normalization
         float targetGainFactor = 1.0f;
@@ -42,16 +144,11 @@ public:
             targetGainFactor = 1.0f / std::sqrt(static_cast<float>(loudToneCount));
         }
 
-        // Time-constant smoothing (~10 ms), sample-rate aware
-        const float tauSeconds = 0.010f;
-        float alpha = 0.0f;
-        if (sampleRate > 0.0f) {
-            alpha = std::exp(-1.0f / (tauSeconds * sampleRate));
+        normalizationGain.setTarget(targetGainFactor);
+        BlockRamp gain = normalizationGain.nextBlock(frames, sampleRate);
+        for (size_t i = 0; i < frames; ++i) {
+            out[i] *= gain.next();
         }
-        smoothedGainFactor = alpha * smoothedGainFactor + (1.0f - alpha) * targetGainFactor;
-
-        sample *= smoothedGainFactor;
-        return sample;
     }
 
     void noteOn(int midiNote, int channel, float frequency, float volume) {
@@ -60,10 +157,10 @@ public:
             return;
         }
 
-        std::lock_guard<std::mutex> lock(tonesMutex);
-        auto& adsrGenerator = activeTones[midiNote];
-        adsrGenerator->noteOn(volume);
-        std::cout << "Activated ADSRGenerator for MIDI Note " << midiNote << std::endl;
+        if (pushNoteEvent({NoteEvent::Type::NoteOn, static_cast<uint8_t>(midiNote), volume, noteEventClock()})) {
+            std::cout << "Activated ADSRGenerator for MIDI Note " << midiNote << std::endl;
+        }
+        ensurePoolCapacity();
     }
 
     void noteOff(int midiNote, int channel) {
@@ -72,10 +169,23 @@ public:
             return;
         }
 
-        std::lock_guard<std::mutex> lock(tonesMutex);
-        auto& adsrGenerator = activeTones[midiNote];
-        adsrGenerator->noteOff();
-        std::cout << "Deactivated ADSRGenerator for MIDI Note " << midiNote << std::endl;
+        if (pushNoteEvent({NoteEvent::Type::NoteOff, static_cast<uint8_t>(midiNote), 0.0f, noteEventClock()})) {
+            std::cout << "Deactivated ADSRGenerator for MIDI Note " << midiNote << std::endl;
+        }
+    }
+
+    // Lock-free; callable from any thread. Fails when the note is not a MIDI
+    // note (0..127) or the queue is full.
+    bool pushNoteEvent(const NoteEvent& event) {
+        if (event.note >= MIDI_NOTE_COUNT) {
+            std::cerr << "Invalid MIDI Note: " << static_cast<int>(event.note) << std::endl;
+            return false;
+        }
+        if (!noteEvents.push(event)) {
+            std::cerr << "Note event queue full, dropped MIDI Note " << static_cast<int>(event.note) << std::endl;
+            return false;
+        }
+        return true;
     }
 
     // Override base class virtual methods to avoid hiding warnings
@@ -89,80 +199,781 @@ public:
         // This overrides the base class virtual method
     }
 
+    // Builds a pool of maxPolyphony (plus steal headroom) voices for the
+    // preset. Voices are tuned to a note when they are taken from the pool,
+    // so memory follows the polyphony, not the MIDI range.
     void setVoiceGenerator(const SoundGeneratorFactory& newVoiceGenerator) {
-        std::lock_guard<std::mutex> lock(tonesMutex);
-        
-        parameterPointers.clear();
-        parameters.clear();
-        childGenerators.clear();
-        // Reinitialize all SoundGenerators with the new factory
-        for (int note = 0; note < MIDI_NOTE_COUNT; ++note) {
-            float frequency = midiNoteToFrequency(note);
-            
-            // Add slight random frequency offset to reduce phase coherence and beating
-            static std::random_device rd;
-            static std::mt19937 gen(rd());
-            std::uniform_real_distribution<float> detune(-0.001f, 0.001f);
-            float randomDetune = detune(gen);
-            float detuned_frequency = frequency * (1.0f + randomDetune);
-            
-            activeTones[note] = std::shared_ptr<SoundGenerator>(newVoiceGenerator(detuned_frequency, 1.0f));
-        }
-        
-        // Group parameters by name
-        std::unordered_map<std::string, std::vector<Parameter*>> paramGroups;
-        for (auto& adsrGenerator : activeTones) {
+        std::lock_guard<std::mutex> lock(controlMutex);
+        buildVoiceSet(newVoiceGenerator, nullptr);
+    }
+
+    void buildVoiceSet(const SoundGeneratorFactory& newVoiceGenerator, const ParameterRegistry* carryOver) {
+        collectRetiredVoices();
+        currentFactory = newVoiceGenerator;
+
+        const int poolSize = std::min(maxPolyphony.load(std::memory_order_relaxed) + POOL_HEADROOM, MIDI_NOTE_COUNT);
+        auto voiceSet = std::make_unique<VoiceSet>(poolSize);
+        buildVoices(*voiceSet, newVoiceGenerator);
+
+        // Group parameters by name, taking the first match in each voice.
+        // Groups are numbered in the order the first voice lists them, which
+        // becomes their ParameterId.
+        std::unordered_map<std::string, size_t> groupIndex;
+        std::vector<std::vector<Parameter*>> groups;
+        for (auto& adsrGenerator : voiceSet->voices) {
+            std::unordered_set<std::string> seen;
             for (auto* param : adsrGenerator->getParameters()) {
-                paramGroups[param->getName()].push_back(param);
+                if (!seen.insert(param->getName()).second) {
+                    continue;
+                }
+                auto [it, added] = groupIndex.emplace(param->getName(), groups.size());
+                if (added) {
+                    groups.emplace_back();
+                    groups.back().reserve(voiceSet->voices.size());
+                }
+                groups[it->second].push_back(param);
             }
         }
 
-        // Generate a Param for each group
-        for (const auto& [paramName, params] : paramGroups) {
-            if (!params.empty()) {
-                auto& firstParam = *params[0];
-                addParam(std::make_unique<Parameter>(
-                    paramName,
-                    firstParam.getValue(),
-                    firstParam.getMinValue(),
-                    firstParam.getMaxValue(),
-                    firstParam.getStepSize(),
-                    firstParam.getUnit(),
-                    [this, paramName](float value) {
-                        updateAllNotesParameter(paramName, value);
-                    }
-                ));
+        // Generate a Param for each group. Its callback runs on the audio
+        // thread (see applyParameterChanges) and fans out to every note.
+        auto registry = std::make_shared<ParameterRegistry>();
+        const ParameterRegistry* fanOut = registry.get();
+        for (auto& targets : groups) {
+            const Parameter& firstParam = *targets[0];
+            const ParameterId id = static_cast<ParameterId>(registry->size());
+            registry->add(std::make_shared<Parameter>(
+                firstParam.getName(),
+                firstParam.getValue(),
+                firstParam.getMinValue(),
+                firstParam.getMaxValue(),
+                firstParam.getStepSize(),
+                firstParam.getUnit(),
+                [fanOut, id](float value) { fanOut->broadcast(id, value); }
+            ), std::move(targets));
+        }
+        addPolyphonyParameter(*registry);
+
+        // A pool resize keeps the values the user has dialled in
+        if (carryOver) {
+            for (ParameterId id = 0; id < registry->size(); ++id) {
+                Parameter* param = registry->get(id);
+                if (const Parameter* previous = carryOver->get(param->getName())) {
+                    param->setValue(previous->getValue());
+                }
             }
         }
 
-        // Debug: Print all parameters
-        std::cout << "ActiveTones parameters after initialization:" << std::endl;
-        for (const auto* param : getParameters()) {
-            std::cout << "  " << param->getName() << " = " << param->getValue() << std::endl;
+        poolCapacity.store(poolSize, std::memory_order_relaxed);
+        publishVoices(std::move(voiceSet), std::move(registry));
+    }
+
+    // Same as setVoiceGenerator, but builds on the background builder thread
+    // and returns at once. onReady runs on that thread once the new voices are
+    // published (the audio thread adopts them at its next block). A switch
+    // still waiting when a newer one arrives is dropped.
+    void setVoiceGeneratorAsync(SoundGeneratorFactory factory, ReadyCallback onReady = nullptr) {
+        scheduleBuild([this, factory = std::move(factory)]() { setVoiceGenerator(factory); }, std::move(onReady));
+    }
+
+    void setSimdVoiceGeneratorAsync(SimdVoiceSpec spec, ReadyCallback onReady = nullptr) {
+        scheduleBuild([this, spec]() { setSimdVoiceGenerator(spec); }, std::move(onReady));
+    }
+
+    // Threads used to construct the 128 voices of a preset; 1 builds serially
+    void setVoiceBuildThreads(unsigned threads) {
+        buildThreads.store(std::max(threads, 1u), std::memory_order_relaxed);
+    }
+
+    // Threads that render the sounding voices of each block, the audio thread
+    // included; 1 renders serially. The output does not depend on the count.
+    // Control thread; the audio thread switches pools at its next block.
+    void setRenderThreads(unsigned threads) {
+        std::lock_guard<std::mutex> lock(controlMutex);
+        collectRetiredRenderPools();
+        delete pendingRenderPool.exchange(new VoiceRenderPool(threads), std::memory_order_acq_rel);
+    }
+
+    // Switches to the structure-of-arrays SIMD engine for presets it can render
+    void setSimdVoiceGenerator(const SimdVoiceSpec& spec) {
+        std::lock_guard<std::mutex> lock(controlMutex);
+        collectRetiredVoices();
+
+        // The bank keeps one lane per note; its state is a few floats per lane
+        auto voiceSet = std::make_unique<VoiceSet>(MIDI_NOTE_COUNT);
+        auto registry = std::make_shared<ParameterRegistry>();
+        voiceSet->simdVoices = std::make_unique<SimdVoiceBank>(spec);
+        for (int note = 0; note < MIDI_NOTE_COUNT; ++note) {
+            voiceSet->simdVoices->setFrequency(note, detunedFrequency(note));
+        }
+        currentFactory = nullptr;
+
+        // Same names and ranges as the ADSRGenerator / FMVoice parameters
+        SimdVoiceBank* bank = voiceSet->simdVoices.get();
+        if (bank->usesFrequencyModulation()) {
+            registry->add(std::make_shared<Parameter>("Modulator Frequency Ratio", spec.modulatorRatio, 0.1f, 10.0f, 0.01f, "",
+                [bank](float value) { bank->setModulatorRatio(value); }));
+            registry->add(std::make_shared<Parameter>("Modulation Index", spec.modulationIndex, 0.0f, 10.0f, 0.01f, "",
+                [bank](float value) { bank->setModulationIndex(value); }));
+            registry->add(std::make_shared<Parameter>("Self Modulation Index", spec.selfModulationIndex, 0.0f, 10.0f, 0.01f, "",
+                [bank](float value) { bank->setSelfModulationIndex(value); }));
         }
+        registry->add(std::make_shared<Parameter>("Attack", spec.attack, 0.01f, 10.0f, 0.01f, "s",
+            [bank](float value) { bank->setAttack(value); }));
+        registry->add(std::make_shared<Parameter>("Decay", spec.decay, 0.01f, 10.0f, 0.01f, "s",
+            [bank](float value) { bank->setDecay(value); }));
+        registry->add(std::make_shared<Parameter>("Sustain", spec.sustain, 0.0f, 1.0f, 0.01f, "",
+            [bank](float value) { bank->setSustain(value); }));
+        registry->add(std::make_shared<Parameter>("Release", spec.release, 0.01f, 10.0f, 0.01f, "s",
+            [bank](float value) { bank->setRelease(value); }));
+        addPolyphonyParameter(*registry);
+
+        poolCapacity.store(MIDI_NOTE_COUNT, std::memory_order_relaxed);
+        voiceBankStats = {};
+        std::cout << "SIMD voice bank: " << SimdVoiceBank::VOICE_COUNT << " voices, " << SimdFloat::width
+                  << " lanes" << std::endl;
+        publishVoices(std::move(voiceSet), std::move(registry));
+    }
+
+    // Caps the number of sounding voices; further notes steal one (see
+    // VoiceStealMode). Raising it beyond the voice pool rebuilds the pool in
+    // the background at the next noteOn; until then the pool is the limit.
+    void setMaxPolyphony(int voices) {
+        maxPolyphony.store(std::clamp(voices, 1, MIDI_NOTE_COUNT), std::memory_order_relaxed);
+    }
+
+    void setVoiceStealMode(VoiceStealMode mode) {
+        stealMode.store(mode, std::memory_order_relaxed);
+    }
+
+    // Name -> ID lookup and per-ID access for the current preset. Resolve an
+    // ID once and keep it until the preset changes. This immutable snapshot
+    // is the preset's parameter list for control threads; ActiveTones lists
+    // no parameters through SoundGenerator::getParameters(), which the
+    // builder would otherwise change under them. Hold it only while using it:
+    // a replaced preset is freed once no one holds its registry.
+    std::shared_ptr<const ParameterRegistry> getParameterRegistry() const {
+        return std::atomic_load(&parameterRegistry);
+    }
+
+    // Number of voices rendered in the last block, including release tails
+    size_t getSoundingVoiceCount() const {
+        return soundingVoiceCount.load(std::memory_order_relaxed);
+    }
+
+    // Voices in the current pool (MIDI_NOTE_COUNT lanes for SIMD presets)
+    int getPoolCapacity() const {
+        return poolCapacity.load(std::memory_order_relaxed);
+    }
+
+    // Arena usage of the current voice pool; all zero for SIMD presets, whose
+    // bank is a single heap object
+    VoiceArena::Stats getVoiceBankStats() {
+        std::lock_guard<std::mutex> lock(controlMutex);
+        return voiceBankStats;
     }
 private:
-    std::array<std::shared_ptr<SoundGenerator>, MIDI_NOTE_COUNT> activeTones;
-    std::mutex tonesMutex;
-    float smoothedGainFactor{1.0f};
+    // Stolen voices fade out over this long before they are cut off
+    static constexpr float STEAL_FADE_SECONDS = 0.005f;
+    static constexpr size_t NOTE_EVENT_CAPACITY = 1024;
+    static constexpr size_t EVENT_GRID_FRAMES = 16;
+    static constexpr int DEFAULT_POLYPHONY = 32;
+    // Extra pool voices so stolen voices can finish their fade-out
+    static constexpr int POOL_HEADROOM = 4;
+    // Pool voices are built at this pitch and retuned per note
+    static constexpr float POOL_BUILD_FREQUENCY = 440.0f;
+    static constexpr uint64_t UNKNOWN_PARAMETER_BATCH = UINT64_MAX;
 
-    float midiNoteToFrequency(int midiNote) const {
-        // Convert MIDI note number to frequency
-        return 440.0f * std::pow(2.0f, (midiNote - 69) / 12.0f);
+    // Own cache line: voices rendered on different threads update their
+    // slot's fade gain
+    struct alignas(64) VoiceSlot {
+        int note = -1;           // MIDI note this voice is playing
+        uint64_t startOrder = 0; // noteOn sequence number, for oldest-first stealing
+        float fadeGain = 1.0f;
+        float fadeStep = 0.0f;   // per-sample gain change while fading out (stolen) or back in
+        bool stolen = false;
+    };
+
+    // Everything the audio thread renders for one preset. Built on a control
+    // thread, handed over through pendingVoices and from then on only touched
+    // by the audio thread, parameter callbacks included. Voices are indexed
+    // by pool position; the SIMD bank uses the MIDI note as its lane.
+    struct VoiceSet {
+        // One per build thread; declared first so the voices built in them go first
+        std::vector<std::unique_ptr<VoiceArena>> arenas;
+        std::vector<std::shared_ptr<SoundGenerator>> voices; // the pool; empty with simdVoices
+        std::unique_ptr<SimdVoiceBank> simdVoices;           // replaces voices when set
+        std::vector<VoiceSlot> slots;                        // per voice
+        std::vector<float> voiceFrequencies;                 // pitch each pool voice is tuned to
+        std::vector<int> freeVoices;                         // idle pool voices
+        std::vector<int> soundingVoices;                     // voices to render, in no particular order
+        std::array<int, MIDI_NOTE_COUNT> noteVoices;         // voice playing each note, -1 if none
+        std::array<float, MIDI_NOTE_COUNT> noteFrequencies;  // detuned pitch of each note
+        std::shared_ptr<const ParameterRegistry> registry; // its fan-out targets point into voices
+        // Once retired: parameter batches the audio thread must have applied
+        // before this set may be freed (see collectRetiredVoices)
+        uint64_t lastParameterBatch = UNKNOWN_PARAMETER_BATCH;
+
+        explicit VoiceSet(int voiceCount)
+            : slots(voiceCount), voiceFrequencies(voiceCount, POOL_BUILD_FREQUENCY) {
+            soundingVoices.reserve(voiceCount);
+            freeVoices.reserve(voiceCount);
+            noteVoices.fill(-1);
+        }
+    };
+
+    struct RenderTask {
+        VoiceSet* voiceSet;
+        int voice;
+    };
+
+    struct alignas(64) VoiceBlock {
+        std::array<float, MAX_BLOCK_FRAMES> samples;
+    };
+
+    std::mutex controlMutex; // serializes preset switches between control threads; never taken by process()
+    LockFreeQueue<NoteEvent, NOTE_EVENT_CAPACITY> noteEvents;
+    std::atomic<VoiceSet*> pendingVoices{nullptr};
+    LockFreeQueue<VoiceSet*, 8> retiredVoices; // replaced sets, handed to a control thread to free
+    std::vector<VoiceSet*> retiringVoices;     // guarded by controlMutex; retired, waiting to be freed
+    std::atomic<VoiceRenderPool*> pendingRenderPool{nullptr};
+    LockFreeQueue<VoiceRenderPool*, 4> retiredRenderPools; // their threads are joined off the audio thread
+    std::atomic<int> maxPolyphony{DEFAULT_POLYPHONY};
+    std::atomic<int> poolCapacity{0};
+    std::atomic<bool> poolResizePending{false};
+    SoundGeneratorFactory currentFactory; // guarded by controlMutex; null for SIMD presets
+    VoiceArena::Stats voiceBankStats;     // guarded by controlMutex
+    std::atomic<VoiceStealMode> stealMode{VoiceStealMode::Oldest};
+    std::atomic<size_t> soundingVoiceCount{0};
+    std::atomic<unsigned> buildThreads{std::max(std::thread::hardware_concurrency(), 1u)};
+    std::shared_ptr<const ParameterRegistry> parameterRegistry; // accessed with std::atomic_load/store
+
+    // Background builder; holds at most one waiting preset switch and one pool resize
+    std::mutex buildMutex;
+    std::condition_variable buildRequested;
+    std::function<void()> pendingBuild;
+    ReadyCallback pendingBuildReady;
+    bool pendingResize = false;
+    bool stopBuilder = false;
+    std::thread builderThread;
+
+    // Audio thread state
+    static constexpr size_t MAX_DRAINING_SETS = 4;
+    static constexpr size_t MAX_RENDER_TASKS = MIDI_NOTE_COUNT * (MAX_DRAINING_SETS + 1);
+    VoiceSet* liveVoices = nullptr;
+    // Replaced sets whose notes are still ringing out, oldest first
+    std::array<VoiceSet*, MAX_DRAINING_SETS> drainingVoices{};
+    size_t drainingCount = 0;
+    SmoothedValue normalizationGain{1.0f, RampCurve::OnePole, 0.010f}; // ~10 ms time constant
+    VoiceRenderPool* renderPool = nullptr; // null renders serially
+    std::array<RenderTask, MAX_RENDER_TASKS> renderTasks;
+    std::vector<VoiceBlock> voiceBlocks{MAX_RENDER_TASKS}; // one output block per task
+    size_t renderFrames = 0;                             // of the current renderTasks
+    float renderSampleRate = 44100.0f;
+    int renderProfileSlot = NodeProfiler::NO_SLOT;       // parent of the voices in the node profile
+    uint64_t noteOnCounter = 0;
+    float currentSampleRate = 44100.0f;
+    int64_t previousBlockStart = 0;
+
+    // The registry was filled privately by the builder; from here on it is
+    // immutable and the only way control threads reach the preset's parameters
+    void publishVoices(std::unique_ptr<VoiceSet> voiceSet, std::shared_ptr<ParameterRegistry> registry) {
+        registry->setStructureVersion(nextParameterVersion());
+        voiceSet->registry = registry;
+        std::atomic_store(&parameterRegistry, std::shared_ptr<const ParameterRegistry>(std::move(registry)));
+        // A set that was never adopted still had its registry published, so
+        // changes may be queued for it; it waits in retiringVoices like any other
+        if (VoiceSet* displaced = pendingVoices.exchange(voiceSet.release(), std::memory_order_acq_rel)) {
+            retiringVoices.push_back(displaced);
+        }
+    }
+
+    // Replaces a switch that is still waiting; a waiting resize is kept
+    void scheduleBuild(std::function<void()> build, ReadyCallback onReady) {
+        {
+            std::lock_guard<std::mutex> lock(buildMutex);
+            pendingBuild = std::move(build);
+            pendingBuildReady = std::move(onReady);
+            startBuilder();
+        }
+        buildRequested.notify_one();
     }
 
+    void scheduleResize() {
+        {
+            std::lock_guard<std::mutex> lock(buildMutex);
+            pendingResize = true;
+            startBuilder();
+        }
+        buildRequested.notify_one();
+    }
 
-    void updateAllNotesParameter(const std::string& paramName, float newValue) {
-        // Update all notes, regardless of their active state
+    // Under buildMutex
+    void startBuilder() {
+        if (!builderThread.joinable()) {
+            builderThread = std::thread([this]() { runBuilder(); });
+        }
+    }
 
-        //TODO can crash if note is disposed after loop starts
-        for (auto& adsrGenerator : activeTones) {
-            for (auto* param : adsrGenerator->getParameters()) {
-                if (param->getName() == paramName) {
-                    param->setValue(newValue);
-                    break;
+    // A waiting switch absorbs a waiting resize: buildVoiceSet sizes the new
+    // pool from the polyphony current when it runs.
+    void runBuilder() {
+        std::unique_lock<std::mutex> lock(buildMutex);
+        while (true) {
+            buildRequested.wait(lock, [this]() { return stopBuilder || pendingBuild || pendingResize; });
+            if (stopBuilder) {
+                return;
+            }
+            auto build = std::move(pendingBuild);
+            auto onReady = std::move(pendingBuildReady);
+            const bool resize = pendingResize;
+            pendingBuild = nullptr;
+            pendingBuildReady = nullptr;
+            pendingResize = false;
+            lock.unlock();
+            if (build) {
+                build();
+                if (resize) {
+                    poolResizePending = false;
+                }
+                if (onReady) {
+                    onReady();
+                }
+            } else {
+                resizePool();
+            }
+            lock.lock();
+        }
+    }
+
+    // Constructs and compiles the pool voices, split across buildThreads.
+    // Note frequencies are drawn up front so the detune RNG stays on this thread.
+    void buildVoices(VoiceSet& voiceSet, const SoundGeneratorFactory& factory) {
+        for (int note = 0; note < MIDI_NOTE_COUNT; ++note) {
+            voiceSet.noteFrequencies[note] = detunedFrequency(note);
+        }
+        const int voiceCount = static_cast<int>(voiceSet.slots.size());
+        voiceSet.voices.resize(voiceCount);
+        for (int voice = voiceCount - 1; voice >= 0; --voice) {
+            voiceSet.freeVoices.push_back(voice);
+        }
+        const int threads = std::min(static_cast<int>(buildThreads.load(std::memory_order_relaxed)), voiceCount);
+        for (int t = 0; t < threads; ++t) {
+            voiceSet.arenas.push_back(std::make_unique<VoiceArena>());
+        }
+        auto buildRange = [&](int first, int step) {
+            VoiceArena::Scope scope(voiceSet.arenas[first].get());
+            for (int voice = first; voice < voiceCount; voice += step) {
+                // Flatten the voice graph into a linear op list for the render loop
+                voiceSet.voices[voice] = compileVoice(factory(POOL_BUILD_FREQUENCY, 1.0f));
+            }
+        };
+
+        std::vector<std::thread> workers;
+        for (int t = 1; t < threads; ++t) {
+            workers.emplace_back(buildRange, t, threads);
+        }
+        buildRange(0, threads);
+        for (auto& worker : workers) {
+            worker.join();
+        }
+
+        VoiceArena::Stats stats;
+        for (const auto& arena : voiceSet.arenas) {
+            stats += arena->getStats();
+        }
+        voiceBankStats = stats;
+        std::cout << "Voice bank: " << voiceCount << " voices, " << stats.allocations << " allocations, "
+                  << stats.bytesUsed / 1024 << " KB in " << stats.chunks << " chunks" << std::endl;
+    }
+
+    // Control thread: grows the pool once polyphony has been raised past it
+    void ensurePoolCapacity() {
+        if (maxPolyphony.load(std::memory_order_relaxed) + POOL_HEADROOM <= poolCapacity.load(std::memory_order_relaxed)
+            || poolCapacity.load(std::memory_order_relaxed) >= MIDI_NOTE_COUNT
+            || poolResizePending.exchange(true)) {
+            return;
+        }
+        scheduleResize();
+    }
+
+    // Builder thread: rebuilds the current preset's pool at the new polyphony
+    void resizePool() {
+        std::lock_guard<std::mutex> lock(controlMutex);
+        if (currentFactory) {
+            auto registry = std::atomic_load(&parameterRegistry);
+            buildVoiceSet(currentFactory, registry.get());
+        }
+        poolResizePending = false;
+    }
+
+    // Control thread, under controlMutex. Frees the retired sets no queued
+    // ParameterChange can reach any more; the rest wait for a later call. A
+    // set's registry is no longer published, so once nothing else holds it
+    // (a control thread between getParameterRegistry() and commit()) no new
+    // change can name its parameters. The set is then freed when the audio
+    // thread has applied every batch queued up to that point.
+    void collectRetiredVoices() {
+        VoiceSet* retired = nullptr;
+        while (retiredVoices.pop(retired)) {
+            retiringVoices.push_back(retired);
+        }
+        auto unreachable = [](VoiceSet* voiceSet) {
+            if (voiceSet->lastParameterBatch == UNKNOWN_PARAMETER_BATCH) {
+                if (voiceSet->registry.use_count() > 1) {
+                    return false;
+                }
+                std::atomic_thread_fence(std::memory_order_acquire); // pairs with the holder's release of its copy
+                voiceSet->lastParameterBatch = parameterChangeQueue().pushCount();
+            }
+            return appliedParameterBatches().load(std::memory_order_acquire) >= voiceSet->lastParameterBatch;
+        };
+        auto freed = std::partition(retiringVoices.begin(), retiringVoices.end(),
+                                    [&](VoiceSet* voiceSet) { return !unreachable(voiceSet); });
+        for (auto it = freed; it != retiringVoices.end(); ++it) {
+            delete *it;
+        }
+        retiringVoices.erase(freed, retiringVoices.end());
+    }
+
+    // Runs on the audio thread; replaced sets are freed later by a control thread
+    void adoptPendingVoices() {
+        VoiceSet* pending = pendingVoices.exchange(nullptr, std::memory_order_acq_rel);
+        if (!pending) {
+            return;
+        }
+        if (liveVoices) {
+            if (liveVoices->soundingVoices.empty()) {
+                retireVoiceSet(liveVoices);
+            } else {
+                if (drainingCount == MAX_DRAINING_SETS) {
+                    removeDrainingSet(0); // switching faster than releases end: cut the oldest
                 }
+                drainingVoices[drainingCount++] = liveVoices;
+            }
+        }
+        liveVoices = pending;
+    }
+
+    void retireVoiceSet(VoiceSet* voiceSet) {
+        retiredVoices.push(voiceSet); // only fails if switches are never collected; leaks rather than frees here
+    }
+
+    void removeDrainingSet(size_t index) {
+        retireVoiceSet(drainingVoices[index]);
+        std::copy(drainingVoices.begin() + index + 1, drainingVoices.begin() + drainingCount, drainingVoices.begin() + index);
+        drainingVoices[--drainingCount] = nullptr;
+    }
+
+    // Each sounding voice renders into its own block, on whichever pool
+    // thread picks it up; the blocks are then summed in task order, so the
+    // mix is bit-identical for any number of render threads
+    void renderAllVoices(float* out, size_t frames, float sampleRate) {
+        if (frames == 0) {
+            return;
+        }
+        size_t taskCount = 0;
+        auto collect = [&](VoiceSet& voiceSet) {
+            if (voiceSet.simdVoices) {
+                voiceSet.simdVoices->render(out, frames, sampleRate);
+                return;
+            }
+            for (int voice : voiceSet.soundingVoices) {
+                renderTasks[taskCount++] = {&voiceSet, voice};
+            }
+        };
+        collect(*liveVoices);
+        for (size_t i = 0; i < drainingCount; ++i) {
+            collect(*drainingVoices[i]);
+        }
+
+        renderFrames = frames;
+        renderSampleRate = sampleRate;
+        renderProfileSlot = nodeProfilingEnabled() ? NodeProfiler::currentSlot() : NodeProfiler::NO_SLOT;
+        if (renderPool) {
+            // Below two voices per thread the hand-off costs more than it saves
+            renderPool->run(taskCount, &ActiveTones::renderTask, this, static_cast<unsigned>(taskCount / 2));
+        } else {
+            for (size_t task = 0; task < taskCount; ++task) {
+                renderVoice(task);
+            }
+        }
+
+        for (size_t task = 0; task < taskCount; ++task) {
+            const float* block = voiceBlocks[task].samples.data();
+            for (size_t i = 0; i < frames; ++i) {
+                out[i] += block[i];
+            }
+        }
+    }
+
+    static void renderTask(void* context, size_t task) {
+        static_cast<ActiveTones*>(context)->renderVoice(task);
+    }
+
+    // Pool threads: touches only the task's voice, slot and output block
+    void renderVoice(size_t task) {
+        VoiceSet& voiceSet = *renderTasks[task].voiceSet;
+        const int voice = renderTasks[task].voice;
+        VoiceSlot& slot = voiceSet.slots[voice];
+        float* block = voiceBlocks[task].samples.data();
+        if (nodeProfilingEnabled() && renderProfileSlot != NodeProfiler::currentSlot()) {
+            // On a pool thread: profile the voice under this node, as on the audio thread
+            NodeProfiler::ParentScope parent(renderProfileSlot);
+            voiceSet.voices[voice]->render(block, renderFrames, renderSampleRate);
+        } else {
+            voiceSet.voices[voice]->render(block, renderFrames, renderSampleRate);
+        }
+
+        if (slot.fadeStep == 0.0f) {
+            return;
+        }
+
+        float gain = slot.fadeGain;
+        for (size_t i = 0; i < renderFrames; ++i) {
+            gain = std::clamp(gain + slot.fadeStep, 0.0f, 1.0f);
+            block[i] *= gain;
+        }
+        slot.fadeGain = gain;
+        if (!slot.stolen && gain >= 1.0f) {
+            slot.fadeStep = 0.0f;
+        }
+    }
+
+    void adoptRenderPool() {
+        VoiceRenderPool* pending = pendingRenderPool.exchange(nullptr, std::memory_order_acq_rel);
+        if (!pending) {
+            return;
+        }
+        if (renderPool) {
+            retiredRenderPools.push(renderPool); // only fails if never collected; leaks rather than joins here
+        }
+        renderPool = pending;
+    }
+
+    void collectRetiredRenderPools() {
+        VoiceRenderPool* retired;
+        while (retiredRenderPools.pop(retired)) {
+            delete retired;
+        }
+    }
+
+    void applyNoteEvent(const NoteEvent& event) {
+        const int note = event.note;
+        if (event.type == NoteEvent::Type::NoteOff) {
+            releaseNote(*liveVoices, note);
+            // Notes started before a preset switch are released in their own set
+            for (size_t i = 0; i < drainingCount; ++i) {
+                releaseNote(*drainingVoices[i], note);
+            }
+            return;
+        }
+
+        VoiceSet& voiceSet = *liveVoices;
+        int voice = voiceSet.noteVoices[note];
+        if (voice < 0) {
+            const int polyphony = maxPolyphony.load(std::memory_order_relaxed);
+            while (playingVoiceCount() >= polyphony && stealVoice()) {
             }
+            voice = allocateVoice(voiceSet, note);
+            voiceSet.slots[voice].note = note;
+            voiceSet.noteVoices[note] = voice;
+            voiceSet.soundingVoices.push_back(voice);
+        } else if (voiceSet.slots[voice].stolen) {
+            // Retriggered mid-fade: ramp back up instead of jumping
+            voiceSet.slots[voice].stolen = false;
+            voiceSet.slots[voice].fadeStep = 1.0f / fadeSamples();
+        }
+        voiceSet.slots[voice].startOrder = ++noteOnCounter;
+
+        if (voiceSet.simdVoices) {
+            voiceSet.simdVoices->noteOn(voice, event.velocity);
+        } else {
+            voiceSet.voices[voice]->noteOn(event.velocity);
         }
     }
+
+    // Takes an idle voice from the pool and tunes it to note. With every
+    // voice busy (only when the pool is smaller than the polyphony, or steal
+    // fades pile up) the best steal candidate is cut off without a fade.
+    int allocateVoice(VoiceSet& voiceSet, int note) {
+        if (voiceSet.simdVoices) {
+            return note;
+        }
+        if (voiceSet.freeVoices.empty()) {
+            reclaimVoice(voiceSet);
+        }
+        const int voice = voiceSet.freeVoices.back();
+        voiceSet.freeVoices.pop_back();
+
+        const float frequency = voiceSet.noteFrequencies[note];
+        voiceSet.voices[voice]->retune(frequency / voiceSet.voiceFrequencies[voice]);
+        voiceSet.voiceFrequencies[voice] = frequency;
+        return voice;
+    }
+
+    void reclaimVoice(VoiceSet& voiceSet) {
+        size_t victim = voiceSet.soundingVoices.size();
+        for (size_t i = 0; i < voiceSet.soundingVoices.size(); ++i) {
+            const VoiceSlot& slot = voiceSet.slots[voiceSet.soundingVoices[i]];
+            if (slot.stolen && (victim == voiceSet.soundingVoices.size()
+                                || slot.startOrder < voiceSet.slots[voiceSet.soundingVoices[victim]].startOrder)) {
+                victim = i;
+            }
+        }
+        if (victim == voiceSet.soundingVoices.size()) {
+            const int voice = findStealVictim();
+            victim = std::find(voiceSet.soundingVoices.begin(), voiceSet.soundingVoices.end(), voice) - voiceSet.soundingVoices.begin();
+        }
+        voiceSet.voices[voiceSet.soundingVoices[victim]]->stop();
+        freeVoice(voiceSet, victim);
+    }
+
+    // Returns soundingVoices[index] to the pool; the caller has silenced it
+    void freeVoice(VoiceSet& voiceSet, size_t index) {
+        auto& soundingVoices = voiceSet.soundingVoices;
+        const int voice = soundingVoices[index];
+        VoiceSlot& slot = voiceSet.slots[voice];
+        if (voiceSet.noteVoices[slot.note] == voice) {
+            voiceSet.noteVoices[slot.note] = -1;
+        }
+        slot = VoiceSlot{};
+        soundingVoices[index] = soundingVoices.back();
+        soundingVoices.pop_back();
+        if (!voiceSet.simdVoices) {
+            voiceSet.freeVoices.push_back(voice);
+        }
+    }
+
+    void releaseNote(VoiceSet& voiceSet, int note) {
+        const int voice = voiceSet.noteVoices[note];
+        if (voice < 0) {
+            return;
+        }
+        if (voiceSet.simdVoices) {
+            voiceSet.simdVoices->noteOff(voice);
+        } else {
+            voiceSet.voices[voice]->noteOff();
+        }
+    }
+
+    // Drops voices whose envelope has finished or whose steal fade is
+    // complete. Returns the number still sounding.
+    size_t retireFinishedVoices(VoiceSet& voiceSet) {
+        auto& soundingVoices = voiceSet.soundingVoices;
+        for (size_t i = 0; i < soundingVoices.size();) {
+            const int voice = soundingVoices[i];
+            const VoiceSlot& slot = voiceSet.slots[voice];
+            bool finished;
+            if (voiceSet.simdVoices) {
+                finished = !voiceSet.simdVoices->isActive(voice);
+            } else if (slot.stolen && slot.fadeGain <= 0.0f) {
+                voiceSet.voices[voice]->stop();
+                finished = true;
+            } else {
+                finished = !voiceSet.voices[voice]->isActive();
+            }
+
+            if (finished) {
+                freeVoice(voiceSet, i);
+            } else {
+                ++i;
+            }
+        }
+        return soundingVoices.size();
+    }
+
+    int countLoudVoices(const VoiceSet& voiceSet) const {
+        int count = 0;
+        for (int voice : voiceSet.soundingVoices) {
+            if (!voiceSet.slots[voice].stolen && voiceLevel(voiceSet, voice) > 1e-4f) { // gate out very quiet voices (~-80 dB)
+                ++count;
+            }
+        }
+        return count;
+    }
+
+    float voiceLevel(const VoiceSet& voiceSet, int voice) const {
+        return voiceSet.simdVoices ? voiceSet.simdVoices->getLevel(voice) : voiceSet.voices[voice]->getLevel();
+    }
+
+    int playingVoiceCount() const {
+        int count = 0;
+        for (int voice : liveVoices->soundingVoices) {
+            if (!liveVoices->slots[voice].stolen) {
+                ++count;
+            }
+        }
+        return count;
+    }
+
+    // The oldest or quietest playing voice, or -1 if every voice is already stolen
+    int findStealVictim() const {
+        const bool quietest = stealMode.load(std::memory_order_relaxed) == VoiceStealMode::Quietest;
+        int victim = -1;
+        for (int voice : liveVoices->soundingVoices) {
+            const VoiceSlot& slot = liveVoices->slots[voice];
+            if (slot.stolen) {
+                continue;
+            }
+            if (victim < 0) {
+                victim = voice;
+                continue;
+            }
+            const VoiceSlot& best = liveVoices->slots[victim];
+            if (quietest) {
+                float level = voiceLevel(*liveVoices, voice);
+                float bestLevel = voiceLevel(*liveVoices, victim);
+                if (level < bestLevel || (level == bestLevel && slot.startOrder < best.startOrder)) {
+                    victim = voice;
+                }
+            } else if (slot.startOrder < best.startOrder) {
+                victim = voice;
+            }
+        }
+        return victim;
+    }
+
+    // Starts a short fade-out on the steal victim. Returns false when there
+    // is nothing left to steal.
+    bool stealVoice() {
+        const int victim = findStealVictim();
+        if (victim < 0) {
+            return false;
+        }
+
+        VoiceSlot& slot = liveVoices->slots[victim];
+        slot.stolen = true;
+        if (liveVoices->simdVoices) {
+            liveVoices->simdVoices->fadeOut(victim, STEAL_FADE_SECONDS);
+        } else {
+            slot.fadeStep = -1.0f / fadeSamples();
+        }
+        return true;
+    }
+
+    float fadeSamples() const {
+        return std::max(STEAL_FADE_SECONDS * currentSampleRate, 1.0f);
+    }
+
+    // Exposed like the voice parameters so the GUI and MIDI controls can set it
+    void addPolyphonyParameter(ParameterRegistry& registry) {
+        registry.add(std::make_shared<Parameter>("Polyphony", static_cast<float>(maxPolyphony.load()), 1.0f,
+            static_cast<float>(MIDI_NOTE_COUNT), 1.0f, "voices",
+            [this](float value) { setMaxPolyphony(static_cast<int>(value)); }));
+    }
+
+    float midiNoteToFrequency(int midiNote) const {
+        // Convert MIDI note number to frequency
+        return 440.0f * std::pow(2.0f, (midiNote - 69) / 12.0f);
+    }
+
+    float detunedFrequency(int midiNote) const {
+        // Add slight random frequency offset to reduce phase coherence and beating
+        static std::random_device rd;
+        static std::mt19937 gen(rd());
+        std::uniform_real_distribution<float> detune(-0.001f, 0.001f);
+        return midiNoteToFrequency(midiNote) * (1.0f + detune(gen));
+    }
+
 };
@@ -0,0 +1,271 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include "HTTPParser.cpp"
+
+// Static files for StaticServer, read once and served from memory. A file
+// is looked at again (one stat, no read) at most every RECHECK_MS and
+// reloaded when its mtime or size changed, so editing gui.html still shows
+// up on the next page load.
+//
+// Precompressed variants sit next to the file and are picked up the same
+// way; nothing is compressed at run time:
+//     gzip -k9 gui.html       -> gui.html.gz
+//     brotli -k gui.html      -> gui.html.br
+// A variant older than its file is ignored rather than served stale.
+
+// True if the Accept-Encoding value allows coding, i.e. lists it (or "*")
+// without q=0
+inline bool acceptsEncoding(std::string_view acceptEncoding, std::string_view coding) {
+    while (!acceptEncoding.empty()) {
+        size_t comma = acceptEncoding.find(',');
+        std::string_view item = acceptEncoding.substr(0, comma);
+        acceptEncoding.remove_prefix(comma == std::string_view::npos ? acceptEncoding.size() : comma + 1);
+
+        size_t semicolon = item.find(';');
+        std::string_view name = item.substr(0, semicolon);
+        size_t start = name.find_first_not_of(" \t");
+        if (start == std::string_view::npos) {
+            continue;
+        }
+        name = name.substr(start, name.find_last_not_of(" \t") - start + 1);
+        if (!equalsIgnoreCase(name, coding) && name != "*") {
+            continue;
+        }
+        if (semicolon != std::string_view::npos) {
+            std::string_view q = item.substr(semicolon + 1);
+            size_t qStart = q.find_first_not_of(" \t");
+            q.remove_prefix(qStart == std::string_view::npos ? q.size() : qStart);
+            // q=0, q=0.0, q=0.000 refuse the coding; anything else accepts it
+            if (q.size() > 2 && (q[0] == 'q' || q[0] == 'Q') && q[1] == '=') {
+                std::string_view weight = q.substr(2, q.find_first_of(" \t;", 2) - 2);
+                if (weight.find_first_not_of("0.") == std::string_view::npos) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+    return false;
+}
+
+// True if an If-None-Match value names etag (weakly) or is "*"
+inline bool etagMatches(std::string_view ifNoneMatch, std::string_view etag) {
+    while (!ifNoneMatch.empty()) {
+        size_t comma = ifNoneMatch.find(',');
+        std::string_view item = ifNoneMatch.substr(0, comma);
+        ifNoneMatch.remove_prefix(comma == std::string_view::npos ? ifNoneMatch.size() : comma + 1);
+
+        size_t start = item.find_first_not_of(" \t");
+        if (start == std::string_view::npos) {
+            continue;
+        }
+        item = item.substr(start, item.find_last_not_of(" \t") - start + 1);
+        if (item == "*") {
+            return true;
+        }
+        if (item.substr(0, 2) == "W/") {
+            item.remove_prefix(2);
+        }
+        if (item == etag) {
+            return true;
+        }
+    }
+    return false;
+}
+
+struct Asset {
+    // One encoding of the file; bytes is null when there is no such variant
+    struct Representation {
+        std::shared_ptr<const std::string> bytes;
+        std::string etag;     // quoted, different per encoding
+        const char* encoding; // Content-Encoding, or nullptr for identity
+    };
+
+    std::string contentType;
+    Representation identity{nullptr, "", nullptr};
+    Representation brotli{nullptr, "", "br"};
+    Representation gzip{nullptr, "", "gzip"};
+
+    // The smallest variant the client accepts
+    const Representation& select(std::string_view acceptEncoding) const {
+        if (brotli.bytes && acceptsEncoding(acceptEncoding, "br")) {
+            return brotli;
+        }
+        if (gzip.bytes && acceptsEncoding(acceptEncoding, "gzip")) {
+            return gzip;
+        }
+        return identity;
+    }
+
+    bool hasVariants() const { return brotli.bytes || gzip.bytes; }
+};
+
+class AssetCache {
+public:
+    using MimeTypeResolver = std::function<std::string(const std::string& extension)>;
+
+    static constexpr int RECHECK_MS = 1000;
+
+    AssetCache(std::filesystem::path rootDirectory, MimeTypeResolver mimeType)
+        : root(std::move(rootDirectory)), mimeType(std::move(mimeType)) {
+    }
+
+    // Serves path from bytes compiled into the binary; the disk is never
+    // consulted for it
+    void addEmbedded(const std::string& path, std::string_view bytes) {
+        auto asset = std::make_shared<Asset>();
+        asset->contentType = mimeType(std::filesystem::path(path).extension().string());
+        setRepresentation(asset->identity, std::make_shared<const std::string>(bytes), "");
+
+        std::lock_guard<std::mutex> lock(mutex);
+        Entry& entry = entries[path];
+        entry.asset = std::move(asset);
+        entry.embedded = true;
+    }
+
+    // path is a request path ("/gui.html") that passed StaticServer's
+    // safety checks. Null if there is no such regular file.
+    std::shared_ptr<const Asset> get(const std::string& path) {
+        const auto now = std::chrono::steady_clock::now();
+        std::lock_guard<std::mutex> lock(mutex);
+        auto found = entries.find(path);
+        if (found != entries.end()
+            && (found->second.embedded || now - found->second.checkedAt < std::chrono::milliseconds(RECHECK_MS))) {
+            return found->second.asset;
+        }
+        Entry& entry = found != entries.end() ? found->second : entries[path];
+        entry.checkedAt = now;
+        refresh(root / path.substr(1), entry);
+        if (!entry.asset) {
+            entries.erase(path); // missing files are not remembered, so 404s cannot grow the cache
+            return nullptr;
+        }
+        return entry.asset;
+    }
+
+private:
+    // What a file looked like when it was loaded
+    struct FileStamp {
+        bool exists = false;
+        std::filesystem::file_time_type mtime;
+        uintmax_t size = 0;
+
+        bool operator==(const FileStamp& other) const {
+            return exists == other.exists && (!exists || (mtime == other.mtime && size == other.size));
+        }
+        bool operator!=(const FileStamp& other) const { return !(*this == other); }
+    };
+
+    struct Entry {
+        std::shared_ptr<const Asset> asset;
+        FileStamp file;
+        FileStamp gzipFile;
+        FileStamp brotliFile;
+        std::chrono::steady_clock::time_point checkedAt;
+        bool embedded = false;
+    };
+
+    std::filesystem::path root;
+    MimeTypeResolver mimeType;
+    std::mutex mutex;
+    std::unordered_map<std::string, Entry> entries; // guarded by mutex
+
+    static FileStamp stamp(const std::filesystem::path& path) {
+        FileStamp result;
+        std::error_code error;
+        if (!std::filesystem::is_regular_file(path, error)) {
+            return result;
+        }
+        result.mtime = std::filesystem::last_write_time(path, error);
+        if (!error) {
+            result.size = std::filesystem::file_size(path, error);
+            result.exists = !error;
+        }
+        return result;
+    }
+
+    static std::shared_ptr<const std::string> readFile(const std::filesystem::path& path, uintmax_t size) {
+        std::ifstream file(path, std::ios::binary);
+        auto content = std::make_shared<std::string>(static_cast<size_t>(size), '\0');
+        if (!file || !file.read(content->data(), static_cast<std::streamsize>(size))) {
+            return nullptr;
+        }
+        return content;
+    }
+
+    // FNV-1a of the file's bytes; the encoding suffix keeps a cached gzip
+    // response from validating a brotli one
+    static void setRepresentation(Asset::Representation& representation, std::shared_ptr<const std::string> bytes,
+                                  const std::string& suffix) {
+        uint64_t hash = 14695981039346656037ull;
+        for (unsigned char c : *bytes) {
+            hash = (hash ^ c) * 1099511628211ull;
+        }
+        char digits[17];
+        static const char hex[] = "0123456789abcdef";
+        for (int i = 15; i >= 0; --i, hash >>= 4) {
+            digits[i] = hex[hash & 0xf];
+        }
+        digits[16] = '\0';
+        representation.etag = std::string("\"") + digits + suffix + "\"";
+        representation.bytes = std::move(bytes);
+    }
+
+    void refresh(const std::filesystem::path& fullPath, Entry& entry) {
+        const FileStamp file = stamp(fullPath);
+        const FileStamp gzipFile = stamp(fullPath.string() + ".gz");
+        const FileStamp brotliFile = stamp(fullPath.string() + ".br");
+        if (entry.asset && file == entry.file && gzipFile == entry.gzipFile && brotliFile == entry.brotliFile) {
+            return;
+        }
+        entry.file = file;
+        entry.gzipFile = gzipFile;
+        entry.brotliFile = brotliFile;
+        entry.asset = nullptr;
+        if (!file.exists) {
+            return;
+        }
+
+        auto content = readFile(fullPath, file.size);
+        if (!content) {
+            std::cerr << "StaticServer: Could not read " << fullPath.string() << std::endl;
+            entry.file = FileStamp(); // try again next time
+            return;
+        }
+        auto asset = std::make_shared<Asset>();
+        asset->contentType = mimeType(fullPath.extension().string());
+        setRepresentation(asset->identity, std::move(content), "");
+        loadVariant(fullPath.string() + ".br", brotliFile, file, asset->brotli, "-br");
+        loadVariant(fullPath.string() + ".gz", gzipFile, file, asset->gzip, "-gz");
+        entry.asset = std::move(asset);
+        std::cout << "StaticServer: Cached " << fullPath.string() << " (" << file.size << " bytes"
+                  << (entry.asset->brotli.bytes ? ", br" : "") << (entry.asset->gzip.bytes ? ", gzip" : "") << ")"
+                  << std::endl;
+    }
+
+    static void loadVariant(const std::filesystem::path& path, const FileStamp& variantFile, const FileStamp& file,
+                            Asset::Representation& representation, const std::string& suffix) {
+        if (!variantFile.exists) {
+            return;
+        }
+        if (variantFile.mtime < file.mtime) {
+            std::cerr << "StaticServer: Ignoring " << path.string() << ", older than the file it compresses"
+                      << std::endl;
+            return;
+        }
+        if (auto bytes = readFile(path, variantFile.size)) {
+            setRepresentation(representation, std::move(bytes), suffix);
+        }
+    }
+};
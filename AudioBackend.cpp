@@ -0,0 +1,248 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include "SoundGenerator.cpp"
+
+// What the engine asks a backend for. A backend may override any of it in
+// open() (a device's shared-mode rate, for example); read the result back
+// through the getters.
+struct AudioStreamConfig {
+    float sampleRate = 44100.0f;
+    int channels = 1;
+    size_t blockFrames = 256; // frames per render call, at most MAX_BLOCK_FRAMES
+};
+
+// Platform-neutral audio output. The engine hands run() a callback that fills
+// interleaved float frames; the backend decides when it is called (device
+// clock, as fast as possible, ...) and where the samples go.
+class AudioBackend {
+public:
+    // Fills frames * channels interleaved samples. frames <= MAX_BLOCK_FRAMES.
+    using RenderCallback = std::function<void(float* out, size_t frames, int channels)>;
+
+    virtual ~AudioBackend() = default;
+
+    virtual const char* getName() const = 0;
+
+    // Prepares the stream; false (after logging why) if it cannot be used
+    virtual bool open(const AudioStreamConfig& requested) = 0;
+
+    // Calls render until stop() or the end of the stream. Blocks the calling thread.
+    virtual void run(const RenderCallback& render) = 0;
+
+    // Any thread: makes run() return after the current block
+    virtual void stop() {
+        stopRequested = true;
+    }
+
+    float getSampleRate() const { return config.sampleRate; }
+    int getChannels() const { return config.channels; }
+
+    // Frames between render() and the listener
+    virtual size_t getLatencyFrames() const { return config.blockFrames; }
+
+    // Times the output ran dry because rendering fell behind
+    uint64_t getUnderrunCount() const { return underruns.load(std::memory_order_relaxed); }
+    // Times the device had no buffer to hand out, so a period went unrendered
+    uint64_t getSkippedBufferCount() const { return skippedBuffers.load(std::memory_order_relaxed); }
+
+protected:
+    AudioStreamConfig config;
+    std::atomic<bool> stopRequested{false}; // cleared by open()
+    std::atomic<uint64_t> underruns{0};
+    std::atomic<uint64_t> skippedBuffers{0};
+
+    void setConfig(const AudioStreamConfig& requested) {
+        stopRequested = false;
+        config = requested;
+        config.channels = std::max(config.channels, 1);
+        config.blockFrames = std::clamp<size_t>(config.blockFrames, 1, MAX_BLOCK_FRAMES);
+    }
+};
+
+// Discards the audio. Renders as fast as the engine allows unless paced, in
+// which case it sleeps to keep real time (a headless server). Stops on its
+// own after maxFrames, if set.
+class NullAudioBackend : public AudioBackend {
+public:
+    explicit NullAudioBackend(bool paced = false, uint64_t maxFrames = 0)
+        : paced(paced), maxFrames(maxFrames) {}
+
+    const char* getName() const override { return "null"; }
+
+    bool open(const AudioStreamConfig& requested) override {
+        setConfig(requested);
+        buffer.assign(config.blockFrames * config.channels, 0.0f);
+        return true;
+    }
+
+    void run(const RenderCallback& render) override {
+        auto start = std::chrono::steady_clock::now();
+        uint64_t pacedFrames = 0; // rendered since start
+        framesRendered = 0;
+        while (!stopRequested && (maxFrames == 0 || framesRendered < maxFrames)) {
+            size_t frames = config.blockFrames;
+            if (maxFrames != 0) {
+                frames = static_cast<size_t>(std::min<uint64_t>(frames, maxFrames - framesRendered));
+            }
+            render(buffer.data(), frames, config.channels);
+            framesRendered += frames;
+            if (paced) {
+                pacedFrames += frames;
+                const auto deadline = start + std::chrono::duration<double>(pacedFrames / config.sampleRate);
+                const auto now = std::chrono::steady_clock::now();
+                if (now > deadline) {
+                    // Past the end of this block already: a device would have run
+                    // dry, then carried on from now rather than rushing the missed blocks
+                    underruns.fetch_add(1, std::memory_order_relaxed);
+                    start = now;
+                    pacedFrames = 0;
+                } else {
+                    std::this_thread::sleep_until(deadline);
+                }
+            }
+        }
+    }
+
+    uint64_t getFramesRendered() const { return framesRendered; }
+
+private:
+    bool paced;
+    uint64_t maxFrames;
+    std::atomic<uint64_t> framesRendered{0};
+    std::vector<float> buffer;
+};
+
+// Streams 32-bit float PCM to a RIFF/WAVE file
+class WavWriter {
+public:
+    ~WavWriter() {
+        close();
+    }
+
+    bool open(const std::string& path, float sampleRate, int channels) {
+        close();
+        file = std::fopen(path.c_str(), "wb");
+        if (!file) {
+            return false;
+        }
+        this->sampleRate = static_cast<uint32_t>(sampleRate);
+        this->channels = static_cast<uint16_t>(channels);
+        dataBytes = 0;
+        writeHeader();
+        return true;
+    }
+
+    void write(const float* interleaved, size_t frames) {
+        if (file) {
+            dataBytes += std::fwrite(interleaved, sizeof(float), frames * channels, file) * sizeof(float);
+        }
+    }
+
+    // Patches the chunk sizes now that the length is known
+    void close() {
+        if (!file) {
+            return;
+        }
+        std::fseek(file, 0, SEEK_SET);
+        writeHeader();
+        std::fclose(file);
+        file = nullptr;
+    }
+
+    bool isOpen() const { return file != nullptr; }
+
+private:
+    static constexpr uint16_t WAVE_FORMAT_IEEE_FLOAT = 3;
+
+    std::FILE* file = nullptr;
+    uint32_t sampleRate = 0;
+    uint16_t channels = 1;
+    uint32_t dataBytes = 0;
+
+    void writeHeader() {
+        const uint16_t blockAlign = channels * sizeof(float);
+        put("RIFF");
+        put32(4 + (8 + 18) + (8 + 4) + (8 + dataBytes));
+        put("WAVE");
+        put("fmt ");
+        put32(18);
+        put16(WAVE_FORMAT_IEEE_FLOAT);
+        put16(channels);
+        put32(sampleRate);
+        put32(sampleRate * blockAlign);
+        put16(blockAlign);
+        put16(sizeof(float) * 8);
+        put16(0); // cbSize
+        // Non-PCM formats carry a fact chunk with the frame count
+        put("fact");
+        put32(4);
+        put32(dataBytes / blockAlign);
+        put("data");
+        put32(dataBytes);
+    }
+
+    void put(const char* tag) { std::fwrite(tag, 1, 4, file); }
+
+    void put16(uint16_t value) {
+        const unsigned char bytes[2] = {static_cast<unsigned char>(value), static_cast<unsigned char>(value >> 8)};
+        std::fwrite(bytes, 1, 2, file);
+    }
+
+    void put32(uint32_t value) {
+        put16(static_cast<uint16_t>(value));
+        put16(static_cast<uint16_t>(value >> 16));
+    }
+};
+
+// Renders as fast as possible into a 32-bit float WAV file. Stops after
+// maxFrames, or on stop() when maxFrames is 0.
+class WavFileAudioBackend : public AudioBackend {
+public:
+    WavFileAudioBackend(std::string path, uint64_t maxFrames = 0)
+        : path(std::move(path)), maxFrames(maxFrames) {}
+
+    const char* getName() const override { return "wav"; }
+
+    bool open(const AudioStreamConfig& requested) override {
+        setConfig(requested);
+        if (!writer.open(path, config.sampleRate, config.channels)) {
+            std::cerr << "Failed to open " << path << " for writing." << std::endl;
+            return false;
+        }
+        buffer.assign(config.blockFrames * config.channels, 0.0f);
+        return true;
+    }
+
+    void run(const RenderCallback& render) override {
+        uint64_t framesWritten = 0;
+        while (!stopRequested && (maxFrames == 0 || framesWritten < maxFrames)) {
+            size_t frames = config.blockFrames;
+            if (maxFrames != 0) {
+                frames = static_cast<size_t>(std::min<uint64_t>(frames, maxFrames - framesWritten));
+            }
+            render(buffer.data(), frames, config.channels);
+            writer.write(buffer.data(), frames);
+            framesWritten += frames;
+        }
+        writer.close();
+    }
+
+    // Nothing is played back
+    size_t getLatencyFrames() const override { return 0; }
+
+private:
+    std::string path;
+    uint64_t maxFrames;
+    WavWriter writer;
+    std::vector<float> buffer;
+};
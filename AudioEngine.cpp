@@ -0,0 +1,102 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "SoundGenerator.cpp"
+#include "Parameter.cpp"
+#include "AudioBackend.cpp"
+#include "AudioStats.cpp"
+#include "ScopeTap.cpp"
+
+// Drives a generator tree from an AudioBackend: applies parameter changes at
+// block boundaries, soft-clips, fans the mono signal out to every channel
+// and keeps the last 100 ms for the GUI scope.
+class AudioEngine {
+public:
+    static constexpr float DEFAULT_SAMPLE_RATE = 44100.0f;
+    // Waveform for the last 100ms (4410 samples at 44100 Hz)
+    static constexpr int WAVEFORM_BUFFER_SIZE = static_cast<int>(DEFAULT_SAMPLE_RATE) / 10;
+    using WaveformTap = ScopeTap<8192>;
+    static_assert(WAVEFORM_BUFFER_SIZE <= WaveformTap::MAX_SNAPSHOT, "scope tap too small for the waveform");
+
+    AudioEngine(std::shared_ptr<SoundGenerator> generator, std::unique_ptr<AudioBackend> backend)
+        : soundGenerator(std::move(generator)), backend(std::move(backend)) {
+    }
+
+    ~AudioEngine() {
+        shutdown();
+    }
+
+    bool initialize(const AudioStreamConfig& config = AudioStreamConfig()) {
+        if (!backend->open(config)) {
+            return false;
+        }
+        blockStats.setSampleRate(backend->getSampleRate());
+        std::cout << "Audio backend: " << backend->getName() << ", " << backend->getSampleRate() << " Hz, "
+                  << backend->getChannels() << " channel(s), latency " << backend->getLatencyFrames() << " frames"
+                  << std::endl;
+        return true;
+    }
+
+    // Runs the backend until shutdown() or the end of its stream. Call on the audio thread.
+    void processAudio() {
+        backend->run([this](float* out, size_t frames, int channels) {
+            renderBlock(mono.data(), frames);
+            for (size_t i = 0; i < frames; ++i) {
+                for (int c = 0; c < channels; ++c) {
+                    out[i * channels + c] = mono[i];
+                }
+            }
+        });
+    }
+
+    // Renders one block into out, applies soft clipping and feeds the waveform tap
+    void renderBlock(float* out, size_t frames) {
+        const auto start = std::chrono::steady_clock::now();
+        // Parameter edits from control threads take effect at block boundaries
+        applyParameterChanges();
+        soundGenerator->render(out, frames, backend->getSampleRate());
+
+        for (size_t i = 0; i < frames; ++i) {
+            // Apply soft clipping
+            out[i] = std::tanh(out[i]);
+        }
+
+        waveformTap.write(out, frames);
+        blockStats.record(frames, start, std::chrono::steady_clock::now());
+    }
+
+    void shutdown() {
+        backend->stop();
+    }
+
+    AudioBackend& getBackend() { return *backend; }
+
+    // Render timing and underruns, as served at /api/stats
+    std::string getStatsJSON() const {
+        return blockStats.toJSON(backend->getUnderrunCount(), backend->getSkippedBufferCount());
+    }
+
+    // Get waveform data for visualization, most recent sample first. Never blocks the audio thread.
+    std::vector<float> getWaveformData() const {
+        std::vector<float> result = waveformTap.snapshot(WAVEFORM_BUFFER_SIZE);
+        std::reverse(result.begin(), result.end());
+        return result;
+    }
+
+    const WaveformTap& getWaveformTap() const { return waveformTap; }
+
+private:
+    std::shared_ptr<SoundGenerator> soundGenerator;
+    std::unique_ptr<AudioBackend> backend;
+    std::array<float, MAX_BLOCK_FRAMES> mono;
+    AudioBlockStats blockStats;
+    WaveformTap waveformTap;
+};
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "SoundGenerator.cpp"
+
+// Timing of every rendered block. The audio thread records each block with
+// relaxed atomic stores and never waits; any thread can summarize the
+// recent history as JSON for /api/stats.
+//
+// Each block is one 64-bit history entry, so a reader never sees half of
+// one: bits 63..32 hold the end time in milliseconds since construction,
+// bits 31..10 the render time in 100 ns units (saturating at ~0.4 s), and
+// bits 9..0 the frame count.
+class AudioBlockStats {
+public:
+    static constexpr size_t HISTORY_BLOCKS = 8192; // > 10 s of 64-frame blocks at 48 kHz
+    static_assert(MAX_BLOCK_FRAMES < 1024, "frame count must fit in 10 bits");
+
+    AudioBlockStats() : epoch(std::chrono::steady_clock::now()) {
+        for (auto& entry : history) {
+            entry.store(0, std::memory_order_relaxed);
+        }
+        for (auto& count : blockSizes) {
+            count.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    void setSampleRate(float rate) {
+        sampleRate.store(rate, std::memory_order_relaxed);
+    }
+
+    // Audio thread: one call per rendered block
+    void record(size_t frames, std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end) {
+        using namespace std::chrono;
+        const uint64_t nanos = static_cast<uint64_t>(duration_cast<nanoseconds>(end - start).count());
+        const uint64_t endMs = static_cast<uint64_t>(duration_cast<milliseconds>(end - epoch).count());
+        const uint64_t ticks = std::min<uint64_t>(nanos / 100, (1u << 22) - 1);
+        const uint64_t entry = (endMs << 32) | (ticks << 10) | (frames & 1023);
+
+        const uint64_t index = written.load(std::memory_order_relaxed);
+        history[index % HISTORY_BLOCKS].store(entry, std::memory_order_relaxed);
+        written.store(index + 1, std::memory_order_release);
+
+        blockSizes[frames].fetch_add(1, std::memory_order_relaxed);
+        if (nanos > budgetNanos(frames)) {
+            deadlineMisses.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    // Any thread. underruns and skippedBuffers come from the backend
+    // (AudioBackend::getUnderrunCount, getSkippedBufferCount).
+    std::string toJSON(uint64_t underruns, uint64_t skippedBuffers) const {
+        const uint64_t blocks = written.load(std::memory_order_acquire);
+        const uint64_t nowMs = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - epoch).count());
+
+        std::string json = "{\"type\":\"audio_stats\",\"sampleRate\":" + formatNumber(sampleRate.load(std::memory_order_relaxed))
+                         + ",\"blocks\":" + std::to_string(blocks)
+                         + ",\"underruns\":" + std::to_string(underruns)
+                         + ",\"skippedBuffers\":" + std::to_string(skippedBuffers)
+                         + ",\"deadlineMisses\":" + std::to_string(deadlineMisses.load(std::memory_order_relaxed))
+                         + ",\"windows\":{\"1s\":" + windowJSON(blocks, nowMs, 1000)
+                         + ",\"10s\":" + windowJSON(blocks, nowMs, 10000)
+                         + "},\"blockSizes\":{";
+        bool first = true;
+        for (size_t frames = 0; frames < blockSizes.size(); ++frames) {
+            const uint64_t count = blockSizes[frames].load(std::memory_order_relaxed);
+            if (count == 0) {
+                continue;
+            }
+            json += (first ? "\"" : ",\"") + std::to_string(frames) + "\":" + std::to_string(count);
+            first = false;
+        }
+        json += "}}";
+        return json;
+    }
+
+private:
+    const std::chrono::steady_clock::time_point epoch;
+    std::atomic<float> sampleRate{44100.0f};
+    std::array<std::atomic<uint64_t>, HISTORY_BLOCKS> history;
+    alignas(64) std::atomic<uint64_t> written{0};
+    std::atomic<uint64_t> deadlineMisses{0}; // blocks that took longer than they last
+    std::array<std::atomic<uint64_t>, MAX_BLOCK_FRAMES + 1> blockSizes;
+
+    // Time the block covers at the output; rendering must finish within it
+    uint64_t budgetNanos(size_t frames) const {
+        return static_cast<uint64_t>(frames * 1e9 / sampleRate.load(std::memory_order_relaxed));
+    }
+
+    // Render times (min/avg/p99/max, microseconds) and load (render time over
+    // block duration) of the blocks that ended in the last windowMs
+    std::string windowJSON(uint64_t blocks, uint64_t nowMs, uint64_t windowMs) const {
+        std::vector<uint64_t> nanos;
+        uint64_t totalNanos = 0;
+        uint64_t totalBudget = 0;
+        double maxLoad = 0.0;
+        const uint64_t available = std::min<uint64_t>(blocks, HISTORY_BLOCKS);
+        for (uint64_t i = 1; i <= available; ++i) {
+            const uint64_t entry = history[(blocks - i) % HISTORY_BLOCKS].load(std::memory_order_relaxed);
+            const uint64_t endMs = entry >> 32;
+            if (endMs + windowMs < nowMs) {
+                break;
+            }
+            const uint64_t blockNanos = ((entry >> 10) & ((1u << 22) - 1)) * 100;
+            const uint64_t budget = budgetNanos(entry & 1023);
+            nanos.push_back(blockNanos);
+            totalNanos += blockNanos;
+            totalBudget += budget;
+            if (budget > 0) {
+                maxLoad = std::max(maxLoad, static_cast<double>(blockNanos) / budget);
+            }
+        }
+        if (nanos.empty()) {
+            return "{\"blocks\":0}";
+        }
+
+        const size_t p99Index = std::min(nanos.size() - 1, nanos.size() * 99 / 100);
+        std::nth_element(nanos.begin(), nanos.begin() + p99Index, nanos.end());
+        const uint64_t p99 = nanos[p99Index];
+        const auto [minIt, maxIt] = std::minmax_element(nanos.begin(), nanos.end());
+        return "{\"blocks\":" + std::to_string(nanos.size())
+             + ",\"minUs\":" + formatNumber(*minIt / 1000.0)
+             + ",\"avgUs\":" + formatNumber(totalNanos / 1000.0 / nanos.size())
+             + ",\"p99Us\":" + formatNumber(p99 / 1000.0)
+             + ",\"maxUs\":" + formatNumber(*maxIt / 1000.0)
+             + ",\"avgLoad\":" + formatNumber(totalBudget ? static_cast<double>(totalNanos) / totalBudget : 0.0)
+             + ",\"maxLoad\":" + formatNumber(maxLoad) + "}";
+    }
+
+    static std::string formatNumber(double value) {
+        char buffer[32];
+        std::snprintf(buffer, sizeof(buffer), "%.6g", value);
+        return buffer;
+    }
+};
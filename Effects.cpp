@@ -2,10 +2,12 @@
 
 #include <cmath>
 #include <vector>
+#include <array>
 #include <random>
 #include <algorithm>
 #include "SoundGenerator.cpp"
 #include "Parameter.cpp"
+#include "Smoothing.cpp"
 #include <memory>
 
 class HighPassFilter : public SoundGenerator {
@@ -15,34 +17,66 @@ public:
         addParam(std::make_unique<Parameter>("Highpass Cutoff", cutoffFrequency, 20.0f, 20000.0f, 1.0f, "Hz",
             [this](float value) { setCutoffFrequency(value); }));
         
+        cutoff.snap(cutoffFrequency);
         setCutoffFrequency(cutoffFrequency);
     }
 
-    float generateSample(float sampleRate) override {
-        float inputSample = sourceGenerator->generateSample(sampleRate);
-        float outputSample = a0 * inputSample + a1 * x1 + a2 * x2 - b1 * y1 - b2 * y2;
+    // The source is not a child generator, so forward explicitly
+    void retune(float ratio) override {
+        sourceGenerator->retune(ratio);
+    }
+
+    void process(float* out, size_t frames, float sampleRate) override {
+        sourceGenerator->render(out, frames, sampleRate);
+        updateCoefficients(frames, sampleRate);
 
-        // Update delay buffers
-        x2 = x1;
-        x1 = inputSample;
-        y2 = y1;
-        y1 = outputSample;
+        // Keep the filter state in locals for the duration of the block
+        float lx1 = x1, lx2 = x2, ly1 = y1, ly2 = y2;
+        for (size_t i = 0; i < frames; ++i) {
+            float inputSample = out[i];
+            float outputSample = a0 * inputSample + a1 * lx1 + a2 * lx2 - b1 * ly1 - b2 * ly2;
 
-        return outputSample;
+            // Update delay buffers
+            lx2 = lx1;
+            lx1 = inputSample;
+            ly2 = ly1;
+            ly1 = outputSample;
+
+            out[i] = outputSample;
+        }
+        x1 = lx1; x2 = lx2; y1 = ly1; y2 = ly2;
     }
 
+    // The cutoff glides to its new value; coefficients follow once per block
     void setCutoffFrequency(float frequency) {
-        cutoffFrequency = frequency;
-        calculateCoefficients();
+        cutoff.setTarget(frequency);
+        coefficientsDirty = true;
+    }
+
+    void setCutoffRampTime(float seconds) {
+        cutoff.setRampTime(seconds);
     }
 
 private:
     std::shared_ptr<SoundGenerator> sourceGenerator;
+    SmoothedValue cutoff{1000.0f, RampCurve::Exponential, 0.05f};
     float cutoffFrequency;
     float sampleRate;
 
     // Filter coefficients
     float a0, a1, a2, b1, b2;
+    bool coefficientsDirty = true;
+
+    // Called at the top of process(): steps the cutoff ramp by one block
+    void updateCoefficients(size_t frames, float blockSampleRate) {
+        if (coefficientsDirty || cutoff.isSmoothing() || blockSampleRate != sampleRate) {
+            sampleRate = blockSampleRate;
+            cutoff.nextBlock(frames, sampleRate);
+            cutoffFrequency = cutoff.getCurrent();
+            calculateCoefficients();
+            coefficientsDirty = false;
+        }
+    }
 
     // Delay buffers
     float x1, x2, y1, y2;
@@ -73,34 +107,66 @@ public:
         addParam(std::make_unique<Parameter>("Lowpass Cutoff", cutoffFrequency, 20.0f, 20000.0f, 1.0f, "Hz",
             [this](float value) { setCutoffFrequency(value); }));
         
+        cutoff.snap(cutoffFrequency);
         setCutoffFrequency(cutoffFrequency);
     }
 
-    float generateSample(float sampleRate) override {
-        float inputSample = sourceGenerator->generateSample(sampleRate);
-        float outputSample = a0 * inputSample + a1 * x1 + a2 * x2 - b1 * y1 - b2 * y2;
+    // The source is not a child generator, so forward explicitly
+    void retune(float ratio) override {
+        sourceGenerator->retune(ratio);
+    }
+
+    void process(float* out, size_t frames, float sampleRate) override {
+        sourceGenerator->render(out, frames, sampleRate);
+        updateCoefficients(frames, sampleRate);
+
+        // Keep the filter state in locals for the duration of the block
+        float lx1 = x1, lx2 = x2, ly1 = y1, ly2 = y2;
+        for (size_t i = 0; i < frames; ++i) {
+            float inputSample = out[i];
+            float outputSample = a0 * inputSample + a1 * lx1 + a2 * lx2 - b1 * ly1 - b2 * ly2;
 
-        // Update delay buffers
-        x2 = x1;
-        x1 = inputSample;
-        y2 = y1;
-        y1 = outputSample;
+            // Update delay buffers
+            lx2 = lx1;
+            lx1 = inputSample;
+            ly2 = ly1;
+            ly1 = outputSample;
 
-        return outputSample;
+            out[i] = outputSample;
+        }
+        x1 = lx1; x2 = lx2; y1 = ly1; y2 = ly2;
     }
 
+    // The cutoff glides to its new value; coefficients follow once per block
     void setCutoffFrequency(float frequency) {
-        cutoffFrequency = frequency;
-        calculateCoefficients();
+        cutoff.setTarget(frequency);
+        coefficientsDirty = true;
+    }
+
+    void setCutoffRampTime(float seconds) {
+        cutoff.setRampTime(seconds);
     }
 
 private:
     std::shared_ptr<SoundGenerator> sourceGenerator;
+    SmoothedValue cutoff{1000.0f, RampCurve::Exponential, 0.05f};
     float cutoffFrequency;
     float sampleRate;
 
     // Filter coefficients
     float a0, a1, a2, b1, b2;
+    bool coefficientsDirty = true;
+
+    // Called at the top of process(): steps the cutoff ramp by one block
+    void updateCoefficients(size_t frames, float blockSampleRate) {
+        if (coefficientsDirty || cutoff.isSmoothing() || blockSampleRate != sampleRate) {
+            sampleRate = blockSampleRate;
+            cutoff.nextBlock(frames, sampleRate);
+            cutoffFrequency = cutoff.getCurrent();
+            calculateCoefficients();
+            coefficientsDirty = false;
+        }
+    }
 
     // Delay buffers
     float x1, x2, y1, y2;
@@ -127,7 +193,7 @@ private:
 class Delay : public SoundGenerator {
 public:
     Delay(std::shared_ptr<SoundGenerator> source, int delaySamples, float feedback, float mix, float sampleRate)
-        : SoundGenerator(), sourceGenerator(source), sampleRate(sampleRate), delayBuffer(sampleRate * 2, 0.0f), writeIndex(0) {
+        : SoundGenerator(), sourceGenerator(source), sampleRate(sampleRate), delayBuffer(makeDspBuffer<float>(static_cast<size_t>(sampleRate * 2))), writeIndex(0) {
         addParam(std::make_unique<Parameter>("Delay Samples", static_cast<float>(delaySamples), 1.0f, sampleRate * 2, 1.0f, "samples",
             [this](float value) { setDelaySamples(static_cast<int>(value)); }));
         addParam(std::make_unique<Parameter>("Feedback", feedback, 0.0f, 0.99f, 0.01f, "",
@@ -140,21 +206,31 @@ public:
         this->mix = mix;
     }
 
-    float generateSample(float sampleRate) override {
-        float inputSample = sourceGenerator->generateSample(sampleRate);
-        
-        // Read from delay buffer
-        float delaySample = delayBuffer[readIndex];
-        
-        // Write to delay buffer
-        delayBuffer[writeIndex] = inputSample + delaySample * feedback;
-        
-        // Update indices
-        writeIndex = (writeIndex + 1) % delayBuffer.size();
-        readIndex = (readIndex + 1) % delayBuffer.size();
-        
-        // Mix dry and wet signals
-        return inputSample * (1.0f - mix) + delaySample * mix;
+    // The source is not a child generator, so forward explicitly
+    void retune(float ratio) override {
+        sourceGenerator->retune(ratio);
+    }
+
+    void process(float* out, size_t frames, float sampleRate) override {
+        sourceGenerator->render(out, frames, sampleRate);
+
+        const int bufferSize = static_cast<int>(delayBuffer.size());
+        for (size_t i = 0; i < frames; ++i) {
+            float inputSample = out[i];
+
+            // Read from delay buffer
+            float delaySample = delayBuffer[readIndex];
+
+            // Write to delay buffer
+            delayBuffer[writeIndex] = inputSample + delaySample * feedback;
+
+            // Update indices
+            if (++writeIndex == bufferSize) writeIndex = 0;
+            if (++readIndex == bufferSize) readIndex = 0;
+
+            // Mix dry and wet signals
+            out[i] = inputSample * (1.0f - mix) + delaySample * mix;
+        }
     }
 
     void setDelaySamples(int newDelaySamples) {
@@ -165,7 +241,7 @@ public:
 private:
     std::shared_ptr<SoundGenerator> sourceGenerator;
     float sampleRate;
-    std::vector<float> delayBuffer;
+    DspBuffer<float> delayBuffer;
     int writeIndex;
     int readIndex;
     
@@ -180,7 +256,7 @@ public:
         : SoundGenerator(),
           sourceGenerator(source),
           sampleRate(sampleRate),
-          delayBuffer(static_cast<int>(sampleRate * 2), 0.0f),
+          delayBuffer(makeDspBuffer<float>(static_cast<size_t>(sampleRate * 2))),
           writeIndex(0),
           feedback(feedback),
           mix(mix),
@@ -207,9 +283,32 @@ public:
           currentDelaySamples(other.currentDelaySamples) {
     }
 
-    float generateSample(float sampleRate) override {
-        float inputSample = sourceGenerator->generateSample(sampleRate);
+    void process(float* out, size_t frames, float sampleRate) override {
+        sourceGenerator->render(out, frames, sampleRate);
+        for (size_t i = 0; i < frames; ++i) {
+            out[i] = processSample(out[i]);
+        }
+
+        // Echoes keep the voice alive after its source has gone quiet
+        if (sourceGenerator->isActive()) {
+            tailRemaining = delayTailSamples(currentDelaySamples, feedback);
+        } else {
+            tailRemaining = std::max(tailRemaining - static_cast<float>(frames), 0.0f);
+        }
+    }
+
+    bool isActive() const override {
+        return tailRemaining > 0.0f || sourceGenerator->isActive();
+    }
 
+    void stop() override {
+        SoundGenerator::stop();
+        std::fill(delayBuffer.begin(), delayBuffer.end(), 0.0f);
+        tailRemaining = 0.0f;
+    }
+
+    // Runs one input sample through the delay line without pulling from the source
+    inline float processSample(float inputSample) {
         // Calculate read position with fractional delay
         float readPos = static_cast<float>(writeIndex) - currentDelaySamples;
         while (readPos < 0.0f) readPos += delayBuffer.size();
@@ -237,11 +336,12 @@ public:
 private:
     std::shared_ptr<SoundGenerator> sourceGenerator;
     float sampleRate;
-    std::vector<float> delayBuffer;
+    DspBuffer<float> delayBuffer;
     int writeIndex;
     float feedback;
     float mix;
     float currentDelaySamples;
+    float tailRemaining = 0.0f;
 };
 
 class InterpolatedChorus : public SoundGenerator {
@@ -265,39 +365,48 @@ public:
         }
     }
 
-    float generateSample(float sampleRate) override {
-        float inputSample = sourceGenerator->generateSample(sampleRate);
-        float outputSample = 0.0f;
+    // The source is not a child generator, so forward explicitly
+    void retune(float ratio) override {
+        sourceGenerator->retune(ratio);
+    }
 
-        // Update phase
-        phase += rate / sampleRate;
-        if (phase >= 1.0f) phase -= 1.0f;
+    void process(float* out, size_t frames, float sampleRate) override {
+        sourceGenerator->render(out, frames, sampleRate);
 
-        // Process each voice
-        for (int i = 0; i < numVoices; ++i) {
-            float voicePhase = phase + static_cast<float>(i) / numVoices;
-            if (voicePhase >= 1.0f) voicePhase -= 1.0f;
+        for (size_t n = 0; n < frames; ++n) {
+            float inputSample = out[n];
+            float outputSample = 0.0f;
 
-            // Calculate delay in milliseconds for modulation
-            float delayMs = depth * (0.5f + 0.5f * std::sin(2.0f * PI * voicePhase));
+            // Update phase
+            phase += rate / sampleRate;
+            if (phase >= 1.0f) phase -= 1.0f;
 
-            // Convert milliseconds to samples
-            float delaySamples = delayMs * sampleRate / 1000.0f;
+            // Process each voice
+            for (int i = 0; i < numVoices; ++i) {
+                float voicePhase = phase + static_cast<float>(i) / numVoices;
+                if (voicePhase >= 1.0f) voicePhase -= 1.0f;
 
-            // Apply a minimum delay to prevent zero delay
-            delaySamples = std::max(delaySamples, minimumDelaySamples);
+                // Calculate delay in milliseconds for modulation
+                float delayMs = depth * (0.5f + 0.5f * std::sin(2.0f * PI * voicePhase));
 
-            // Smoothly update delay time using interpolated delay
-            delayLines[i].setDelaySamples(delaySamples);
+                // Convert milliseconds to samples
+                float delaySamples = delayMs * sampleRate / 1000.0f;
 
-            // Generate sample from delay line
-            outputSample += delayLines[i].generateSample(sampleRate);
-        }
+                // Apply a minimum delay to prevent zero delay
+                delaySamples = std::max(delaySamples, minimumDelaySamples);
 
-        outputSample /= numVoices;
+                // Smoothly update delay time using interpolated delay
+                delayLines[i].setDelaySamples(delaySamples);
 
-        // Mix dry and wet signals
-        return inputSample * (1.0f - mix) + outputSample * mix;
+                // Feed the shared dry sample through this voice's delay line
+                outputSample += delayLines[i].processSample(inputSample);
+            }
+
+            outputSample /= numVoices;
+
+            // Mix dry and wet signals
+            out[n] = inputSample * (1.0f - mix) + outputSample * mix;
+        }
     }
 
 private:
@@ -349,23 +458,32 @@ public:
         addChildGenerator(sourceGenerator);
     }
 
-    float generateSample(float sampleRate) override {
-        float inputSample = sourceGenerator->generateSample(sampleRate);
-        float processedSample = 0.0f;
+    void process(float* out, size_t frames, float sampleRate) override {
+        sourceGenerator->render(out, frames, sampleRate);
 
-        // Process through each comb filter
+        // Run each filter over the whole block so its buffer stays hot in cache
+        std::fill(wet.begin(), wet.begin() + frames, 0.0f);
         for (auto& comb : combFilters) {
-            processedSample += comb.process(inputSample);
+            for (size_t i = 0; i < frames; ++i) {
+                wet[i] += comb.process(out[i]);
+            }
+        }
+        const float combNormalization = 1.0f / combFilters.size();
+        for (size_t i = 0; i < frames; ++i) {
+            wet[i] *= combNormalization;
         }
-        processedSample /= combFilters.size();
 
         // Process through all-pass filters
         for (auto& allPass : allPassFilters) {
-            processedSample = allPass.process(processedSample);
+            for (size_t i = 0; i < frames; ++i) {
+                wet[i] = allPass.process(wet[i]);
+            }
         }
 
         // Mix dry and wet signals
-        return processedSample * wetMix + inputSample * dryMix;
+        for (size_t i = 0; i < frames; ++i) {
+            out[i] = wet[i] * wetMix + out[i] * dryMix;
+        }
     }
 
 private:
@@ -425,6 +543,7 @@ private:
 
     std::vector<CombFilter> combFilters;
     std::vector<AllPassFilter> allPassFilters;
+    std::array<float, MAX_BLOCK_FRAMES> wet;
 
     CombFilter createCombFilter(float delayTime) {
         int delaySamples = static_cast<int>(delayTime);
@@ -477,20 +596,28 @@ public:
         addChildGenerator(sourceGenerator);
     }
 
-    float generateSample(float sampleRate) override {
-        float sample = sourceGenerator->generateSample(sampleRate);
+    void process(float* out, size_t frames, float sampleRate) override {
+        sourceGenerator->render(out, frames, sampleRate);
+        applyTremolo(out, frames, sampleRate);
+    }
+
+    // Modulates an already rendered source block in place
+    void applyTremolo(float* out, size_t frames, float sampleRate) {
+        for (size_t i = 0; i < frames; ++i) {
+            float sample = out[i];
 
-        // Update phase on every sample
-        updatePhase(sampleRate);
+            // Update phase on every sample
+            updatePhase(sampleRate);
 
-        // Check for zero crossing in both directions
-        if ((lastSample <= 0 && sample > 0) || (lastSample >= 0 && sample < 0)) 
-        {
-            updateAmplitude();
-        }
+            // Check for zero crossing in both directions
+            if ((lastSample <= 0 && sample > 0) || (lastSample >= 0 && sample < 0))
+            {
+                updateAmplitude();
+            }
 
-        lastSample = sample;
-        return sample * currentAmplitude;
+            lastSample = sample;
+            out[i] = sample * currentAmplitude;
+        }
     }
 
 private:
@@ -13,6 +13,10 @@ void HTTPAPIHandler::setParameterUpdateCallback(ParameterUpdateCallback callback
     parameterUpdateCallback = callback;
 }
 
+void HTTPAPIHandler::setParameterBatchUpdateCallback(ParameterBatchUpdateCallback callback) {
+    parameterBatchUpdateCallback = callback;
+}
+
 void HTTPAPIHandler::setVoiceChangeCallback(VoiceChangeCallback callback) {
     voiceChangeCallback = callback;
 }
@@ -21,64 +25,117 @@ void HTTPAPIHandler::setWaveformDataCallback(WaveformDataCallback callback) {
     waveformDataCallback = callback;
 }
 
-bool HTTPAPIHandler::handleAPIRequest(socket_t clientSocket, const std::string& method, const std::string& path, const std::string& body) {
+void HTTPAPIHandler::setParameterChangesCallback(ParameterChangesCallback callback) {
+    parameterChangesCallback = callback;
+}
+
+void HTTPAPIHandler::setStatsCallback(StatsCallback callback) {
+    statsCallback = callback;
+}
+
+void HTTPAPIHandler::setProfileReportCallback(ProfileReportCallback callback) {
+    profileReportCallback = callback;
+}
+
+void HTTPAPIHandler::setProfileEnableCallback(ProfileEnableCallback callback) {
+    profileEnableCallback = callback;
+}
+
+void HTTPAPIHandler::setScopeFrameCallback(ScopeFrameCallback callback) {
+    scopeFrameCallback = callback;
+}
+
+void HTTPAPIHandler::setScopeStreamCallback(ScopeStreamCallback callback) {
+    scopeStreamCallback = callback;
+}
+
+bool HTTPAPIHandler::handleAPIRequest(const HTTPConnection& connection, std::string_view method, const std::string& path, std::string_view bodyView) {
     if (method == "GET" && path == "/api/waveform") {
-        return handleWaveformRequest(clientSocket);
+        return handleWaveformRequest(connection);
+    }
+
+    if (method == "GET" && path == "/api/stats") {
+        if (!statsCallback) {
+            sendErrorResponse(connection, 500, "Stats not available");
+            return true;
+        }
+        sendJSONResponse(connection, 200, statsCallback());
+        return true;
+    }
+
+    if (method == "GET" && path.rfind("/api/scope/", 0) == 0) {
+        return handleScopeRequest(connection, path);
+    }
+
+    if (method == "GET" && path == "/api/profile") {
+        if (!profileReportCallback) {
+            sendErrorResponse(connection, 500, "Profiler not available");
+            return true;
+        }
+        sendJSONResponse(connection, 200, profileReportCallback());
+        return true;
+    }
+
+    if (method == "GET" && (path == "/api/parameters" || path.rfind("/api/parameters/since/", 0) == 0)) {
+        return handleParameterChangesRequest(connection, path);
     }
     
     if (method != "POST") {
-        sendErrorResponse(clientSocket, 405, "Method Not Allowed");
+        sendErrorResponse(connection, 405, "Method Not Allowed");
         return true;
     }
+    const std::string body(bodyView); // small JSON; the field extraction below works on strings
 
     if (path == "/api/parameter") {
-        return handleParameterUpdate(clientSocket, body);
+        return handleParameterUpdate(connection, body);
+    } else if (path == "/api/parameters") {
+        return handleParameterBatchUpdate(connection, body);
     } else if (path == "/api/voice") {
-        return handleVoiceChange(clientSocket, body);
+        return handleVoiceChange(connection, body);
+    } else if (path == "/api/profile") {
+        return handleProfileEnable(connection, body);
     } else {
-        sendErrorResponse(clientSocket, 404, "API endpoint not found");
+        sendErrorResponse(connection, 404, "API endpoint not found");
         return true;
     }
 }
 
-void HTTPAPIHandler::sendJSONResponse(socket_t clientSocket, int statusCode, const std::string& json) {
-    std::ostringstream response;
-    response << "HTTP/1.1 " << statusCode;
-    
-    switch (statusCode) {
-        case 200: response << " OK"; break;
-        case 400: response << " Bad Request"; break;
-        case 404: response << " Not Found"; break;
-        case 405: response << " Method Not Allowed"; break;
-        case 500: response << " Internal Server Error"; break;
-        default: response << " Unknown"; break;
-    }
-    
-    response << "\r\n";
-    response << "Content-Type: application/json\r\n";
-    response << "Content-Length: " << json.length() << "\r\n";
-    response << "Access-Control-Allow-Origin: *\r\n";
-    response << "Connection: close\r\n";
-    response << "\r\n";
-    response << json;
+void HTTPAPIHandler::sendJSONResponse(const HTTPConnection& connection, int statusCode, const std::string& json) {
+    std::string response;
+    response.reserve(160 + json.size());
+    appendResponseHead(response, statusCode, "application/json", json.size(), connection.keepAlive(),
+                       "Access-Control-Allow-Origin: *\r\n");
+    response += json;
+    connection.send(std::move(response));
+}
 
-    std::string responseStr = response.str();
-    send(clientSocket, responseStr.c_str(), responseStr.length(), 0);
+void HTTPAPIHandler::sendBinaryResponse(const HTTPConnection& connection, const std::string& data) {
+    std::string response;
+    response.reserve(192 + data.size());
+    appendResponseHead(response, 200, "application/octet-stream", data.size(), connection.keepAlive(),
+                       "Cache-Control: no-cache\r\n"
+                       "Access-Control-Allow-Origin: *\r\n");
+    response += data;
+    connection.send(std::move(response));
 }
 
-void HTTPAPIHandler::sendErrorResponse(socket_t clientSocket, int statusCode, const std::string& message) {
-    std::ostringstream json;
-    json << "{\"error\":\"" << message << "\"}";
-    sendJSONResponse(clientSocket, statusCode, json.str());
+void HTTPAPIHandler::sendNotModified(const HTTPConnection& connection) {
+    std::string response;
+    appendResponseHead(response, 304, "", NO_CONTENT_LENGTH, connection.keepAlive(), "Access-Control-Allow-Origin: *\r\n");
+    connection.send(std::move(response));
 }
 
-bool HTTPAPIHandler::handleParameterUpdate(socket_t clientSocket, const std::string& body) {
+void HTTPAPIHandler::sendErrorResponse(const HTTPConnection& connection, int statusCode, const std::string& message) {
+    sendJSONResponse(connection, statusCode, "{\"error\":\"" + message + "\"}");
+}
+
+bool HTTPAPIHandler::handleParameterUpdate(const HTTPConnection& connection, const std::string& body) {
     try {
         std::string paramName = extractJSONValue(body, "param");
         std::string valueStr = extractJSONValue(body, "value");
         
         if (paramName.empty() || valueStr.empty()) {
-            sendErrorResponse(clientSocket, 400, "Missing param or value in request");
+            sendErrorResponse(connection, 400, "Missing param or value in request");
             return true;
         }
         
@@ -88,23 +145,48 @@ bool HTTPAPIHandler::handleParameterUpdate(socket_t clientSocket, const std::str
             parameterUpdateCallback(paramName, paramValue);
         }
         
-        sendJSONResponse(clientSocket, 200, "{\"status\":\"success\"}");
+        sendJSONResponse(connection, 200, "{\"status\":\"success\"}");
         std::cout << "API: Parameter " << paramName << " updated to " << paramValue << std::endl;
         
     } catch (const std::exception& e) {
         std::cerr << "Error handling parameter update: " << e.what() << std::endl;
-        sendErrorResponse(clientSocket, 400, "Invalid request format");
+        sendErrorResponse(connection, 400, "Invalid request format");
     }
     
     return true;
 }
 
-bool HTTPAPIHandler::handleVoiceChange(socket_t clientSocket, const std::string& body) {
+// Body: {"params":{"Attack":0.2,"Decay":0.4}}. All values take effect in the same audio block.
+bool HTTPAPIHandler::handleParameterBatchUpdate(const HTTPConnection& connection, const std::string& body) {
+    try {
+        auto values = extractJSONNumberObject(body, "params");
+
+        if (values.empty()) {
+            sendErrorResponse(connection, 400, "Missing params in request");
+            return true;
+        }
+
+        if (parameterBatchUpdateCallback) {
+            parameterBatchUpdateCallback(values);
+        }
+
+        sendJSONResponse(connection, 200, "{\"status\":\"success\"}");
+        std::cout << "API: " << values.size() << " parameters updated" << std::endl;
+
+    } catch (const std::exception& e) {
+        std::cerr << "Error handling parameter batch update: " << e.what() << std::endl;
+        sendErrorResponse(connection, 400, "Invalid request format");
+    }
+
+    return true;
+}
+
+bool HTTPAPIHandler::handleVoiceChange(const HTTPConnection& connection, const std::string& body) {
     try {
         std::string voiceName = extractJSONValue(body, "voiceGenerator");
         
         if (voiceName.empty()) {
-            sendErrorResponse(clientSocket, 400, "Missing voiceGenerator in request");
+            sendErrorResponse(connection, 400, "Missing voiceGenerator in request");
             return true;
         }
         
@@ -112,17 +194,132 @@ bool HTTPAPIHandler::handleVoiceChange(socket_t clientSocket, const std::string&
             voiceChangeCallback(voiceName);
         }
         
-        sendJSONResponse(clientSocket, 200, "{\"status\":\"success\"}");
+        sendJSONResponse(connection, 200, "{\"status\":\"success\"}");
         std::cout << "API: Voice generator changed to " << voiceName << std::endl;
         
     } catch (const std::exception& e) {
         std::cerr << "Error handling voice change: " << e.what() << std::endl;
-        sendErrorResponse(clientSocket, 400, "Invalid request format");
+        sendErrorResponse(connection, 400, "Invalid request format");
     }
     
     return true;
 }
 
+// GET /api/parameters returns every parameter; GET /api/parameters/since/<version>
+// only those committed after <version> (or everything if the set of parameters
+// changed since then). Both responses carry the version to poll with next.
+bool HTTPAPIHandler::handleParameterChangesRequest(const HTTPConnection& connection, const std::string& path) {
+    if (!parameterChangesCallback) {
+        sendErrorResponse(connection, 500, "Parameters not available");
+        return true;
+    }
+
+    uint64_t since = 0;
+    const std::string prefix = "/api/parameters/since/";
+    if (path.size() > prefix.size()) {
+        try {
+            size_t parsed = 0;
+            const std::string versionStr = path.substr(prefix.size());
+            since = std::stoull(versionStr, &parsed);
+            if (parsed != versionStr.size()) {
+                throw std::invalid_argument(versionStr);
+            }
+        } catch (const std::exception&) {
+            sendErrorResponse(connection, 400, "Invalid version");
+            return true;
+        }
+    } else if (path != "/api/parameters") {
+        sendErrorResponse(connection, 400, "Missing version");
+        return true;
+    }
+
+    sendJSONResponse(connection, 200, parameterChangesCallback(since));
+    return true;
+}
+
+// Body: {"enabled":true} starts a fresh node profile, {"enabled":false} stops
+// it; the collected profile stays readable at GET /api/profile
+bool HTTPAPIHandler::handleProfileEnable(const HTTPConnection& connection, const std::string& body) {
+    if (!profileEnableCallback) {
+        sendErrorResponse(connection, 500, "Profiler not available");
+        return true;
+    }
+
+    size_t keyPos = body.find("\"enabled\":");
+    size_t valueStart = keyPos == std::string::npos ? keyPos : body.find_first_not_of(" \t", keyPos + 10);
+    if (valueStart == std::string::npos) {
+        sendErrorResponse(connection, 400, "Missing enabled in request");
+        return true;
+    }
+    const bool enabled = body.compare(valueStart, 4, "true") == 0;
+    if (!enabled && body.compare(valueStart, 5, "false") != 0) {
+        sendErrorResponse(connection, 400, "enabled must be true or false");
+        return true;
+    }
+
+    profileEnableCallback(enabled);
+    sendJSONResponse(connection, 200, "{\"status\":\"success\"}");
+    std::cout << "API: Node profiling " << (enabled ? "enabled" : "disabled") << std::endl;
+    return true;
+}
+
+// Binary scope frames (see ScopeFrame.cpp); <format> is f32, i16 or i16d:
+//   GET /api/scope/<format>                    the latest frame
+//   GET /api/scope/<format>/since/<position>   the same, or 304 while the scope has not moved on
+//                                              or stays silent
+//   GET /api/scope/stream/<format>/<fps>       one frame per 1/fps seconds on this connection,
+//                                              skipped while nothing new was played
+bool HTTPAPIHandler::handleScopeRequest(const HTTPConnection& connection, const std::string& path) {
+    std::vector<std::string> segments;
+    for (size_t start = std::string("/api/scope/").size(); start <= path.size();) {
+        size_t end = path.find('/', start);
+        if (end == std::string::npos) {
+            end = path.size();
+        }
+        segments.push_back(path.substr(start, end - start));
+        start = end + 1;
+    }
+
+    ScopeFormat format;
+    try {
+        if (segments.size() == 3 && segments[0] == "stream" && parseScopeFormat(segments[1], format)) {
+            if (!scopeStreamCallback) {
+                sendErrorResponse(connection, 500, "Scope not available");
+                return true;
+            }
+            const unsigned fps = static_cast<unsigned>(std::stoul(segments[2]));
+            scopeStreamCallback(connection, format, fps);
+            return false; // the stream owns the connection now
+        }
+
+        uint64_t since = UINT64_MAX;
+        if (segments.size() == 3 && segments[1] == "since") {
+            since = std::stoull(segments[2]);
+        } else if (segments.size() != 1) {
+            sendErrorResponse(connection, 404, "API endpoint not found");
+            return true;
+        }
+        if (!parseScopeFormat(segments[0], format)) {
+            sendErrorResponse(connection, 400, "Unknown scope format");
+            return true;
+        }
+        if (!scopeFrameCallback) {
+            sendErrorResponse(connection, 500, "Scope not available");
+            return true;
+        }
+
+        std::string frame;
+        if (scopeFrameCallback(format, since, frame)) {
+            sendBinaryResponse(connection, frame);
+        } else {
+            sendNotModified(connection);
+        }
+    } catch (const std::exception&) {
+        sendErrorResponse(connection, 400, "Invalid scope request");
+    }
+    return true;
+}
+
 std::string HTTPAPIHandler::extractJSONValue(const std::string& json, const std::string& key) {
     std::string searchKey = "\"" + key + "\":";
     size_t keyPos = json.find(searchKey);
@@ -160,6 +357,37 @@ std::string HTTPAPIHandler::extractJSONValue(const std::string& json, const std:
     }
 }
 
+// Reads a flat object of numbers, e.g. "key":{"a":1,"b":2.5}
+std::vector<std::pair<std::string, float>> HTTPAPIHandler::extractJSONNumberObject(const std::string& json, const std::string& key) {
+    std::vector<std::pair<std::string, float>> values;
+    size_t keyPos = json.find("\"" + key + "\":");
+    if (keyPos == std::string::npos) {
+        return values;
+    }
+    size_t pos = json.find('{', keyPos);
+    size_t end = json.find('}', pos);
+    if (pos == std::string::npos || end == std::string::npos) {
+        return values;
+    }
+
+    while (true) {
+        size_t nameStart = json.find('"', pos);
+        if (nameStart == std::string::npos || nameStart > end) {
+            break;
+        }
+        size_t nameEnd = json.find('"', nameStart + 1);
+        size_t colon = json.find(':', nameEnd);
+        if (nameEnd == std::string::npos || colon == std::string::npos || colon > end) {
+            break;
+        }
+        size_t valueEnd = json.find_first_of(",}", colon);
+        values.emplace_back(json.substr(nameStart + 1, nameEnd - nameStart - 1),
+                            parseFloat(json.substr(colon + 1, valueEnd - colon - 1)));
+        pos = valueEnd;
+    }
+    return values;
+}
+
 float HTTPAPIHandler::parseFloat(const std::string& str) {
     try {
         return std::stof(str);
@@ -170,10 +398,10 @@ float HTTPAPIHandler::parseFloat(const std::string& str) {
     }
 }
 
-bool HTTPAPIHandler::handleWaveformRequest(socket_t clientSocket) {
+bool HTTPAPIHandler::handleWaveformRequest(const HTTPConnection& connection) {
     try {
         if (!waveformDataCallback) {
-            sendErrorResponse(clientSocket, 500, "Waveform data not available");
+            sendErrorResponse(connection, 500, "Waveform data not available");
             return true;
         }
         
@@ -189,11 +417,11 @@ bool HTTPAPIHandler::handleWaveformRequest(socket_t clientSocket) {
         }
         json << "]}";
         
-        sendJSONResponse(clientSocket, 200, json.str());
+        sendJSONResponse(connection, 200, json.str());
         
     } catch (const std::exception& e) {
         std::cerr << "Error handling waveform request: " << e.what() << std::endl;
-        sendErrorResponse(clientSocket, 500, "Internal server error");
+        sendErrorResponse(connection, 500, "Internal server error");
     }
     
     return true;
@@ -1,49 +1,71 @@
 #pragma once
 
-#ifdef _WIN32
-#include <winsock2.h>
-#include <ws2tcpip.h>
-typedef SOCKET socket_t;
-#else
-#include <sys/socket.h>
-#include <netinet/in.h>
-#include <arpa/inet.h>
-#include <unistd.h>
-typedef int socket_t;
-#define INVALID_SOCKET -1
-#define SOCKET_ERROR -1
-#define closesocket close
-#endif
+#include "StaticServer.h"
 
 #include <string>
+#include <string_view>
 #include <functional>
+#include <utility>
+#include <vector>
+#include <cstdint>
+#include "ScopeFrame.cpp"
 
 class HTTPAPIHandler {
 public:
     // Callback function types
     using ParameterUpdateCallback = std::function<void(const std::string&, float)>;
+    using ParameterBatchUpdateCallback = std::function<void(const std::vector<std::pair<std::string, float>>&)>;
     using VoiceChangeCallback = std::function<void(const std::string&)>;
     using WaveformDataCallback = std::function<std::vector<float>()>;
+    using ParameterChangesCallback = std::function<std::string(uint64_t since)>;
+    using StatsCallback = std::function<std::string()>;
+    using ProfileReportCallback = std::function<std::string()>;
+    using ProfileEnableCallback = std::function<void(bool)>;
+    // Fills frame and returns true, or returns false if the scope is still at position `since`
+    using ScopeFrameCallback = std::function<bool(ScopeFormat format, uint64_t since, std::string& frame)>;
+    // Takes over the connection and pushes frames to it
+    using ScopeStreamCallback = std::function<void(const HTTPConnection& connection, ScopeFormat format, unsigned fps)>;
 
     HTTPAPIHandler();
     ~HTTPAPIHandler();
 
     void setParameterUpdateCallback(ParameterUpdateCallback callback);
+    void setParameterBatchUpdateCallback(ParameterBatchUpdateCallback callback);
     void setVoiceChangeCallback(VoiceChangeCallback callback);
     void setWaveformDataCallback(WaveformDataCallback callback);
+    void setParameterChangesCallback(ParameterChangesCallback callback);
+    void setStatsCallback(StatsCallback callback);
+    void setProfileReportCallback(ProfileReportCallback callback);
+    void setProfileEnableCallback(ProfileEnableCallback callback);
+    void setScopeFrameCallback(ScopeFrameCallback callback);
+    void setScopeStreamCallback(ScopeStreamCallback callback);
     
-    bool handleAPIRequest(socket_t clientSocket, const std::string& method, const std::string& path, const std::string& body);
+    bool handleAPIRequest(const HTTPConnection& connection, std::string_view method, const std::string& path, std::string_view body);
 
 private:
     ParameterUpdateCallback parameterUpdateCallback;
+    ParameterBatchUpdateCallback parameterBatchUpdateCallback;
     VoiceChangeCallback voiceChangeCallback;
     WaveformDataCallback waveformDataCallback;
+    ParameterChangesCallback parameterChangesCallback;
+    StatsCallback statsCallback;
+    ProfileReportCallback profileReportCallback;
+    ProfileEnableCallback profileEnableCallback;
+    ScopeFrameCallback scopeFrameCallback;
+    ScopeStreamCallback scopeStreamCallback;
 
-    void sendJSONResponse(socket_t clientSocket, int statusCode, const std::string& json);
-    void sendErrorResponse(socket_t clientSocket, int statusCode, const std::string& message);
-    bool handleParameterUpdate(socket_t clientSocket, const std::string& body);
-    bool handleVoiceChange(socket_t clientSocket, const std::string& body);
-    bool handleWaveformRequest(socket_t clientSocket);
+    void sendJSONResponse(const HTTPConnection& connection, int statusCode, const std::string& json);
+    void sendErrorResponse(const HTTPConnection& connection, int statusCode, const std::string& message);
+    bool handleParameterUpdate(const HTTPConnection& connection, const std::string& body);
+    bool handleParameterBatchUpdate(const HTTPConnection& connection, const std::string& body);
+    bool handleVoiceChange(const HTTPConnection& connection, const std::string& body);
+    bool handleWaveformRequest(const HTTPConnection& connection);
+    bool handleParameterChangesRequest(const HTTPConnection& connection, const std::string& path);
+    bool handleProfileEnable(const HTTPConnection& connection, const std::string& body);
+    bool handleScopeRequest(const HTTPConnection& connection, const std::string& path);
+    void sendBinaryResponse(const HTTPConnection& connection, const std::string& data);
+    void sendNotModified(const HTTPConnection& connection);
     std::string extractJSONValue(const std::string& json, const std::string& key);
+    std::vector<std::pair<std::string, float>> extractJSONNumberObject(const std::string& json, const std::string& key);
     float parseFloat(const std::string& str);
 }; 
\ No newline at end of file
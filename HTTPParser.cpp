@@ -0,0 +1,372 @@
+#pragma once
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// HTTP/1.1 request parsing and response heads for StaticServer.
+//
+// HTTPRequestParser works on a connection's receive buffer as bytes arrive:
+// each parse() continues where the last one stopped, so a request that
+// trickles in is scanned once. It records offsets rather than pointers,
+// because the buffer may grow (and move) between calls; request() turns
+// them into string_views once the request is complete. Chunked bodies are
+// decoded in place, each chunk's data moved down over the chunk headers,
+// so every body ends up contiguous in the buffer without a copy. Whatever
+// follows the request (a pipelined request, WebSocket frames) is left
+// where it is; consumed() says where it starts.
+
+inline bool equalsIgnoreCase(std::string_view a, std::string_view b) {
+    return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), [](char x, char y) {
+        return std::tolower(static_cast<unsigned char>(x)) == std::tolower(static_cast<unsigned char>(y));
+    });
+}
+
+// True if the comma-separated header value lists token, e.g. "keep-alive, Upgrade"
+inline bool headerHasToken(std::string_view value, std::string_view token) {
+    while (!value.empty()) {
+        size_t comma = value.find(',');
+        std::string_view item = value.substr(0, comma);
+        size_t start = item.find_first_not_of(" \t");
+        size_t end = item.find_last_not_of(" \t");
+        if (start != std::string_view::npos && equalsIgnoreCase(item.substr(start, end - start + 1), token)) {
+            return true;
+        }
+        if (comma == std::string_view::npos) {
+            break;
+        }
+        value.remove_prefix(comma + 1);
+    }
+    return false;
+}
+
+struct HTTPRequest {
+    std::string_view method;
+    std::string_view target; // as sent, query included
+    std::string_view version;
+    std::vector<std::pair<std::string_view, std::string_view>> headers; // values without surrounding whitespace
+    std::string_view body;   // decoded if it was chunked
+    bool keepAlive = false;
+
+    // Case-insensitive; empty if absent
+    std::string_view header(std::string_view name) const {
+        for (const auto& [headerName, value] : headers) {
+            if (equalsIgnoreCase(headerName, name)) {
+                return value;
+            }
+        }
+        return {};
+    }
+};
+
+class HTTPRequestParser {
+public:
+    enum class Status { Incomplete, Complete, Error };
+
+    static constexpr size_t MAX_HEAD_BYTES = 64 * 1024;
+    static constexpr size_t MAX_CHUNK_LINE_BYTES = 1024;
+
+    explicit HTTPRequestParser(size_t maxBodyBytes) : maxBodyBytes(maxBodyBytes) {
+        reset();
+    }
+
+    // Parses on from the last call with what the buffer holds now. May
+    // rewrite bytes past the head (chunk decoding), never before it.
+    Status parse(std::string& buffer) {
+        while (true) {
+            switch (stage) {
+            case Stage::Head:
+                if (!parseHead(buffer)) {
+                    return stage == Stage::Failed ? Status::Error : Status::Incomplete;
+                }
+                break;
+            case Stage::Body:
+                if (buffer.size() < bodyEnd) {
+                    return Status::Incomplete;
+                }
+                readPosition = bodyEnd;
+                stage = Stage::Done;
+                break;
+            case Stage::ChunkSize:
+            case Stage::ChunkData:
+            case Stage::ChunkDataEnd:
+            case Stage::Trailers:
+                if (!parseChunked(buffer)) {
+                    return stage == Stage::Failed ? Status::Error : Status::Incomplete;
+                }
+                break;
+            case Stage::Done:
+                return Status::Complete;
+            case Stage::Failed:
+                return Status::Error;
+            }
+        }
+    }
+
+    // Once parse() returned Complete: the request as views into buffer,
+    // valid until the buffer changes. Reuses out's header storage.
+    void request(const std::string& buffer, HTTPRequest& out) const {
+        const std::string_view text(buffer);
+        out.method = text.substr(method.offset, method.length);
+        out.target = text.substr(target.offset, target.length);
+        out.version = text.substr(version.offset, version.length);
+        out.headers.clear();
+        for (const auto& [name, value] : headers) {
+            out.headers.emplace_back(text.substr(name.offset, name.length), text.substr(value.offset, value.length));
+        }
+        out.body = text.substr(headEnd, bodyEnd - headEnd);
+        out.keepAlive = keepAlive;
+    }
+
+    bool keepsAlive() const { return keepAlive; }
+
+    // Bytes at the front of the buffer that belonged to the request
+    size_t consumed() const { return readPosition; }
+
+    // After Error: the status to answer with
+    int errorStatus() const { return error; }
+
+    // Ready for the next request; the caller removes consumed() bytes first
+    void reset() {
+        stage = Stage::Head;
+        scanned = 0;
+        headEnd = bodyEnd = readPosition = 0;
+        chunkRemaining = 0;
+        headers.clear();
+        keepAlive = false;
+        error = 0;
+    }
+
+private:
+    enum class Stage { Head, Body, ChunkSize, ChunkData, ChunkDataEnd, Trailers, Done, Failed };
+
+    struct Range {
+        size_t offset;
+        size_t length;
+    };
+
+    size_t maxBodyBytes;
+    Stage stage;
+    size_t scanned;      // Head: bytes already searched for the blank line
+    size_t headEnd;      // just past the blank line; the body starts here
+    size_t bodyEnd;      // end of the (decoded so far) body
+    size_t readPosition; // chunked: first byte not yet decoded; when Done: end of the request
+    size_t chunkRemaining;
+    Range method{0, 0};
+    Range target{0, 0};
+    Range version{0, 0};
+    std::vector<std::pair<Range, Range>> headers;
+    bool keepAlive;
+    int error;
+
+    bool fail(int status) {
+        error = status;
+        stage = Stage::Failed;
+        return false;
+    }
+
+    bool parseHead(const std::string& buffer) {
+        // Resume the search a few bytes back, in case the terminator straddles two reads
+        size_t end = buffer.find("\r\n\r\n", scanned > 3 ? scanned - 3 : 0);
+        if (end == std::string::npos) {
+            scanned = buffer.size();
+            return buffer.size() > MAX_HEAD_BYTES ? fail(431) : false;
+        }
+        if (end > MAX_HEAD_BYTES) {
+            return fail(431);
+        }
+        headEnd = end + 4;
+        const std::string_view head(buffer.data(), end + 2); // every line with its CRLF
+
+        // Request line: METHOD SP TARGET SP VERSION
+        size_t lineEnd = head.find("\r\n");
+        std::string_view line = head.substr(0, lineEnd);
+        size_t firstSpace = line.find(' ');
+        size_t secondSpace = firstSpace == std::string_view::npos ? firstSpace : line.find(' ', firstSpace + 1);
+        if (secondSpace == std::string_view::npos || firstSpace == 0 || secondSpace == firstSpace + 1) {
+            return fail(400);
+        }
+        method = {0, firstSpace};
+        target = {firstSpace + 1, secondSpace - firstSpace - 1};
+        version = {secondSpace + 1, line.size() - secondSpace - 1};
+        const std::string_view versionText = line.substr(secondSpace + 1);
+        if (versionText != "HTTP/1.1" && versionText != "HTTP/1.0") {
+            return fail(versionText.substr(0, 5) == "HTTP/" ? 505 : 400);
+        }
+
+        std::string_view connection;
+        std::string_view transferEncoding;
+        std::string_view contentLength;
+        for (size_t start = lineEnd + 2; start < head.size();) {
+            size_t next = head.find("\r\n", start);
+            line = head.substr(start, next - start);
+            size_t colon = line.find(':');
+            if (colon == std::string_view::npos || colon == 0 || line[0] == ' ' || line[0] == '\t') {
+                return fail(400); // also rejects obsolete line folding
+            }
+            size_t valueStart = line.find_first_not_of(" \t", colon + 1);
+            size_t valueEnd = line.find_last_not_of(" \t");
+            Range value{start + colon + 1, 0};
+            if (valueStart != std::string_view::npos) {
+                value = {start + valueStart, valueEnd - valueStart + 1};
+            }
+            headers.push_back({{start, colon}, value});
+
+            const std::string_view name = line.substr(0, colon);
+            const std::string_view valueText = head.substr(value.offset, value.length);
+            if (equalsIgnoreCase(name, "Connection")) {
+                connection = valueText;
+            } else if (equalsIgnoreCase(name, "Transfer-Encoding")) {
+                transferEncoding = valueText;
+            } else if (equalsIgnoreCase(name, "Content-Length")) {
+                if (!contentLength.empty() && contentLength != valueText) {
+                    return fail(400);
+                }
+                contentLength = valueText;
+            }
+            start = next + 2;
+        }
+
+        keepAlive = versionText == "HTTP/1.1" ? !headerHasToken(connection, "close")
+                                              : headerHasToken(connection, "keep-alive");
+
+        bodyEnd = headEnd;
+        readPosition = headEnd;
+        if (!transferEncoding.empty()) {
+            // Both framings at once is how requests get smuggled past proxies
+            if (!contentLength.empty()) {
+                return fail(400);
+            }
+            if (!equalsIgnoreCase(transferEncoding, "chunked")) {
+                return fail(501);
+            }
+            stage = Stage::ChunkSize;
+            return true;
+        }
+        if (!contentLength.empty()) {
+            size_t length = 0;
+            auto [parsedEnd, status] = std::from_chars(contentLength.data(), contentLength.data() + contentLength.size(), length);
+            if (status != std::errc() || parsedEnd != contentLength.data() + contentLength.size()) {
+                return fail(400);
+            }
+            if (length > maxBodyBytes) {
+                return fail(413);
+            }
+            bodyEnd = headEnd + length;
+        }
+        stage = Stage::Body;
+        return true;
+    }
+
+    bool parseChunked(std::string& buffer) {
+        while (true) {
+            if (stage == Stage::ChunkSize || stage == Stage::Trailers) {
+                size_t lineEnd = buffer.find("\r\n", readPosition);
+                if (lineEnd == std::string::npos) {
+                    return buffer.size() - readPosition > MAX_CHUNK_LINE_BYTES ? fail(400) : false;
+                }
+                if (lineEnd - readPosition > MAX_CHUNK_LINE_BYTES) {
+                    return fail(400);
+                }
+                if (stage == Stage::Trailers) {
+                    const bool lastLine = lineEnd == readPosition;
+                    readPosition = lineEnd + 2;
+                    if (lastLine) {
+                        stage = Stage::Done;
+                        return true;
+                    }
+                    continue; // trailer fields are ignored
+                }
+
+                // hex size, optionally followed by ";extensions"
+                const char* first = buffer.data() + readPosition;
+                size_t size = 0;
+                auto [parsedEnd, status] = std::from_chars(first, buffer.data() + lineEnd, size, 16);
+                if (status != std::errc() || (parsedEnd != buffer.data() + lineEnd && *parsedEnd != ';' && *parsedEnd != ' ' && *parsedEnd != '\t')) {
+                    return fail(400);
+                }
+                readPosition = lineEnd + 2;
+                if (size == 0) {
+                    stage = Stage::Trailers;
+                    continue;
+                }
+                if (size > maxBodyBytes - (bodyEnd - headEnd)) {
+                    return fail(413);
+                }
+                chunkRemaining = size;
+                stage = Stage::ChunkData;
+            } else if (stage == Stage::ChunkData) {
+                const size_t available = std::min(buffer.size() - readPosition, chunkRemaining);
+                if (bodyEnd != readPosition) {
+                    std::memmove(&buffer[bodyEnd], &buffer[readPosition], available);
+                }
+                bodyEnd += available;
+                readPosition += available;
+                chunkRemaining -= available;
+                if (chunkRemaining > 0) {
+                    return false;
+                }
+                stage = Stage::ChunkDataEnd;
+            } else {
+                if (buffer.size() - readPosition < 2) {
+                    return false;
+                }
+                if (buffer.compare(readPosition, 2, "\r\n") != 0) {
+                    return fail(400);
+                }
+                readPosition += 2;
+                stage = Stage::ChunkSize;
+            }
+        }
+    }
+};
+
+inline const char* httpStatusText(int status) {
+    switch (status) {
+    case 101: return "Switching Protocols";
+    case 200: return "OK";
+    case 304: return "Not Modified";
+    case 400: return "Bad Request";
+    case 404: return "Not Found";
+    case 405: return "Method Not Allowed";
+    case 413: return "Payload Too Large";
+    case 431: return "Request Header Fields Too Large";
+    case 500: return "Internal Server Error";
+    case 501: return "Not Implemented";
+    case 505: return "HTTP Version Not Supported";
+    default: return "Unknown";
+    }
+}
+
+constexpr size_t NO_CONTENT_LENGTH = SIZE_MAX;
+
+// Appends a status line and headers up to the blank line. contentType is
+// left out when empty, Content-Length when NO_CONTENT_LENGTH; extraHeaders
+// are whole "Name: value\r\n" lines.
+inline void appendResponseHead(std::string& out, int status, std::string_view contentType, size_t contentLength,
+                               bool keepAlive, std::string_view extraHeaders = {}) {
+    char number[24];
+    out += "HTTP/1.1 ";
+    out.append(number, std::to_chars(number, number + sizeof(number), status).ptr);
+    out += ' ';
+    out += httpStatusText(status);
+    out += "\r\n";
+    if (!contentType.empty()) {
+        out += "Content-Type: ";
+        out += contentType;
+        out += "\r\n";
+    }
+    if (contentLength != NO_CONTENT_LENGTH) {
+        out += "Content-Length: ";
+        out.append(number, std::to_chars(number, number + sizeof(number), contentLength).ptr);
+        out += "\r\n";
+    }
+    out += extraHeaders;
+    out += keepAlive ? "Connection: keep-alive\r\n\r\n" : "Connection: close\r\n\r\n";
+}
@@ -0,0 +1,376 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <typeinfo>
+#include <vector>
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define MSOUND_HAS_TSC 1
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define MSOUND_HAS_TSC 1
+#endif
+#if defined(__GNUG__)
+#include <cxxabi.h>
+#endif
+
+inline std::atomic<bool>& nodeProfilingFlag() {
+    static std::atomic<bool> enabled{false};
+    return enabled;
+}
+
+// Checked by every SoundGenerator::render(); the only cost while profiling is off
+inline bool nodeProfilingEnabled() {
+    return nodeProfilingFlag().load(std::memory_order_relaxed);
+}
+
+// Opt-in CPU profile of the sound graph. While enabled, SoundGenerator::render()
+// reads the timestamp counter around each node's process() and adds the
+// cycles to the slot for the node's place in the graph: its parent's slot,
+// its type and its first parameter name. Every voice of a preset therefore
+// adds to the same slots, and the report is one tree for the whole graph.
+//
+// Each thread keeps the slot it is rendering and the cycles spent in nested
+// nodes in a thread_local frame, so a node's self time excludes its children
+// whether or not they are listed in childGenerators.
+//
+// Slots are claimed lock-free from a fixed table and never move or change
+// owner; resetting only zeroes their counters. Once the table is full,
+// further nodes are counted in droppedCalls instead.
+class NodeProfiler {
+    // The slot a thread is rendering and the cycles of the nodes nested in it so far
+    struct Frame {
+        int slot;
+        uint64_t childCycles;
+    };
+
+public:
+    static constexpr int NO_SLOT = -1;
+    static constexpr int UNRESOLVED_SLOT = -2; // for callers caching findSlot: not looked up yet
+    static constexpr size_t MAX_SLOTS = 1024;
+    static constexpr size_t LABEL_SIZE = 48;
+
+    static NodeProfiler& instance() {
+        static NodeProfiler profiler;
+        return profiler;
+    }
+
+    // Cycles on the x86 timestamp counter, nanoseconds elsewhere
+    static uint64_t readCounter() {
+#ifdef MSOUND_HAS_TSC
+        return __rdtsc();
+#else
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+    }
+
+    // Turning profiling on starts a fresh profile
+    void setEnabled(bool enabled) {
+        if (enabled && !nodeProfilingEnabled()) {
+            reset();
+        }
+        nodeProfilingFlag().store(enabled, std::memory_order_relaxed);
+    }
+
+    void reset() {
+        for (auto& slot : slots) {
+            slot.calls.store(0, std::memory_order_relaxed);
+            slot.frames.store(0, std::memory_order_relaxed);
+            slot.totalCycles.store(0, std::memory_order_relaxed);
+            slot.selfCycles.store(0, std::memory_order_relaxed);
+        }
+        droppedCalls.store(0, std::memory_order_relaxed);
+        startCounter.store(readCounter(), std::memory_order_relaxed);
+        startNanos.store(steadyNanos(), std::memory_order_relaxed);
+    }
+
+    // Slot of the node `type` (labelled by its first parameter) under the
+    // current thread's slot; NO_SLOT once the table is full
+    int findSlot(const std::type_info& type, const char* label) {
+        const int parent = currentFrame().slot;
+        char key[LABEL_SIZE] = {};
+        std::strncpy(key, label, LABEL_SIZE - 1);
+        const uint64_t hash = hashKey(parent, type, key);
+
+        for (size_t probe = 0; probe < MAX_SLOTS; ++probe) {
+            const size_t index = (hash + probe) % MAX_SLOTS;
+            Slot& slot = slots[index];
+            int state = slot.state.load(std::memory_order_acquire);
+            if (state == EMPTY && slot.state.compare_exchange_strong(state, CLAIMED, std::memory_order_acquire)) {
+                slot.hash = hash;
+                slot.parent = parent;
+                slot.type = &type;
+                std::memcpy(slot.label, key, LABEL_SIZE);
+                slot.state.store(READY, std::memory_order_release);
+                return static_cast<int>(index);
+            }
+            while (state == CLAIMED) {
+                state = slot.state.load(std::memory_order_acquire);
+            }
+            if (slot.hash == hash && slot.parent == parent && *slot.type == type
+                && std::strncmp(slot.label, key, LABEL_SIZE) == 0) {
+                return static_cast<int>(index);
+            }
+        }
+        return NO_SLOT;
+    }
+
+    // Times one process() call of the node in `slot` and makes it the
+    // parent of the nodes rendered meanwhile on this thread
+    class Timer {
+    public:
+        Timer(int slot, size_t frames) : slot(slot), frames(frames), parent(currentFrame()) {
+            currentFrame() = {slot, 0};
+            start = readCounter();
+        }
+
+        ~Timer() {
+            const uint64_t total = readCounter() - start;
+            const uint64_t children = currentFrame().childCycles;
+            instance().add(slot, frames, total, total > children ? total - children : 0);
+            currentFrame() = {parent.slot, parent.childCycles + total};
+        }
+
+        Timer(const Timer&) = delete;
+        Timer& operator=(const Timer&) = delete;
+
+    private:
+        int slot;
+        size_t frames;
+        Frame parent;
+        uint64_t start;
+    };
+
+    // Makes `slot` the parent on a thread that renders on another thread's
+    // behalf, e.g. a voice render pool worker
+    class ParentScope {
+    public:
+        explicit ParentScope(int slot) : previous(currentFrame()) {
+            currentFrame() = {slot, 0};
+        }
+        ~ParentScope() {
+            currentFrame() = previous;
+        }
+
+        ParentScope(const ParentScope&) = delete;
+        ParentScope& operator=(const ParentScope&) = delete;
+
+    private:
+        Frame previous;
+    };
+
+    static int currentSlot() {
+        return currentFrame().slot;
+    }
+
+    // {"type":"node_profile","enabled":true,"counter":"tsc","seconds":...,
+    //  "cyclesPerUs":...,"droppedCalls":0,"nodes":[<tree>],"byType":[...]}
+    // Each tree node has type, label, path, calls, frames, totalCycles,
+    // selfCycles, selfUs, selfPercent and children; byType sums self time
+    // per node type.
+    std::string toJSON() const {
+        std::vector<Entry> entries;
+        uint64_t allSelf = 0;
+        for (size_t i = 0; i < MAX_SLOTS; ++i) {
+            const Slot& slot = slots[i];
+            if (slot.state.load(std::memory_order_acquire) != READY) {
+                continue;
+            }
+            Entry entry;
+            entry.index = static_cast<int>(i);
+            entry.parent = slot.parent;
+            entry.type = typeName(*slot.type);
+            entry.label = slot.label;
+            entry.calls = slot.calls.load(std::memory_order_relaxed);
+            entry.frames = slot.frames.load(std::memory_order_relaxed);
+            entry.totalCycles = slot.totalCycles.load(std::memory_order_relaxed);
+            entry.selfCycles = slot.selfCycles.load(std::memory_order_relaxed);
+            allSelf += entry.selfCycles;
+            entries.push_back(std::move(entry));
+        }
+
+        const uint64_t elapsedNanos = steadyNanos() - startNanos.load(std::memory_order_relaxed);
+        const uint64_t elapsedCounter = readCounter() - startCounter.load(std::memory_order_relaxed);
+        const double cyclesPerUs = elapsedNanos > 0 ? elapsedCounter * 1000.0 / elapsedNanos : 1000.0;
+        auto microseconds = [&](uint64_t cycles) { return cycles / std::max(cyclesPerUs, 1e-9); };
+        auto percent = [&](uint64_t cycles) { return allSelf ? 100.0 * cycles / allSelf : 0.0; };
+
+        // Slots with no calls since the last reset belong to earlier presets
+        std::function<std::string(int, const std::string&)> children = [&](int parent, const std::string& parentPath) {
+            std::vector<const Entry*> nodes;
+            for (const auto& entry : entries) {
+                if (entry.parent == parent && entry.calls > 0) {
+                    nodes.push_back(&entry);
+                }
+            }
+            std::sort(nodes.begin(), nodes.end(),
+                      [](const Entry* a, const Entry* b) { return a->totalCycles > b->totalCycles; });
+            std::string json = "[";
+            for (const Entry* entry : nodes) {
+                std::string path = parentPath + "/" + entry->type;
+                if (!entry->label.empty()) {
+                    path += "[" + entry->label + "]";
+                }
+                json += (json.size() > 1 ? ",{" : "{");
+                json += "\"type\":\"" + escape(entry->type) + "\",\"label\":\"" + escape(entry->label)
+                      + "\",\"path\":\"" + escape(path)
+                      + "\",\"calls\":" + std::to_string(entry->calls)
+                      + ",\"frames\":" + std::to_string(entry->frames)
+                      + ",\"totalCycles\":" + std::to_string(entry->totalCycles)
+                      + ",\"selfCycles\":" + std::to_string(entry->selfCycles)
+                      + ",\"selfUs\":" + formatNumber(microseconds(entry->selfCycles))
+                      + ",\"selfPercent\":" + formatNumber(percent(entry->selfCycles))
+                      + ",\"children\":" + children(entry->index, path) + "}";
+            }
+            return json + "]";
+        };
+
+        std::vector<std::pair<std::string, uint64_t>> byType;
+        for (const auto& entry : entries) {
+            auto it = std::find_if(byType.begin(), byType.end(),
+                                   [&](const auto& item) { return item.first == entry.type; });
+            if (it == byType.end()) {
+                byType.emplace_back(entry.type, entry.selfCycles);
+            } else {
+                it->second += entry.selfCycles;
+            }
+        }
+        std::sort(byType.begin(), byType.end(), [](const auto& a, const auto& b) { return a.second > b.second; });
+
+        std::string json = std::string("{\"type\":\"node_profile\",\"enabled\":") + (nodeProfilingEnabled() ? "true" : "false")
+#ifdef MSOUND_HAS_TSC
+                         + ",\"counter\":\"tsc\""
+#else
+                         + ",\"counter\":\"ns\""
+#endif
+                         + ",\"seconds\":" + formatNumber(elapsedNanos * 1e-9)
+                         + ",\"cyclesPerUs\":" + formatNumber(cyclesPerUs)
+                         + ",\"droppedCalls\":" + std::to_string(droppedCalls.load(std::memory_order_relaxed))
+                         + ",\"nodes\":" + children(NO_SLOT, "") + ",\"byType\":[";
+        bool first = true;
+        for (const auto& [type, cycles] : byType) {
+            if (cycles == 0) {
+                continue;
+            }
+            json += (first ? "{" : ",{");
+            json += "\"type\":\"" + escape(type) + "\",\"selfCycles\":" + std::to_string(cycles)
+                  + ",\"selfUs\":" + formatNumber(microseconds(cycles))
+                  + ",\"selfPercent\":" + formatNumber(percent(cycles)) + "}";
+            first = false;
+        }
+        return json + "]}";
+    }
+
+private:
+    enum SlotState : int { EMPTY, CLAIMED, READY };
+
+    // Identity fields are written once, before state turns READY
+    struct alignas(64) Slot {
+        std::atomic<int> state{EMPTY};
+        uint64_t hash = 0;
+        int parent = NO_SLOT;
+        const std::type_info* type = nullptr;
+        char label[LABEL_SIZE] = {};
+        std::atomic<uint64_t> calls{0};
+        std::atomic<uint64_t> frames{0};
+        std::atomic<uint64_t> totalCycles{0};
+        std::atomic<uint64_t> selfCycles{0};
+    };
+
+    struct Entry {
+        int index;
+        int parent;
+        std::string type;
+        std::string label;
+        uint64_t calls, frames, totalCycles, selfCycles;
+    };
+
+    std::array<Slot, MAX_SLOTS> slots;
+    std::atomic<uint64_t> droppedCalls{0};
+    std::atomic<uint64_t> startCounter{readCounter()};
+    std::atomic<uint64_t> startNanos{steadyNanos()};
+
+    NodeProfiler() = default;
+
+    static Frame& currentFrame() {
+        thread_local Frame frame{NO_SLOT, 0};
+        return frame;
+    }
+
+    void add(int slot, size_t frames, uint64_t total, uint64_t self) {
+        if (slot == NO_SLOT) {
+            droppedCalls.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        Slot& target = slots[slot];
+        target.calls.fetch_add(1, std::memory_order_relaxed);
+        target.frames.fetch_add(frames, std::memory_order_relaxed);
+        target.totalCycles.fetch_add(total, std::memory_order_relaxed);
+        target.selfCycles.fetch_add(self, std::memory_order_relaxed);
+    }
+
+    static uint64_t steadyNanos() {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    static uint64_t hashKey(int parent, const std::type_info& type, const char* label) {
+        uint64_t hash = 1469598103934665603ull ^ static_cast<uint64_t>(type.hash_code());
+        hash = (hash ^ static_cast<uint32_t>(parent)) * 1099511628211ull;
+        for (const char* c = label; *c; ++c) {
+            hash = (hash ^ static_cast<unsigned char>(*c)) * 1099511628211ull;
+        }
+        return hash;
+    }
+
+    // Readable class name without template arguments: "Voice<...>"
+    static std::string typeName(const std::type_info& type) {
+        std::string name = type.name();
+#if defined(__GNUG__)
+        int status = 0;
+        char* demangled = abi::__cxa_demangle(type.name(), nullptr, nullptr, &status);
+        if (status == 0 && demangled) {
+            name = demangled;
+        }
+        std::free(demangled);
+#else
+        for (const char* prefix : {"class ", "struct "}) {
+            if (name.rfind(prefix, 0) == 0) {
+                name.erase(0, std::strlen(prefix));
+            }
+        }
+#endif
+        const size_t templateStart = name.find('<');
+        if (templateStart != std::string::npos) {
+            name = name.substr(0, templateStart) + "<...>";
+        }
+        return name;
+    }
+
+    static std::string escape(const std::string& text) {
+        std::string escaped;
+        for (char c : text) {
+            if (c == '"' || c == '\\') {
+                escaped += '\\';
+            }
+            escaped += c;
+        }
+        return escaped;
+    }
+
+    static std::string formatNumber(double value) {
+        char buffer[32];
+        std::snprintf(buffer, sizeof(buffer), "%.6g", value);
+        return buffer;
+    }
+};
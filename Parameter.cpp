@@ -3,7 +3,39 @@
 #include <string>
 #include <functional>
 #include <iostream>
+#include <atomic>
+#include <array>
+#include "LockFreeQueue.cpp"
 
+// One counter orders every observable parameter change: value commits stamp
+// the parameters they touch, and structural changes (parameters added,
+// removed or renamed anywhere in a generator tree) move
+// parameterStructureVersion(). Clients compare versions to fetch only what
+// changed since they last looked.
+inline std::atomic<uint64_t>& parameterVersionCounter() {
+    static std::atomic<uint64_t> counter{0};
+    return counter;
+}
+
+inline uint64_t nextParameterVersion() {
+    return parameterVersionCounter().fetch_add(1, std::memory_order_relaxed) + 1;
+}
+
+inline std::atomic<uint64_t>& parameterStructureVersion() {
+    static std::atomic<uint64_t> version{0};
+    return version;
+}
+
+inline void markParameterStructureChanged() {
+    parameterStructureVersion().store(nextParameterVersion(), std::memory_order_release);
+}
+
+// Parameter values cross threads in one direction only: control threads (HTTP,
+// MIDI, keyboard) publish with requestValue() or a ParameterBatch, and the
+// audio thread runs the onChange callbacks from applyParameterChanges() at the
+// start of a block. Callbacks therefore never race the DSP code they touch.
+// setValue() applies at once on the calling thread and is meant for graph
+// construction and for callbacks that already run on the audio thread.
 class Parameter {
 public:
     using Callback = std::function<void(float)>;
@@ -11,24 +43,27 @@ public:
     Parameter(const std::string& name, float initialValue, float minValue, float maxValue, float stepSize, const std::string& unit, Callback onChange = nullptr)
         : name(name), currentValue(initialValue), minValue(minValue), maxValue(maxValue), stepSize(stepSize), unit(unit), onChange(onChange) {}
 
-    float getValue() const { return currentValue; }
+    // Latest requested value, safe to read from any thread
+    float getValue() const { return currentValue.load(std::memory_order_relaxed); }
+
     void setValue(float value) {
-        if (value < minValue || value > maxValue) {
+        if (!inRange(value)) {
             std::cerr << "Value out of range!" << std::endl;
             return;
         }
-        currentValue = value;
-        if (onChange) {
-            onChange(currentValue);
-        }
+        currentValue.store(value, std::memory_order_relaxed);
+        apply(value);
     }
 
+    // Publishes value for the audio thread to apply at its next block boundary
+    bool requestValue(float value);
+
     void increment() {
-        setValue(currentValue + stepSize);
+        requestValue(getValue() + stepSize);
     }
 
     void decrement() {
-        setValue(currentValue - stepSize);
+        requestValue(getValue() - stepSize);
     }
 
     float getMinValue() const { return minValue; }
@@ -36,14 +71,118 @@ public:
     float getStepSize() const { return stepSize; }
     std::string getUnit() const { return unit; }
     std::string getName() const { return name; }
-    
-    void setName(const std::string& newName) { name = newName; }
+
+    // Version of the last committed value change (see parameterVersionCounter)
+    uint64_t getVersion() const { return version.load(std::memory_order_acquire); }
+
+    void setName(const std::string& newName) {
+        name = newName;
+        markParameterStructureChanged();
+    }
 private:
+    friend class ParameterBatch;
+    friend void applyParameterChanges();
+
     std::string name;
-    float currentValue;
+    std::atomic<float> currentValue;
+    std::atomic<uint64_t> version{0};
     float minValue;
     float maxValue;
     float stepSize;
     std::string unit;
     Callback onChange;
-};
\ No newline at end of file
+
+    bool inRange(float value) const { return value >= minValue && value <= maxValue; }
+
+    void apply(float value) {
+        if (onChange) {
+            onChange(value);
+        }
+    }
+};
+
+struct ParameterChange {
+    Parameter* parameter;
+    float value;
+};
+
+// Up to MAX_CHANGES edits that the audio thread applies within one block
+struct ParameterChangeBatch {
+    static constexpr size_t MAX_CHANGES = 32;
+
+    std::array<ParameterChange, MAX_CHANGES> changes;
+    size_t count = 0;
+};
+
+inline LockFreeQueue<ParameterChangeBatch, 128>& parameterChangeQueue() {
+    static LockFreeQueue<ParameterChangeBatch, 128> queue;
+    return queue;
+}
+
+// Batches applyParameterChanges() has finished, i.e. popped from the queue and
+// run the callbacks of. Once it reaches a parameterChangeQueue().pushCount()
+// read earlier, every batch queued before that read is done with its
+// Parameter pointers, so their owner may be freed.
+inline std::atomic<uint64_t>& appliedParameterBatches() {
+    static std::atomic<uint64_t> applied{0};
+    return applied;
+}
+
+// Collects edits that must take effect together, e.g. a preset recall or a
+// multi-parameter HTTP request, and publishes them as one batch
+class ParameterBatch {
+public:
+    bool set(Parameter& parameter, float value) {
+        if (!parameter.inRange(value)) {
+            std::cerr << "Value out of range!" << std::endl;
+            return false;
+        }
+        if (batch.count == ParameterChangeBatch::MAX_CHANGES) {
+            std::cerr << "Parameter batch full, dropped " << parameter.getName() << std::endl;
+            return false;
+        }
+        batch.changes[batch.count++] = {&parameter, value};
+        return true;
+    }
+
+    bool empty() const { return batch.count == 0; }
+
+    bool commit() {
+        if (batch.count == 0) {
+            return true;
+        }
+        if (!parameterChangeQueue().push(batch)) {
+            std::cerr << "Parameter change queue full, dropped " << batch.count << " changes" << std::endl;
+            batch.count = 0;
+            return false;
+        }
+        const uint64_t version = nextParameterVersion();
+        for (size_t i = 0; i < batch.count; ++i) {
+            Parameter* parameter = batch.changes[i].parameter;
+            parameter->currentValue.store(batch.changes[i].value, std::memory_order_relaxed);
+            parameter->version.store(version, std::memory_order_release);
+        }
+        batch.count = 0;
+        return true;
+    }
+
+private:
+    ParameterChangeBatch batch;
+};
+
+inline bool Parameter::requestValue(float value) {
+    ParameterBatch batch;
+    return batch.set(*this, value) && batch.commit();
+}
+
+// Audio thread only: runs the callbacks of every published change. Call once
+// per block before rendering.
+inline void applyParameterChanges() {
+    ParameterChangeBatch batch;
+    while (parameterChangeQueue().pop(batch)) {
+        for (size_t i = 0; i < batch.count; ++i) {
+            batch.changes[i].parameter->apply(batch.changes[i].value);
+        }
+        appliedParameterBatches().fetch_add(1, std::memory_order_release);
+    }
+}
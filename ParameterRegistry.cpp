@@ -0,0 +1,68 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <cstdint>
+#include <unordered_map>
+#include "Parameter.cpp"
+
+using ParameterId = uint32_t;
+constexpr ParameterId INVALID_PARAMETER_ID = UINT32_MAX;
+
+// Integer IDs for the parameters of one preset, assigned when its voices are
+// built. Each ID owns a dense array of target slots (the matching Parameter
+// of every voice), so a broadcast is one indexed loop with no lookups or
+// allocation. Names are resolved once through a hash map; the HTTP and MIDI
+// layers cache the ID rather than searching by string on every change.
+//
+// A registry is immutable once published. It is the preset's parameter list
+// for every control thread (HTTP, SSE, WebSocket, MIDI, keyboard), shared
+// through ActiveTones::getParameterRegistry(); the voice set keeps it alive
+// for as long as the voices whose parameters it points at.
+class ParameterRegistry {
+public:
+    ParameterId add(std::shared_ptr<Parameter> parameter, std::vector<Parameter*> targets = {}) {
+        const ParameterId id = static_cast<ParameterId>(entries.size());
+        ids.emplace(parameter->getName(), id);
+        entries.push_back({std::move(parameter), std::move(targets)});
+        return id;
+    }
+
+    ParameterId find(const std::string& name) const {
+        auto it = ids.find(name);
+        return it != ids.end() ? it->second : INVALID_PARAMETER_ID;
+    }
+
+    Parameter* get(ParameterId id) const {
+        return id < entries.size() ? entries[id].parameter.get() : nullptr;
+    }
+
+    Parameter* get(const std::string& name) const {
+        return get(find(name));
+    }
+
+    size_t size() const { return entries.size(); }
+
+    // Parameter version (see parameterVersionCounter) at which this registry
+    // replaced the previous one; clients that saw an older one refetch it all
+    uint64_t getStructureVersion() const { return structureVersion; }
+    void setStructureVersion(uint64_t version) { structureVersion = version; }
+
+    // Audio thread: sets the value on every voice's copy of the parameter
+    void broadcast(ParameterId id, float value) const {
+        for (Parameter* target : entries[id].targets) {
+            target->setValue(value);
+        }
+    }
+
+private:
+    struct Entry {
+        std::shared_ptr<Parameter> parameter; // the preset-level parameter shown in the GUI
+        std::vector<Parameter*> targets;      // one slot per voice, in note order
+    };
+
+    std::vector<Entry> entries;
+    std::unordered_map<std::string, ParameterId> ids;
+    uint64_t structureVersion = 0;
+};
@@ -0,0 +1,164 @@
+#pragma once
+
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <cstdio>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include "ParameterRegistry.cpp"
+
+// Serialized "all_params" message for the current preset, kept between
+// requests. The text is rebuilt only when a new parameter registry has been
+// published (a preset switch or pool resize). The registry is held only while
+// a call runs, never between requests, so a replaced preset can be freed
+// (see ActiveTones::collectRetiredVoices). Value changes
+// are patched in place: every value (and the overall version) sits in a
+// fixed-width, space-padded field, so a changed number overwrites its old
+// digits without moving the rest of the message.
+//
+//   {"type":"all_params","version":42   ,"params":[{"name":"Attack","value":0.2     ,...}]}
+class ParameterTreeCache {
+public:
+    // Returns the registry currently published, e.g. ActiveTones::getParameterRegistry
+    using RegistrySource = std::function<std::shared_ptr<const ParameterRegistry>()>;
+
+    explicit ParameterTreeCache(RegistrySource source) : source(std::move(source)) {}
+
+    std::string allParams() {
+        std::lock_guard<std::mutex> lock(mutex);
+        refresh();
+        return json;
+    }
+
+    // Parameters committed after `since`, as
+    //   {"type":"param_changes","version":57,"params":[{"name":"Attack","value":0.4}]}
+    // A client that last saw an older structure gets the full all_params message instead.
+    std::string changesSince(uint64_t since) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto registry = refresh(); // keeps the slots' parameters alive
+        if (since < structureVersion) {
+            return json;
+        }
+
+        std::string changes = "{\"type\":\"param_changes\",\"version\":" + std::to_string(version) + ",\"params\":[";
+        bool first = true;
+        char value[VALUE_WIDTH + 1];
+        for (const auto& slot : slots) {
+            if (slot.version <= since) {
+                continue;
+            }
+            if (!first) {
+                changes += ',';
+            }
+            first = false;
+            std::snprintf(value, sizeof(value), "%g", slot.value);
+            changes += "{\"name\":\"" + slot.parameter->getName() + "\",\"value\":" + value + "}";
+        }
+        changes += "]}";
+        return changes;
+    }
+
+    uint64_t getVersion() {
+        std::lock_guard<std::mutex> lock(mutex);
+        refresh();
+        return version;
+    }
+
+private:
+    static constexpr size_t VALUE_WIDTH = 15;   // fits "%.7g" of any float
+    static constexpr size_t VERSION_WIDTH = 20; // fits any uint64_t
+
+    struct Slot {
+        Parameter* parameter;
+        size_t valueOffset; // position of the value field in json
+        uint64_t version;
+        float value;
+    };
+
+    RegistrySource source;
+    std::mutex mutex;
+    std::string json;
+    std::vector<Slot> slots;
+    size_t versionOffset = 0;
+    uint64_t structureVersion = UINT64_MAX;
+    uint64_t version = 0;
+
+    // Brings json up to date with the published registry and returns it; the
+    // slots point into it, so callers hold it while they use them. Structure
+    // versions are unique, so an equal one means the same registry.
+    std::shared_ptr<const ParameterRegistry> refresh() {
+        auto registry = source();
+        if (!registry || registry->getStructureVersion() != structureVersion) {
+            rebuild(registry.get());
+            return registry;
+        }
+
+        bool patched = false;
+        for (auto& slot : slots) {
+            const uint64_t slotVersion = slot.parameter->getVersion();
+            if (slotVersion == slot.version) {
+                continue;
+            }
+            slot.version = slotVersion;
+            slot.value = slot.parameter->getValue();
+            writeField(slot.valueOffset, VALUE_WIDTH, "%.7g", slot.value);
+            version = std::max(version, slotVersion);
+            patched = true;
+        }
+        if (patched) {
+            writeField(versionOffset, VERSION_WIDTH, "%llu", static_cast<unsigned long long>(version));
+        }
+        return registry;
+    }
+
+    void rebuild(const ParameterRegistry* registry) {
+        structureVersion = registry ? registry->getStructureVersion() : 0;
+        version = structureVersion;
+        slots.clear();
+        json = "{\"type\":\"all_params\",\"version\":";
+        versionOffset = json.size();
+        json.append(VERSION_WIDTH, ' ');
+        json += ",\"params\":[";
+
+        const size_t count = registry ? registry->size() : 0;
+        for (ParameterId id = 0; id < count; ++id) {
+            Parameter* param = registry->get(id);
+            json += "{\"name\":\"" + param->getName() + "\",\"value\":";
+            slots.push_back({param, json.size(), param->getVersion(), param->getValue()});
+            json.append(VALUE_WIDTH, ' ');
+            json += ",\"min\":" + formatNumber(param->getMinValue())
+                  + ",\"max\":" + formatNumber(param->getMaxValue())
+                  + ",\"step\":" + formatNumber(param->getStepSize())
+                  + ",\"unit\":\"" + param->getUnit() + "\"}";
+            if (id + 1 < count) {
+                json += ',';
+            }
+            version = std::max(version, slots.back().version);
+        }
+        json += "]}";
+
+        for (const auto& slot : slots) {
+            writeField(slot.valueOffset, VALUE_WIDTH, "%.7g", slot.value);
+        }
+        writeField(versionOffset, VERSION_WIDTH, "%llu", static_cast<unsigned long long>(version));
+    }
+
+    // Writes a number left-aligned into a space-padded field of json
+    template <typename T>
+    void writeField(size_t offset, size_t width, const char* format, T value) {
+        char buffer[32];
+        int length = std::snprintf(buffer, sizeof(buffer), format, value);
+        length = std::clamp(length, 0, static_cast<int>(width));
+        std::copy(buffer, buffer + length, json.begin() + offset);
+        std::fill(json.begin() + offset + length, json.begin() + offset + width, ' ');
+    }
+
+    static std::string formatNumber(float value) {
+        char buffer[32];
+        std::snprintf(buffer, sizeof(buffer), "%g", value);
+        return buffer;
+    }
+};
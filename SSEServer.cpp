@@ -10,21 +10,30 @@ SSEServer::~SSEServer() {
     cleanup();
 }
 
-void SSEServer::addClient(socket_t clientSocket) {
-    std::lock_guard<std::mutex> lock(clientsMutex);
-    clients.push_back(clientSocket);
-    sendSSEHeaders(clientSocket);
-    std::cout << "SSE client connected. Total clients: " << clients.size() << std::endl;
-    
-    // Send initial state if callback is set
-    if (initialStateCallback) {
-        initialStateCallback(clientSocket);
+void SSEServer::addClient(const HTTPConnection& connection) {
+    {
+        std::lock_guard<std::mutex> lock(clientsMutex);
+        clients.push_back(connection);
+        sendSSEHeaders(connection);
+        std::cout << "SSE client connected. Total clients: " << clients.size() << std::endl;
+
+        // Send initial state if callback is set
+        if (initialStateCallback) {
+            initialStateCallback(connection);
+        }
     }
+    connection.setCloseHandler([this, connection]() {
+        removeClient(connection);
+    });
 }
 
-void SSEServer::removeClient(socket_t clientSocket) {
+void SSEServer::removeClient(const HTTPConnection& connection) {
     std::lock_guard<std::mutex> lock(clientsMutex);
-    clients.erase(std::remove(clients.begin(), clients.end(), clientSocket), clients.end());
+    auto it = std::find(clients.begin(), clients.end(), connection);
+    if (it == clients.end()) {
+        return;
+    }
+    clients.erase(it);
     std::cout << "SSE client disconnected. Total clients: " << clients.size() << std::endl;
 }
 
@@ -47,23 +56,27 @@ void SSEServer::setInitialStateCallback(InitialStateCallback callback) {
     initialStateCallback = callback;
 }
 
-void SSEServer::sendInitialState(socket_t clientSocket, const std::string& allParamsJson, const std::string& allVoicesJson) {
+void SSEServer::sendInitialState(const HTTPConnection& connection, const std::string& allParamsJson, const std::string& allVoicesJson) {
     // Send all parameters
-    sendSSEEvent(clientSocket, allParamsJson);
+    sendSSEEvent(connection, allParamsJson);
     
     // Send all voices
-    sendSSEEvent(clientSocket, allVoicesJson);
+    sendSSEEvent(connection, allVoicesJson);
 }
 
 void SSEServer::cleanup() {
-    std::lock_guard<std::mutex> lock(clientsMutex);
-    for (auto client : clients) {
-        closesocket(client);
+    std::vector<HTTPConnection> closing;
+    {
+        std::lock_guard<std::mutex> lock(clientsMutex);
+        closing.swap(clients);
+    }
+    // Outside the lock: closing runs the close handler, which takes it
+    for (const auto& client : closing) {
+        client.close();
     }
-    clients.clear();
 }
 
-void SSEServer::sendSSEHeaders(socket_t clientSocket) {
+void SSEServer::sendSSEHeaders(const HTTPConnection& connection) {
     std::string headers = 
         "HTTP/1.1 200 OK\r\n"
         "Content-Type: text/event-stream\r\n"
@@ -72,71 +85,28 @@ void SSEServer::sendSSEHeaders(socket_t clientSocket) {
         "Access-Control-Allow-Origin: *\r\n"
         "\r\n";
     
-    send(clientSocket, headers.c_str(), headers.length(), 0);
+    connection.send(headers);
 }
 
-void SSEServer::sendSSEEvent(socket_t clientSocket, const std::string& data, const std::string& event) {
-    if (!isSocketValid(clientSocket)) {
-        return;
-    }
-
-    std::ostringstream oss;
+std::string SSEServer::formatSSEEvent(const std::string& data, const std::string& event) {
+    std::string message;
     if (!event.empty()) {
-        oss << "event: " << event << "\n";
-    }
-    oss << "data: " << data << "\n\n";
-    
-    std::string message = oss.str();
-    int result = send(clientSocket, message.c_str(), message.length(), 0);
-    
-    if (result == SOCKET_ERROR) {
-        std::cout << "Failed to send SSE event to client, will remove from list" << std::endl;
-        // Note: We can't remove from clients list here due to mutex issues
-        // The client will be removed when the connection is detected as broken
+        message += "event: " + event + "\n";
     }
+    message += "data: " + data + "\n\n";
+    return message;
+}
+
+bool SSEServer::sendSSEEvent(const HTTPConnection& connection, const std::string& data, const std::string& event) {
+    return connection.send(formatSSEEvent(data, event));
 }
 
+// Sends never block: each client's events queue up in the server's event
+// loop, and a client that stops reading is dropped there
 void SSEServer::broadcastSSEEvent(const std::string& data, const std::string& event) {
+    const std::string message = formatSSEEvent(data, event);
     std::lock_guard<std::mutex> lock(clientsMutex);
-    std::vector<socket_t> disconnectedClients;
-    
-    for (auto client : clients) {
-        if (!isSocketValid(client)) {
-            disconnectedClients.push_back(client);
-            continue;
-        }
-        
-        std::ostringstream oss;
-        if (!event.empty()) {
-            oss << "event: " << event << "\n";
-        }
-        oss << "data: " << data << "\n\n";
-        
-        std::string message = oss.str();
-        int result = send(client, message.c_str(), message.length(), 0);
-        
-        if (result == SOCKET_ERROR) {
-            disconnectedClients.push_back(client);
-        }
-    }
-    
-    // Remove disconnected clients
-    for (auto disconnectedClient : disconnectedClients) {
-        clients.erase(std::remove(clients.begin(), clients.end(), disconnectedClient), clients.end());
-        closesocket(disconnectedClient);
-    }
-    
-    if (!disconnectedClients.empty()) {
-        std::cout << "Removed " << disconnectedClients.size() << " disconnected SSE clients. Active clients: " << clients.size() << std::endl;
+    for (const auto& client : clients) {
+        client.send(message);
     }
 }
-
-bool SSEServer::isSocketValid(socket_t clientSocket) {
-    if (clientSocket == INVALID_SOCKET) {
-        return false;
-    }
-    
-    // Quick check by trying to send 0 bytes
-    int result = send(clientSocket, "", 0, 0);
-    return result != SOCKET_ERROR;
-} 
\ No newline at end of file
@@ -1,19 +1,6 @@
 #pragma once
 
-#ifdef _WIN32
-#include <winsock2.h>
-#include <ws2tcpip.h>
-typedef SOCKET socket_t;
-#else
-#include <sys/socket.h>
-#include <netinet/in.h>
-#include <arpa/inet.h>
-#include <unistd.h>
-typedef int socket_t;
-#define INVALID_SOCKET -1
-#define SOCKET_ERROR -1
-#define closesocket close
-#endif
+#include "StaticServer.h"
 
 #include <string>
 #include <vector>
@@ -23,26 +10,26 @@ typedef int socket_t;
 
 class SSEServer {
 public:
-    using InitialStateCallback = std::function<void(socket_t)>;
+    using InitialStateCallback = std::function<void(const HTTPConnection&)>;
     
     SSEServer();
     ~SSEServer();
 
-    void addClient(socket_t clientSocket);
-    void removeClient(socket_t clientSocket);
+    void addClient(const HTTPConnection& connection);
+    void removeClient(const HTTPConnection& connection);
     void broadcastParameterUpdate(const std::string& paramName, float paramValue);
     void broadcastVoiceChange(const std::string& voiceName);
     void broadcastSSEEvent(const std::string& data, const std::string& event = "");
-    void sendInitialState(socket_t clientSocket, const std::string& allParamsJson, const std::string& allVoicesJson);
+    void sendInitialState(const HTTPConnection& connection, const std::string& allParamsJson, const std::string& allVoicesJson);
     void setInitialStateCallback(InitialStateCallback callback);
     void cleanup();
 
 private:
-    std::vector<socket_t> clients;
+    std::vector<HTTPConnection> clients;
     std::mutex clientsMutex;
     InitialStateCallback initialStateCallback;
 
-    void sendSSEHeaders(socket_t clientSocket);
-    void sendSSEEvent(socket_t clientSocket, const std::string& data, const std::string& event = "");
-    bool isSocketValid(socket_t clientSocket);
+    void sendSSEHeaders(const HTTPConnection& connection);
+    bool sendSSEEvent(const HTTPConnection& connection, const std::string& data, const std::string& event = "");
+    static std::string formatSSEEvent(const std::string& data, const std::string& event);
 }; 
\ No newline at end of file
@@ -0,0 +1,174 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "StaticServer.h"
+#include "ScopeFrame.cpp"
+#include "AudioEngine.cpp"
+
+// Pushes binary scope frames (ScopeFrame.cpp) to the clients of
+// /api/scope/stream/<format>/<fps>, each at its own rate. One thread serves
+// all streams: on every tick it takes a single snapshot of the tap and
+// encodes it once per format in use. A stream whose scope has not moved on
+// since its last frame gets nothing, and neither does one that was already
+// sent a silent frame while the output stays silent (ScopeTap::unchangedSince),
+// so an idle engine costs no traffic.
+//
+// The response has no length; frames follow each other until either side
+// closes. A stream whose previous frame is still queued in the server skips
+// the tick, so a slow client sees fewer frames instead of older ones.
+class ScopeStreamer {
+public:
+    static constexpr unsigned MAX_FPS = 60;
+
+    ScopeStreamer(const AudioEngine::WaveformTap& tap, size_t samplesPerFrame)
+        : tap(tap), samples(samplesPerFrame) {}
+
+    ~ScopeStreamer() {
+        stop();
+    }
+
+    void start() {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (running) {
+            return;
+        }
+        running = true;
+        thread = std::thread(&ScopeStreamer::run, this);
+    }
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            running = false;
+        }
+        wake.notify_one();
+        if (thread.joinable()) {
+            thread.join();
+        }
+        for (const auto& client : pendingClients) {
+            client.connection.close();
+        }
+        pendingClients.clear();
+    }
+
+    // Takes over the connection: sends the response headers, then frames until the client goes away
+    void addClient(const HTTPConnection& connection, ScopeFormat format, unsigned fps) {
+        const std::string headers =
+            "HTTP/1.1 200 OK\r\n"
+            "Content-Type: application/octet-stream\r\n"
+            "Cache-Control: no-cache\r\n"
+            "Access-Control-Allow-Origin: *\r\n"
+            "Connection: close\r\n"
+            "\r\n";
+        if (!connection.send(headers)) {
+            return;
+        }
+
+        Client client;
+        client.connection = connection;
+        client.format = format;
+        client.period = std::chrono::microseconds(1000000 / std::clamp(fps, 1u, MAX_FPS));
+        client.nextFrame = std::chrono::steady_clock::now();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            pendingClients.push_back(client);
+        }
+        wake.notify_one();
+        std::cout << "Scope stream client connected at " << std::clamp(fps, 1u, MAX_FPS) << " fps" << std::endl;
+    }
+
+private:
+    struct Client {
+        HTTPConnection connection;
+        ScopeFormat format;
+        std::chrono::steady_clock::duration period;
+        std::chrono::steady_clock::time_point nextFrame;
+        uint64_t lastPosition = UINT64_MAX;
+    };
+
+    const AudioEngine::WaveformTap& tap;
+    std::vector<float> samples;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::vector<Client> pendingClients; // guarded by mutex; handed to the thread
+    bool running = false;               // guarded by mutex
+    std::thread thread;
+
+    void run() {
+        std::vector<Client> clients; // owned by this thread
+        std::array<std::string, 3> frames; // per ScopeFormat, for the current tick
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                auto hasWork = [&]() { return !running || !pendingClients.empty(); };
+                if (clients.empty()) {
+                    wake.wait(lock, hasWork);
+                } else {
+                    auto next = clients.front().nextFrame;
+                    for (const auto& client : clients) {
+                        next = std::min(next, client.nextFrame);
+                    }
+                    wake.wait_until(lock, next, hasWork);
+                }
+                if (!running) {
+                    break;
+                }
+                clients.insert(clients.end(), pendingClients.begin(), pendingClients.end());
+                pendingClients.clear();
+            }
+
+            // One snapshot per tick, taken when the first due stream needs it
+            const auto now = std::chrono::steady_clock::now();
+            uint64_t position = 0;
+            bool captured = false;
+            for (auto& frame : frames) {
+                frame.clear();
+            }
+            for (auto it = clients.begin(); it != clients.end();) {
+                Client& client = *it;
+                if (client.nextFrame > now) {
+                    ++it;
+                    continue;
+                }
+                client.nextFrame += client.period;
+                if (client.nextFrame < now) {
+                    client.nextFrame = now + client.period; // fell behind; do not send a burst
+                }
+
+                if (tap.unchangedSince(client.lastPosition, samples.size()) || client.connection.queuedBytes() > 0) {
+                    ++it;
+                    continue;
+                }
+                if (!captured) {
+                    position = tap.snapshot(samples.data(), samples.size());
+                    captured = true;
+                }
+                std::string& frame = frames[static_cast<size_t>(client.format)];
+                if (frame.empty()) {
+                    encodeScopeFrame(samples.data(), samples.size(), position, client.format, frame);
+                }
+                if (!client.connection.send(frame)) {
+                    it = clients.erase(it);
+                    std::cout << "Scope stream client disconnected" << std::endl;
+                    continue;
+                }
+                client.lastPosition = position;
+                ++it;
+            }
+        }
+
+        for (const auto& client : clients) {
+            client.connection.close();
+        }
+    }
+};
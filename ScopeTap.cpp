@@ -0,0 +1,107 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+#include "SoundGenerator.cpp"
+
+// Wait-free tap on an audio stream for the GUI scope: the audio thread
+// appends blocks to a ring, and any number of reader threads copy the most
+// recent samples without ever making the writer wait.
+//
+// The ring works like a seqlock. `written` counts every sample ever
+// appended; the writer publishes each block with a single release store
+// after copying it in. A reader copies the samples it wants, then loads
+// `written` again: if the writer could have started overwriting any of them
+// in the meantime (it may be up to one block ahead of what it published),
+// the copy is discarded and retried. Samples are relaxed atomics, so a torn
+// copy is detected rather than being a data race.
+//
+// CAPACITY leaves room for one block beyond the largest snapshot, so a read
+// only retries when it takes longer than a whole block period.
+template <size_t CAPACITY>
+class ScopeTap {
+    static_assert((CAPACITY & (CAPACITY - 1)) == 0, "CAPACITY must be a power of two");
+
+public:
+    static constexpr size_t MAX_SNAPSHOT = CAPACITY - MAX_BLOCK_FRAMES;
+
+    ScopeTap() {
+        for (auto& sample : ring) {
+            sample.store(0.0f, std::memory_order_relaxed);
+        }
+    }
+
+    // Audio thread (the only writer); frames <= MAX_BLOCK_FRAMES
+    void write(const float* samples, size_t frames) {
+        const uint64_t start = written.load(std::memory_order_relaxed);
+        // Orders the stores below after the previous publish, for readers
+        // that check `written` after copying
+        std::atomic_thread_fence(std::memory_order_release);
+        size_t soundEnd = 0; // one past the block's last non-zero sample
+        for (size_t i = 0; i < frames; ++i) {
+            ring[(start + i) & MASK].store(samples[i], std::memory_order_relaxed);
+            if (samples[i] != 0.0f) {
+                soundEnd = i + 1;
+            }
+        }
+        if (soundEnd > 0) {
+            soundWritten.store(start + soundEnd, std::memory_order_relaxed);
+        }
+        written.store(start + frames, std::memory_order_release);
+    }
+
+    // Total samples written so far; a reader can skip a copy when this has not moved
+    uint64_t position() const {
+        return written.load(std::memory_order_acquire);
+    }
+
+    // True if the `window` samples ending at position() look the same as the
+    // ones ending at `since` did: nothing was written since, or both windows
+    // are all silence (exact zeros). A scope client holding the frame at
+    // `since` then has nothing new to see.
+    bool unchangedSince(uint64_t since, size_t window) const {
+        const uint64_t end = written.load(std::memory_order_acquire);
+        if (since == end) {
+            return true;
+        }
+        // soundWritten is at least as new as `end` here, so this errs on "changed"
+        return since < end && soundWritten.load(std::memory_order_relaxed) + window <= since;
+    }
+
+    // Copies the `count` (<= MAX_SNAPSHOT) most recent samples into out, oldest
+    // first; slots before the first write read as silence. Returns the
+    // position() the snapshot ends at.
+    uint64_t snapshot(float* out, size_t count) const {
+        count = std::min(count, MAX_SNAPSHOT);
+        while (true) {
+            const uint64_t end = written.load(std::memory_order_acquire);
+            const uint64_t start = end - count; // may wrap below zero; those slots are still silent
+            for (size_t i = 0; i < count; ++i) {
+                out[i] = ring[(start + i) & MASK].load(std::memory_order_relaxed);
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            const uint64_t now = written.load(std::memory_order_relaxed);
+            // The writer may be filling [now, now + MAX_BLOCK_FRAMES), which
+            // must not have reached the oldest sample copied (modular arithmetic)
+            if (now + MAX_BLOCK_FRAMES - start <= CAPACITY) {
+                return end;
+            }
+        }
+    }
+
+    std::vector<float> snapshot(size_t count) const {
+        std::vector<float> samples(std::min(count, MAX_SNAPSHOT));
+        snapshot(samples.data(), samples.size());
+        return samples;
+    }
+
+private:
+    static constexpr uint64_t MASK = CAPACITY - 1;
+
+    std::array<std::atomic<float>, CAPACITY> ring;
+    alignas(64) std::atomic<uint64_t> written{0};
+    std::atomic<uint64_t> soundWritten{0}; // position just after the last non-zero sample
+};
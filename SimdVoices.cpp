@@ -0,0 +1,363 @@
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <random>
+#include <algorithm>
+#include <cstdint>
+#include "SoundGenerator.cpp"
+#include "math.cpp"
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Structure-of-arrays voice bank for the simple presets ("Sine Oscillator",
+// "FM Voice", "Bass"): an optional sine modulator with self-feedback driving a
+// sine carrier, shaped by a linear ADSR. Phase, phase increment, envelope
+// stage/level/slope and velocity of every MIDI note live in contiguous arrays
+// and are rendered SimdFloat::width notes per instruction.
+//
+// The width is fixed at compile time; there is no runtime dispatch. The
+// documented build lines target baseline x86-64, so a default build runs
+// 4 lanes (SSE2). Adding -mavx2 (or -march=native on an AVX machine) to the
+// build line opts into 8 lanes, and the binary then needs an AVX CPU. Other
+// targets fall back to 1 lane. The bank logs its width when it is built and
+// benchmark prints it.
+
+#if defined(__AVX__)
+struct SimdFloat {
+    static constexpr int width = 8;
+    __m256 v;
+
+    static SimdFloat load(const float* p) { return {_mm256_load_ps(p)}; }
+    static SimdFloat set(float x) { return {_mm256_set1_ps(x)}; }
+    void store(float* p) const { _mm256_store_ps(p, v); }
+
+    friend SimdFloat operator+(SimdFloat a, SimdFloat b) { return {_mm256_add_ps(a.v, b.v)}; }
+    friend SimdFloat operator-(SimdFloat a, SimdFloat b) { return {_mm256_sub_ps(a.v, b.v)}; }
+    friend SimdFloat operator*(SimdFloat a, SimdFloat b) { return {_mm256_mul_ps(a.v, b.v)}; }
+    friend SimdFloat operator&(SimdFloat a, SimdFloat b) { return {_mm256_and_ps(a.v, b.v)}; }
+    friend SimdFloat operator|(SimdFloat a, SimdFloat b) { return {_mm256_or_ps(a.v, b.v)}; }
+
+    // Comparisons return all-ones lanes where true
+    static SimdFloat greaterEqual(SimdFloat a, SimdFloat b) { return {_mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ)}; }
+    static SimdFloat lessEqual(SimdFloat a, SimdFloat b) { return {_mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ)}; }
+    static SimdFloat less(SimdFloat a, SimdFloat b) { return {_mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ)}; }
+    static SimdFloat equal(SimdFloat a, SimdFloat b) { return {_mm256_cmp_ps(a.v, b.v, _CMP_EQ_OQ)}; }
+    static SimdFloat select(SimdFloat mask, SimdFloat a, SimdFloat b) { return {_mm256_blendv_ps(b.v, a.v, mask.v)}; }
+    static SimdFloat abs(SimdFloat a) { return {_mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v)}; }
+    static SimdFloat signOf(SimdFloat a) { return {_mm256_and_ps(_mm256_set1_ps(-0.0f), a.v)}; }
+    static SimdFloat xorBits(SimdFloat a, SimdFloat b) { return {_mm256_xor_ps(a.v, b.v)}; }
+    static bool any(SimdFloat mask) { return _mm256_movemask_ps(mask.v) != 0; }
+};
+#elif defined(__SSE2__)
+struct SimdFloat {
+    static constexpr int width = 4;
+    __m128 v;
+
+    static SimdFloat load(const float* p) { return {_mm_load_ps(p)}; }
+    static SimdFloat set(float x) { return {_mm_set1_ps(x)}; }
+    void store(float* p) const { _mm_store_ps(p, v); }
+
+    friend SimdFloat operator+(SimdFloat a, SimdFloat b) { return {_mm_add_ps(a.v, b.v)}; }
+    friend SimdFloat operator-(SimdFloat a, SimdFloat b) { return {_mm_sub_ps(a.v, b.v)}; }
+    friend SimdFloat operator*(SimdFloat a, SimdFloat b) { return {_mm_mul_ps(a.v, b.v)}; }
+    friend SimdFloat operator&(SimdFloat a, SimdFloat b) { return {_mm_and_ps(a.v, b.v)}; }
+    friend SimdFloat operator|(SimdFloat a, SimdFloat b) { return {_mm_or_ps(a.v, b.v)}; }
+
+    static SimdFloat greaterEqual(SimdFloat a, SimdFloat b) { return {_mm_cmpge_ps(a.v, b.v)}; }
+    static SimdFloat lessEqual(SimdFloat a, SimdFloat b) { return {_mm_cmple_ps(a.v, b.v)}; }
+    static SimdFloat less(SimdFloat a, SimdFloat b) { return {_mm_cmplt_ps(a.v, b.v)}; }
+    static SimdFloat equal(SimdFloat a, SimdFloat b) { return {_mm_cmpeq_ps(a.v, b.v)}; }
+    static SimdFloat select(SimdFloat mask, SimdFloat a, SimdFloat b) {
+        return {_mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v))};
+    }
+    static SimdFloat abs(SimdFloat a) { return {_mm_andnot_ps(_mm_set1_ps(-0.0f), a.v)}; }
+    static SimdFloat signOf(SimdFloat a) { return {_mm_and_ps(_mm_set1_ps(-0.0f), a.v)}; }
+    static SimdFloat xorBits(SimdFloat a, SimdFloat b) { return {_mm_xor_ps(a.v, b.v)}; }
+    static bool any(SimdFloat mask) { return _mm_movemask_ps(mask.v) != 0; }
+};
+#else
+struct SimdFloat {
+    static constexpr int width = 1;
+    float v;
+
+    static SimdFloat load(const float* p) { return {*p}; }
+    static SimdFloat set(float x) { return {x}; }
+    void store(float* p) const { *p = v; }
+
+    friend SimdFloat operator+(SimdFloat a, SimdFloat b) { return {a.v + b.v}; }
+    friend SimdFloat operator-(SimdFloat a, SimdFloat b) { return {a.v - b.v}; }
+    friend SimdFloat operator*(SimdFloat a, SimdFloat b) { return {a.v * b.v}; }
+
+    // Masks are 1.0f / 0.0f in the scalar fallback
+    static SimdFloat greaterEqual(SimdFloat a, SimdFloat b) { return {a.v >= b.v ? 1.0f : 0.0f}; }
+    static SimdFloat lessEqual(SimdFloat a, SimdFloat b) { return {a.v <= b.v ? 1.0f : 0.0f}; }
+    static SimdFloat less(SimdFloat a, SimdFloat b) { return {a.v < b.v ? 1.0f : 0.0f}; }
+    static SimdFloat equal(SimdFloat a, SimdFloat b) { return {a.v == b.v ? 1.0f : 0.0f}; }
+    friend SimdFloat operator&(SimdFloat a, SimdFloat b) { return {(a.v != 0.0f && b.v != 0.0f) ? 1.0f : 0.0f}; }
+    static SimdFloat select(SimdFloat mask, SimdFloat a, SimdFloat b) { return mask.v != 0.0f ? a : b; }
+    static SimdFloat abs(SimdFloat a) { return {std::fabs(a.v)}; }
+    static bool any(SimdFloat mask) { return mask.v != 0.0f; }
+};
+#endif
+
+// sin(2*PI*x) for x in [0, 1), accurate to a few 1e-6
+inline SimdFloat simdSinCycles(SimdFloat x) {
+    // Shift to [-0.5, 0.5): sin(2*PI*x) = -sin(2*PI*(x - 0.5))
+    SimdFloat z = x - SimdFloat::set(0.5f);
+    SimdFloat a = SimdFloat::abs(z);
+    // Fold |z| into [0, 0.25] using sin(PI - t) = sin(t)
+    a = SimdFloat::select(SimdFloat::greaterEqual(a, SimdFloat::set(0.25f)), SimdFloat::set(0.5f) - a, a);
+    SimdFloat t = a * SimdFloat::set(2.0f * PI);
+    SimdFloat t2 = t * t;
+    // Taylor series to t^9 over [0, PI/2]
+    SimdFloat poly = SimdFloat::set(1.0f / 362880.0f);
+    poly = poly * t2 - SimdFloat::set(1.0f / 5040.0f);
+    poly = poly * t2 + SimdFloat::set(1.0f / 120.0f);
+    poly = poly * t2 - SimdFloat::set(1.0f / 6.0f);
+    poly = poly * t2 + SimdFloat::set(1.0f);
+    SimdFloat s = poly * t;
+#if defined(__AVX__) || defined(__SSE2__)
+    // Result sign is the opposite of z's sign
+    return SimdFloat::xorBits(s, SimdFloat::xorBits(SimdFloat::signOf(z), SimdFloat::set(-0.0f)));
+#else
+    return {z.v < 0.0f ? s.v : -s.v};
+#endif
+}
+
+// Keeps a phase in [0, 1) after adding an increment in (-1, 1)
+inline SimdFloat simdWrapCycles(SimdFloat phase) {
+    SimdFloat one = SimdFloat::set(1.0f);
+    phase = phase - (SimdFloat::greaterEqual(phase, one) & one);
+    phase = phase + (SimdFloat::less(phase, SimdFloat::set(0.0f)) & one);
+    return phase;
+}
+
+// Describes a preset the SIMD bank can render
+struct SimdVoiceSpec {
+    bool frequencyModulation = false;
+    float modulatorRatio = 1.0f;
+    float modulationIndex = 0.0f;
+    float selfModulationIndex = 0.0f;
+    float attack = 0.1f;
+    float decay = 0.1f;
+    float sustain = 0.7f;
+    float release = 0.3f;
+};
+
+class SimdVoiceBank {
+public:
+    static constexpr int VOICE_COUNT = 128;
+    static_assert(VOICE_COUNT % SimdFloat::width == 0, "voice count must fill whole SIMD groups");
+
+    explicit SimdVoiceBank(const SimdVoiceSpec& spec)
+        : frequencyModulation(spec.frequencyModulation), modulatorRatio(spec.modulatorRatio),
+          modulationIndex(spec.modulationIndex), selfModulationIndex(spec.selfModulationIndex),
+          attackTime(spec.attack), decayTime(spec.decay), sustainLevel(spec.sustain), releaseTime(spec.release) {
+        static std::random_device rd;
+        static std::mt19937 gen(rd());
+        std::uniform_real_distribution<float> phase(0.0f, 1.0f);
+        for (int v = 0; v < VOICE_COUNT; ++v) {
+            carrierPhase[v] = phase(gen);
+            modulatorPhase[v] = phase(gen);
+        }
+        carrierFrequency.fill(0.0f);
+        level.fill(0.0f);
+        slope.fill(0.0f);
+        stage.fill(STAGE_IDLE);
+        velocity.fill(0.0f);
+        setSampleRate(sampleRate);
+    }
+
+    void setFrequency(int voice, float frequency) {
+        carrierFrequency[voice] = frequency;
+        updateIncrements(voice);
+    }
+
+    void setModulatorRatio(float ratio) {
+        modulatorRatio = ratio;
+        for (int v = 0; v < VOICE_COUNT; ++v) updateIncrements(v);
+    }
+    void setModulationIndex(float index) { modulationIndex = index; }
+    void setSelfModulationIndex(float index) { selfModulationIndex = index; }
+    void setAttack(float seconds) { attackTime = seconds; }
+    void setDecay(float seconds) { decayTime = seconds; }
+    void setSustain(float value) { sustainLevel = value; }
+    void setRelease(float seconds) { releaseTime = seconds; }
+    bool usesFrequencyModulation() const { return frequencyModulation; }
+
+    void noteOn(int voice, float velocityValue) {
+        velocity[voice] = std::clamp(velocityValue, 0.0f, 1.0f);
+        stage[voice] = STAGE_ATTACK;
+        // Ramp from the current level, like ADSRGenerator
+        slope[voice] = (1.0f - level[voice]) / std::max(attackTime * sampleRate, 1.0f);
+    }
+
+    void noteOff(int voice) {
+        if (stage[voice] == STAGE_IDLE) {
+            return;
+        }
+        float start = (stage[voice] == STAGE_SUSTAIN) ? sustainLevel : level[voice];
+        level[voice] = start;
+        stage[voice] = STAGE_RELEASE;
+        slope[voice] = -start / std::max(releaseTime * sampleRate, 1.0f);
+    }
+
+    // Ramps a voice to silence over `seconds`; used when ActiveTones steals it
+    void fadeOut(int voice, float seconds) {
+        if (stage[voice] == STAGE_IDLE) {
+            return;
+        }
+        stage[voice] = STAGE_RELEASE;
+        slope[voice] = -level[voice] / std::max(seconds * sampleRate, 1.0f);
+    }
+
+    bool isActive(int voice) const { return stage[voice] != STAGE_IDLE; }
+    float getLevel(int voice) const { return level[voice] * velocity[voice]; }
+
+    // Adds every sounding voice into out
+    void render(float* out, size_t frames, float newSampleRate) {
+        if (newSampleRate != sampleRate) {
+            setSampleRate(newSampleRate);
+        }
+
+        for (size_t i = 0; i < frames; ++i) {
+            laneMix[i] = SimdFloat::set(0.0f);
+        }
+
+        for (int group = 0; group < VOICE_COUNT; group += SimdFloat::width) {
+            if (!SimdFloat::any(SimdFloat::less(SimdFloat::set(STAGE_IDLE), SimdFloat::load(&stage[group])))) {
+                continue; // whole group idle
+            }
+            if (frequencyModulation) {
+                renderGroup<true>(group, frames);
+            } else {
+                renderGroup<false>(group, frames);
+            }
+        }
+
+        // One horizontal reduction per output sample
+        alignas(32) float lanes[SimdFloat::width];
+        for (size_t i = 0; i < frames; ++i) {
+            laneMix[i].store(lanes);
+            float sum = 0.0f;
+            for (int lane = 0; lane < SimdFloat::width; ++lane) {
+                sum += lanes[lane];
+            }
+            out[i] += sum;
+        }
+    }
+
+private:
+    // Stages are stored as floats so they can be compared and blended in SIMD lanes
+    static constexpr float STAGE_IDLE = 0.0f;
+    static constexpr float STAGE_ATTACK = 1.0f;
+    static constexpr float STAGE_DECAY = 2.0f;
+    static constexpr float STAGE_SUSTAIN = 3.0f;
+    static constexpr float STAGE_RELEASE = 4.0f;
+
+    bool frequencyModulation;
+    float modulatorRatio;
+    float modulationIndex;
+    float selfModulationIndex;
+    float attackTime;
+    float decayTime;
+    float sustainLevel;
+    float releaseTime;
+    float sampleRate = 44100.0f;
+
+    // Per-voice state, one lane per MIDI note. Phases and increments are in cycles.
+    alignas(32) std::array<float, VOICE_COUNT> carrierFrequency;
+    alignas(32) std::array<float, VOICE_COUNT> carrierPhase;
+    alignas(32) std::array<float, VOICE_COUNT> carrierIncrement;
+    alignas(32) std::array<float, VOICE_COUNT> carrierCurrentIncrement;
+    alignas(32) std::array<float, VOICE_COUNT> modulatorPhase;
+    alignas(32) std::array<float, VOICE_COUNT> modulatorIncrement;
+    alignas(32) std::array<float, VOICE_COUNT> modulatorCurrentIncrement;
+    alignas(32) std::array<float, VOICE_COUNT> level;
+    alignas(32) std::array<float, VOICE_COUNT> slope;
+    alignas(32) std::array<float, VOICE_COUNT> stage;
+    alignas(32) std::array<float, VOICE_COUNT> velocity;
+
+    std::array<SimdFloat, MAX_BLOCK_FRAMES> laneMix;
+
+    void setSampleRate(float newSampleRate) {
+        sampleRate = newSampleRate;
+        for (int v = 0; v < VOICE_COUNT; ++v) updateIncrements(v);
+    }
+
+    void updateIncrements(int voice) {
+        carrierIncrement[voice] = carrierFrequency[voice] / sampleRate;
+        modulatorIncrement[voice] = carrierIncrement[voice] * modulatorRatio;
+        carrierCurrentIncrement[voice] = carrierIncrement[voice];
+        modulatorCurrentIncrement[voice] = modulatorIncrement[voice];
+    }
+
+    template <bool FM>
+    void renderGroup(int group, size_t frames) {
+        SimdFloat cPhase = SimdFloat::load(&carrierPhase[group]);
+        SimdFloat cBase = SimdFloat::load(&carrierIncrement[group]);
+        SimdFloat cInc = SimdFloat::load(&carrierCurrentIncrement[group]);
+        SimdFloat mPhase = SimdFloat::load(&modulatorPhase[group]);
+        SimdFloat mBase = SimdFloat::load(&modulatorIncrement[group]);
+        SimdFloat mInc = SimdFloat::load(&modulatorCurrentIncrement[group]);
+        SimdFloat lvl = SimdFloat::load(&level[group]);
+        SimdFloat slp = SimdFloat::load(&slope[group]);
+        SimdFloat stg = SimdFloat::load(&stage[group]);
+        SimdFloat vel = SimdFloat::load(&velocity[group]);
+
+        const SimdFloat one = SimdFloat::set(1.0f);
+        const SimdFloat zero = SimdFloat::set(0.0f);
+        const SimdFloat sustain = SimdFloat::set(std::clamp(sustainLevel, 0.0f, 1.0f));
+        const SimdFloat decaySlope = SimdFloat::set(-(1.0f - sustainLevel) / std::max(decayTime * sampleRate, 1.0f));
+        const SimdFloat index = SimdFloat::set(modulationIndex);
+        const SimdFloat selfIndex = SimdFloat::set(selfModulationIndex);
+        const SimdFloat attackStage = SimdFloat::set(STAGE_ATTACK);
+        const SimdFloat decayStage = SimdFloat::set(STAGE_DECAY);
+        const SimdFloat sustainStage = SimdFloat::set(STAGE_SUSTAIN);
+        const SimdFloat releaseStage = SimdFloat::set(STAGE_RELEASE);
+
+        for (size_t i = 0; i < frames; ++i) {
+            if constexpr (FM) {
+                // Same update order as FMVoice: the modulator retunes both oscillators
+                SimdFloat modulator = simdSinCycles(mPhase);
+                mPhase = simdWrapCycles(mPhase + mInc);
+                mInc = mBase * (one + selfIndex * modulator);
+                cInc = cBase * (one + index * modulator);
+            }
+            SimdFloat carrier = simdSinCycles(cPhase);
+            cPhase = simdWrapCycles(cPhase + cInc);
+
+            // Branch-free linear ADSR: advance, then resolve stage transitions with masks
+            lvl = lvl + slp;
+            SimdFloat attackDone = SimdFloat::equal(stg, attackStage) & SimdFloat::greaterEqual(lvl, one);
+            lvl = SimdFloat::select(attackDone, one, lvl);
+            stg = SimdFloat::select(attackDone, decayStage, stg);
+            slp = SimdFloat::select(attackDone, decaySlope, slp);
+
+            SimdFloat decayDone = SimdFloat::equal(stg, decayStage) & SimdFloat::lessEqual(lvl, sustain);
+            stg = SimdFloat::select(decayDone, sustainStage, stg);
+            slp = SimdFloat::select(decayDone, zero, slp);
+            lvl = SimdFloat::select(SimdFloat::equal(stg, sustainStage), sustain, lvl);
+
+            SimdFloat releaseDone = SimdFloat::equal(stg, releaseStage) & SimdFloat::lessEqual(lvl, zero);
+            lvl = SimdFloat::select(releaseDone, zero, lvl);
+            stg = SimdFloat::select(releaseDone, zero, stg);
+            slp = SimdFloat::select(releaseDone, zero, slp);
+
+            laneMix[i] = laneMix[i] + carrier * lvl * vel;
+        }
+
+        cPhase.store(&carrierPhase[group]);
+        cInc.store(&carrierCurrentIncrement[group]);
+        mPhase.store(&modulatorPhase[group]);
+        mInc.store(&modulatorCurrentIncrement[group]);
+        lvl.store(&level[group]);
+        slp.store(&slope[group]);
+        stg.store(&stage[group]);
+    }
+};
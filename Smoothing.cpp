@@ -0,0 +1,123 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <algorithm>
+
+// Parameter smoothing. A node keeps a SmoothedValue per parameter that must
+// not jump (gains, cutoffs, ...); the parameter callback sets its target and
+// the node asks for a BlockRamp at the start of each process() call. All
+// curves reduce to value = value * mul + add per sample, so the inner loop is
+// branch-free and identical for every curve:
+//
+//     BlockRamp gain = volume.nextBlock(frames, sampleRate);
+//     for (size_t i = 0; i < frames; ++i) out[i] *= gain.next();
+//
+// Linear       constant step, reaches the target after the ramp time
+// Exponential  constant ratio (equal steps in dB / octaves); values must be > 0
+// OnePole      first-order lowpass with the ramp time as its time constant
+//
+// Until the first nextBlock() a new target is taken at once: values set
+// while a graph is constructed or a voice set is built (preset defaults,
+// carried-over user values) must not glide in from the constructor's value
+// on the first note. Only live edits to a rendering node ramp.
+enum class RampCurve { Linear, Exponential, OnePole };
+
+struct BlockRamp {
+    float value;
+    float mul;
+    float add;
+
+    float next() {
+        value = value * mul + add;
+        return value;
+    }
+};
+
+class SmoothedValue {
+public:
+    explicit SmoothedValue(float initial = 0.0f, RampCurve curve = RampCurve::Linear, float rampSeconds = 0.02f)
+        : current(initial), target(initial), curve(curve), rampSeconds(rampSeconds) {}
+
+    void setTarget(float value) {
+        if (!rendered) {
+            snap(value);
+            return;
+        }
+        if (value == target) {
+            return;
+        }
+        target = value;
+        rampStart = current;
+        rampElapsed = 0.0f;
+    }
+
+    // Jumps to value without a ramp, e.g. when a voice is (re)built
+    void snap(float value) {
+        current = target = rampStart = value;
+    }
+
+    void setCurve(RampCurve newCurve) { curve = newCurve; }
+    void setRampTime(float seconds) { rampSeconds = std::max(seconds, 0.0f); }
+
+    float getTarget() const { return target; }
+    float getCurrent() const { return current; }
+    bool isSmoothing() const { return current != target; }
+
+    // Precomputes the ramp over the next `frames` samples and advances the
+    // stored value to where the ramp ends
+    BlockRamp nextBlock(size_t frames, float sampleRate) {
+        rendered = true;
+        if (current == target || frames == 0) {
+            return {current, 1.0f, 0.0f};
+        }
+
+        const float rampSamples = rampSeconds * sampleRate;
+        const float n = static_cast<float>(frames);
+        BlockRamp ramp{current, 1.0f, 0.0f};
+
+        if (curve == RampCurve::OnePole) {
+            if (rampSamples < 1.0f) {
+                ramp = {target, 1.0f, 0.0f};
+                current = target;
+                return ramp;
+            }
+            const float a = std::exp(-1.0f / rampSamples);
+            ramp.mul = a;
+            ramp.add = target * (1.0f - a);
+            current = target + (current - target) * std::pow(a, n);
+            if (std::fabs(current - target) <= SETTLE_THRESHOLD * std::max(std::fabs(target), 1.0f)) {
+                current = target;
+            }
+            return ramp;
+        }
+
+        // Linear and exponential ramps end exactly on the target. The block
+        // that reaches it spreads the last part of the ramp over the whole
+        // block, so there is no per-sample end check.
+        rampElapsed += n;
+        const float progress = (rampSamples <= rampElapsed) ? 1.0f : rampElapsed / rampSamples;
+        const bool exponential = curve == RampCurve::Exponential && rampStart > 0.0f && target > 0.0f;
+        float end;
+        if (exponential) {
+            end = rampStart * std::pow(target / rampStart, progress);
+            ramp.mul = std::pow(end / current, 1.0f / n);
+        } else {
+            end = rampStart + (target - rampStart) * progress;
+            ramp.add = (end - current) / n;
+        }
+        current = (progress >= 1.0f) ? target : end;
+        return ramp;
+    }
+
+private:
+    static constexpr float SETTLE_THRESHOLD = 1e-5f;
+
+    float current;
+    float target;
+    float rampStart = 0.0f;
+    float rampElapsed = 0.0f;
+    RampCurve curve;
+    float rampSeconds;
+    bool rendered = false; // nextBlock() has run; targets ramp from now on
+};
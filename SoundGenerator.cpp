@@ -6,11 +6,39 @@
 #include <algorithm>
 #include "Parameter.cpp"
 #include "math.cpp"
+#include "VoiceArena.cpp"
+#include "NodeProfiler.cpp"
+
+// Largest number of frames a node is asked to render in one process() call.
+// Callers with longer periods (e.g. AudioEngine) split them into blocks of at
+// most this size, so nodes can keep fixed-size scratch buffers.
+constexpr size_t MAX_BLOCK_FRAMES = 512;
 
 class SoundGenerator {
+    friend class VoiceCompiler;
 public:
     virtual ~SoundGenerator() = default;
-    virtual float generateSample(float sampleRate) = 0;
+
+    // Block rendering: writes `frames` samples (frames <= MAX_BLOCK_FRAMES) to out.
+    virtual void process(float* out, size_t frames, float sampleRate) = 0;
+
+    // What parents call to render a child: process(), timed by the
+    // NodeProfiler while profiling is enabled
+    void render(float* out, size_t frames, float sampleRate) {
+        if (!nodeProfilingEnabled()) {
+            process(out, frames, sampleRate);
+            return;
+        }
+        NodeProfiler::Timer timer(profileSlot(), frames);
+        process(out, frames, sampleRate);
+    }
+
+    // Per-sample compatibility shim; prefer process() on hot paths.
+    virtual float generateSample(float sampleRate) {
+        float sample = 0.0f;
+        process(&sample, 1, sampleRate);
+        return sample;
+    }
 
     // Add these new virtual methods
     virtual void noteOn(float velocity) {
@@ -24,8 +52,56 @@ public:
         }
     }
 
+    // Voice lifetime, used by ActiveTones to keep only sounding voices in its
+    // render list. A node is active while any child is; leaves without an
+    // envelope never finish on their own.
+    virtual bool isActive() const {
+        if (childGenerators.empty()) {
+            return true;
+        }
+        for (const auto& child : childGenerators) {
+            if (child->isActive()) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Multiplies every pitch in the voice by ratio so ActiveTones can reuse a
+    // pooled voice for another note. Effect and LFO rates stay as they are.
+    virtual void retune(float ratio) {
+        for (auto& child : childGenerators) {
+            child->retune(ratio);
+        }
+    }
+
+    // Envelope gain in [0, 1], used to pick the quietest voice to steal
+    virtual float getLevel() const {
+        if (childGenerators.empty()) {
+            return 1.0f;
+        }
+        float level = 0.0f;
+        for (const auto& child : childGenerators) {
+            level = std::max(level, child->getLevel());
+        }
+        return level;
+    }
+
+    // Cuts the voice off at once (after a voice-steal fade) so isActive() turns false
+    virtual void stop() {
+        for (auto& child : childGenerators) {
+            child->stop();
+        }
+    }
+
+    // Flattened parameters of this node and its children. Cached; rebuilt
+    // only after a structural change somewhere in the tree.
     const std::vector<Parameter*>& getParameters() {
-        rebuildParameterPointers();
+        const uint64_t structure = parameterStructureVersion().load(std::memory_order_acquire);
+        if (parameterPointersVersion != structure) {
+            rebuildParameterPointers();
+            parameterPointersVersion = structure;
+        }
         return parameterPointers;
     }
 
@@ -35,12 +111,29 @@ public:
         }
     }
 
+    // This node's NodeProfiler slot, looked up on its first profiled call.
+    // NO_SLOT (table full) is cached too, so the table is probed once per node.
+    int profileSlot() {
+        if (cachedProfileSlot == NodeProfiler::UNRESOLVED_SLOT) {
+            cachedProfileSlot = NodeProfiler::instance().findSlot(
+                typeid(*this), parameters.empty() ? "" : parameters.front()->getName().c_str());
+        }
+        return cachedProfileSlot;
+    }
+
 protected:
     std::shared_ptr<Parameter> addParam(std::unique_ptr<Parameter> param) {
         parameters.push_back(std::move(param));
+        markParameterStructureChanged();
         return parameters.back();
     }
 
+    void clearParameters() {
+        parameters.clear();
+        childGenerators.clear();
+        markParameterStructureChanged();
+    }
+
     void rebuildParameterPointers() {
         parameterPointers.clear();
         for (auto& param : parameters) {
@@ -55,9 +148,14 @@ protected:
 
     void addChildGenerator(std::shared_ptr<SoundGenerator> child) {
         childGenerators.push_back(std::move(child));
+        markParameterStructureChanged();
     }
 
     std::vector<std::shared_ptr<Parameter>> parameters;
     std::vector<Parameter*> parameterPointers;
+    uint64_t parameterPointersVersion = UINT64_MAX;
     std::vector<std::shared_ptr<SoundGenerator>> childGenerators;
+
+private:
+    int cachedProfileSlot = NodeProfiler::UNRESOLVED_SLOT;
 };
@@ -1,15 +1,223 @@
+#ifdef _WIN32
+#ifndef _WIN32_WINNT
+#define _WIN32_WINNT 0x0600 // WSAPoll
+#endif
+#endif
 #include "StaticServer.h"
 #include "SSEServer.h"
 #include "HTTPAPIHandler.h"
+#include "WebSocketServer.h"
+#include "WorkerPool.cpp"
+#include "AssetCache.cpp"
 #include <iostream>
-#include <fstream>
-#include <sstream>
-#include <filesystem>
 #include <algorithm>
 #include <unordered_map>
+#include <chrono>
+#include <cctype>
+#include <charconv>
+#include <deque>
+#ifndef _WIN32
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <fcntl.h>
+#include <cerrno>
+#endif
+
+namespace {
+
+constexpr uint64_t LISTEN_ID = 0;
+constexpr uint64_t WAKE_ID = 1;
+constexpr int SWEEP_INTERVAL_MS = 1000;
+
+#ifdef MSG_NOSIGNAL
+const int SEND_FLAGS = MSG_NOSIGNAL; // a closed peer must not raise SIGPIPE
+#else
+const int SEND_FLAGS = 0;
+#endif
+
+void setNonBlocking(socket_t socket) {
+#ifdef _WIN32
+    u_long enabled = 1;
+    ioctlsocket(socket, FIONBIO, &enabled);
+#else
+    fcntl(socket, F_SETFL, fcntl(socket, F_GETFL, 0) | O_NONBLOCK);
+#endif
+}
+
+// After a failed send/recv/accept on a non-blocking socket: just nothing to do right now?
+bool wouldBlock() {
+#ifdef _WIN32
+    int error = WSAGetLastError();
+    return error == WSAEWOULDBLOCK || error == WSAEINTR;
+#else
+    return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+#endif
+}
+
+} // namespace
+
+#ifdef MSOUND_EMBED_GUI
+// gui.html compiled into the binary (g++ -DMSOUND_EMBED_GUI ..., run where
+// gui.html is), so msound serves the GUI without the file next to it
+#ifdef _WIN32
+#define MSOUND_RODATA_SECTION ".section .rdata,\"dr\"\n"
+#else
+#define MSOUND_RODATA_SECTION ".section .rodata\n"
+#endif
+__asm__(MSOUND_RODATA_SECTION
+        "msound_gui_html_start:\n"
+        ".incbin \"gui.html\"\n"
+        "msound_gui_html_end:\n"
+        ".text\n");
+extern const char guiHtmlStart[] __asm__("msound_gui_html_start");
+extern const char guiHtmlEnd[] __asm__("msound_gui_html_end");
+#endif
+
+struct HTTPConnectionState {
+    enum class Phase { Reading, Processing, Streaming };
+
+    StaticServer* server;
+    uint64_t id;
+    socket_t socket;
+
+    // One piece of queued output: bytes of its own, or a shared buffer (a
+    // cached file) that is sent from where it is
+    struct OutputChunk {
+        std::string owned;
+        std::shared_ptr<const std::string> shared;
+
+        const std::string& bytes() const { return shared ? *shared : owned; }
+    };
+
+    // Guarded by mutex; written by any thread, drained by the event loop
+    std::mutex mutex;
+    std::deque<OutputChunk> output;
+    size_t outputOffset = 0; // into output.front()
+    size_t queuedBytes = 0;
+    bool closing = false; // close once output is written
+    bool aborted = false; // close now (client fell too far behind)
+    bool closed = false;
+    HTTPConnection::DataHandler dataHandler;
+    HTTPConnection::CloseHandler closeHandler;
+
+    // Event loop thread only, or the worker running its task
+    Phase phase = Phase::Reading;
+    bool taskRunning = false;
+    bool writeInterest = false;
+    bool keepAlive = false; // of the request being handled
+    bool peerClosed = false; // the client sent EOF; answer what it sent, then close
+    std::string input;
+    std::string requestBuffer; // the request's bytes while a worker handles it; input keeps filling meanwhile
+    HTTPRequestParser parser{StaticServer::MAX_REQUEST_BYTES};
+    std::chrono::steady_clock::time_point lastRead;
+    std::chrono::steady_clock::time_point lastWrite;
+};
+
+HTTPConnection::HTTPConnection(std::shared_ptr<HTTPConnectionState> statePtr) : state(std::move(statePtr)) {
+}
+
+uint64_t HTTPConnection::id() const {
+    return state ? state->id : 0;
+}
+
+bool HTTPConnection::send(std::string data) const {
+    return queue(std::move(data), nullptr);
+}
+
+bool HTTPConnection::send(std::shared_ptr<const std::string> data) const {
+    return queue({}, std::move(data));
+}
+
+bool HTTPConnection::queue(std::string owned, std::shared_ptr<const std::string> shared) const {
+    if (!state) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(state->mutex);
+    if (state->closed || state->closing || state->aborted) {
+        return false;
+    }
+    const size_t size = shared ? shared->size() : owned.size();
+    if (size == 0) {
+        return true;
+    }
+    auto& output = state->output;
+    const bool wasEmpty = output.empty();
+    if (state->queuedBytes > StaticServer::MAX_QUEUED_BYTES) {
+        state->aborted = true;
+    } else if (shared) {
+        output.push_back({{}, std::move(shared)});
+    } else if (!wasEmpty && !output.back().shared) {
+        output.back().owned += owned; // coalesce small writes
+    } else {
+        output.push_back({std::move(owned), nullptr});
+    }
+    if (!state->aborted) {
+        state->queuedBytes += size;
+    }
+    // The loop is already writing whatever was queued before; otherwise tell it.
+    // Still under the lock, so stop() cannot close the loop in between.
+    if (wasEmpty || state->aborted) {
+        state->server->queueWrite(state);
+    }
+    return !state->aborted;
+}
+
+bool HTTPConnection::keepAlive() const {
+    return state && state->keepAlive;
+}
+
+size_t HTTPConnection::queuedBytes() const {
+    if (!state) {
+        return 0;
+    }
+    std::lock_guard<std::mutex> lock(state->mutex);
+    return state->queuedBytes;
+}
+
+void HTTPConnection::close() const {
+    if (!state) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(state->mutex);
+    if (state->closed || state->closing) {
+        return;
+    }
+    state->closing = true;
+    state->server->queueWrite(state);
+}
+
+void HTTPConnection::setDataHandler(DataHandler handler) const {
+    std::lock_guard<std::mutex> lock(state->mutex);
+    state->dataHandler = std::move(handler);
+}
+
+void HTTPConnection::setCloseHandler(CloseHandler handler) const {
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        if (!state->closed) {
+            state->closeHandler = std::move(handler);
+            return;
+        }
+    }
+    handler(); // already gone
+}
 
 StaticServer::StaticServer(const std::string& rootDir, uint16_t port)
-    : rootDirectory(rootDir), serverPort(port), running(false), listenSocket(INVALID_SOCKET) {
+    : rootDirectory(rootDir), serverPort(port), running(false), listenSocket(INVALID_SOCKET),
+      nextConnectionId(WAKE_ID + 1), acceptPaused(false), acceptFailing(false),
+#ifdef _WIN32
+      wakeSocket(INVALID_SOCKET),
+#else
+      pollFd(-1), wakeFd(-1),
+#endif
+      wakePending(false) {
+    assets = std::make_unique<AssetCache>(rootDirectory, [this](const std::string& extension) {
+        return getMimeType(extension);
+    });
+#ifdef MSOUND_EMBED_GUI
+    assets->addEmbedded("/gui.html", std::string_view(guiHtmlStart, guiHtmlEnd - guiHtmlStart));
+#endif
 }
 
 StaticServer::~StaticServer() {
@@ -61,7 +269,7 @@ bool StaticServer::start() {
         return false;
     }
 
-    if (listen(listenSocket, SOMAXCONN) == SOCKET_ERROR) {
+    if (listen(listenSocket, SOMAXCONN) == SOCKET_ERROR || !openPoller()) {
         std::cerr << "StaticServer: Failed to listen on socket" << std::endl;
         closesocket(listenSocket);
         listenSocket = INVALID_SOCKET;
@@ -70,11 +278,19 @@ bool StaticServer::start() {
 #endif
         return false;
     }
+    setNonBlocking(listenSocket);
+    watchSocket(listenSocket, LISTEN_ID);
+    acceptPaused = false;
+    acceptFailing = false;
+
+    // Handlers mostly wait on locks or format JSON; a few threads are plenty
+    const size_t workerCount = std::clamp(std::thread::hardware_concurrency() / 2, 2u, 4u);
+    workers = std::make_unique<WorkerPool>(workerCount);
 
     running = true;
     serverThread = std::thread(&StaticServer::serverLoop, this);
     
-    std::cout << "StaticServer: Started on port " << serverPort << std::endl;
+    std::cout << "StaticServer: Started on port " << serverPort << " with " << workerCount << " workers" << std::endl;
     return true;
 }
 
@@ -84,15 +300,24 @@ void StaticServer::stop() {
     }
 
     running = false;
-
-    if (listenSocket != INVALID_SOCKET) {
-        closesocket(listenSocket);
-        listenSocket = INVALID_SOCKET;
-    }
-
+    wakeLoop();
     if (serverThread.joinable()) {
         serverThread.join();
     }
+    workers->stop();
+
+    while (!connections.empty()) {
+        closeConnection(connections.begin()->second);
+    }
+    {
+        std::lock_guard<std::mutex> lock(loopMutex);
+        pendingWrites.clear();
+        finishedTasks.clear();
+    }
+
+    closesocket(listenSocket);
+    listenSocket = INVALID_SOCKET;
+    closePoller();
 
 #ifdef _WIN32
     WSACleanup();
@@ -109,99 +334,544 @@ void StaticServer::setHTTPAPIHandler(std::shared_ptr<HTTPAPIHandler> apiHandler)
     httpAPIHandler = apiHandler;
 }
 
+void StaticServer::setWebSocketServer(std::shared_ptr<WebSocketServer> webSocketServerPtr) {
+    webSocketServer = webSocketServerPtr;
+}
+
 void StaticServer::serverLoop() {
+    std::vector<PollEvent> events;
+    auto nextSweep = std::chrono::steady_clock::now() + std::chrono::milliseconds(SWEEP_INTERVAL_MS);
     while (running) {
+        pollEvents(acceptPaused ? ACCEPT_RETRY_MS : SWEEP_INTERVAL_MS, events);
+        for (const PollEvent& event : events) {
+            if (event.id == LISTEN_ID) {
+                acceptConnections();
+            } else if (event.id == WAKE_ID) {
+                drainWakeups();
+            } else {
+                auto it = connections.find(event.id);
+                if (it == connections.end()) {
+                    continue; // closed earlier in this batch
+                }
+                std::shared_ptr<HTTPConnectionState> connection = it->second;
+                if (event.writable) {
+                    flushConnection(connection);
+                }
+                if (event.readable && connections.count(event.id)) {
+                    readConnection(connection);
+                }
+            }
+        }
+
+        // Whatever workers and other threads handed over meanwhile
+        std::vector<std::shared_ptr<HTTPConnectionState>> writes;
+        std::vector<std::pair<std::shared_ptr<HTTPConnectionState>, bool>> finished;
+        {
+            std::lock_guard<std::mutex> lock(loopMutex);
+            writes.swap(pendingWrites);
+            finished.swap(finishedTasks);
+            wakePending = false;
+        }
+        for (const auto& [connection, result] : finished) {
+            finishTask(connection, result);
+        }
+        for (const auto& connection : writes) {
+            if (connections.count(connection->id)) {
+                flushConnection(connection);
+            }
+        }
+
+        const auto now = std::chrono::steady_clock::now();
+        if (acceptPaused && now >= acceptResume) {
+            acceptPaused = false;
+            watchSocket(listenSocket, LISTEN_ID);
+        }
+        if (now >= nextSweep) {
+            closeIdleConnections();
+            nextSweep = now + std::chrono::milliseconds(SWEEP_INTERVAL_MS);
+        }
+    }
+}
+
+void StaticServer::acceptConnections() {
+    while (true) {
         sockaddr_in clientAddr = {};
         socklen_t clientAddrLen = sizeof(clientAddr);
-        
         socket_t clientSocket = accept(listenSocket, (sockaddr*)&clientAddr, &clientAddrLen);
         if (clientSocket == INVALID_SOCKET) {
-            if (running) {
-                std::cerr << "StaticServer: Accept failed" << std::endl;
+            if (!wouldBlock()) {
+                // The pending connection stays queued and the socket stays
+                // readable, so stop watching it for a while instead of spinning
+                if (!acceptFailing) {
+                    std::cerr << "StaticServer: Accept failed, pausing new connections" << std::endl;
+                    acceptFailing = true;
+                }
+                acceptPaused = true;
+                acceptResume = std::chrono::steady_clock::now() + std::chrono::milliseconds(ACCEPT_RETRY_MS);
+                unwatchSocket(listenSocket);
             }
+            return;
+        }
+        acceptFailing = false;
+        setNonBlocking(clientSocket);
+        // Responses and stream messages are small; do not let Nagle hold them back
+        int noDelay = 1;
+        setsockopt(clientSocket, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&noDelay), sizeof(noDelay));
+
+        auto connection = std::make_shared<HTTPConnectionState>();
+        connection->server = this;
+        connection->id = nextConnectionId++;
+        connection->socket = clientSocket;
+        connection->lastRead = std::chrono::steady_clock::now();
+        connections[connection->id] = connection;
+        watchSocket(clientSocket, connection->id);
+    }
+}
+
+void StaticServer::readConnection(const std::shared_ptr<HTTPConnectionState>& connection) {
+    if (connection->peerClosed) {
+        closeConnection(connection); // no read interest left: this is a hangup or error
+        return;
+    }
+    char buffer[16384];
+    while (true) {
+        int received = recv(connection->socket, buffer, sizeof(buffer), 0);
+        if (received > 0) {
+            connection->input.append(buffer, received);
+            connection->lastRead = std::chrono::steady_clock::now();
+            continue;
+        }
+        if (received < 0 && wouldBlock()) {
             break;
         }
+        if (received < 0) {
+            closeConnection(connection); // reset
+            return;
+        }
+        // EOF: the client may have half-closed after its last request, so
+        // stop reading but still answer whatever it sent
+        connection->peerClosed = true;
+        updateInterest(*connection);
+        break;
+    }
+
+    if (connection->input.size() > 2 * MAX_REQUEST_BYTES) {
+        closeConnection(connection); // pipelining faster than its requests are handled
+        return;
+    }
+    dispatch(connection);
+    closeIfPeerDone(connection);
+}
 
-        // Handle client in current thread for simplicity
-        // For production, consider using a thread pool
-        bool shouldCloseSocket = true;
-        handleClient(clientSocket, shouldCloseSocket);
-        if (shouldCloseSocket) {
-            closesocket(clientSocket);
+// Once a half-closed client's last request is answered, close after the output drains
+void StaticServer::closeIfPeerDone(const std::shared_ptr<HTTPConnectionState>& connection) {
+    if (connection->peerClosed && !connection->taskRunning && connections.count(connection->id)) {
+        HTTPConnection(connection).close();
+    }
+}
+
+void StaticServer::flushConnection(const std::shared_ptr<HTTPConnectionState>& connection) {
+    const auto now = std::chrono::steady_clock::now();
+    if (!connection->writeInterest) {
+        connection->lastWrite = now; // the write timeout starts with the first blocked write
+    }
+
+    bool done;
+    bool drained;
+    {
+        std::lock_guard<std::mutex> lock(connection->mutex);
+        bool failed = false;
+        auto& output = connection->output;
+        while (!connection->aborted && !output.empty()) {
+            const std::string& bytes = output.front().bytes();
+            int sent = ::send(connection->socket, bytes.data() + connection->outputOffset,
+                              static_cast<int>(bytes.size() - connection->outputOffset), SEND_FLAGS);
+            if (sent > 0) {
+                connection->outputOffset += sent;
+                connection->queuedBytes -= sent;
+                connection->lastWrite = now;
+                if (connection->outputOffset == bytes.size()) {
+                    output.pop_front();
+                    connection->outputOffset = 0;
+                }
+            } else {
+                failed = !wouldBlock();
+                break;
+            }
         }
+        drained = output.empty();
+        done = failed || connection->aborted || (connection->closing && drained);
+    }
+
+    if (done) {
+        closeConnection(connection);
+    } else if (drained == connection->writeInterest) {
+        // Only ask for writability while something is waiting to be written
+        connection->writeInterest = !drained;
+        updateInterest(*connection);
     }
 }
 
-void StaticServer::handleClient(socket_t clientSocket, bool& shouldCloseSocket) {
-    char buffer[4096] = {};
-    int bytesReceived = recv(clientSocket, buffer, sizeof(buffer) - 1, 0);
-    
-    if (bytesReceived <= 0) {
+// Hands the next complete request, or a stream's new data, to a worker
+void StaticServer::dispatch(const std::shared_ptr<HTTPConnectionState>& connection) {
+    if (connection->taskRunning) {
+        return; // one task per connection at a time, so its data stays in order
+    }
+
+    if (connection->phase == HTTPConnectionState::Phase::Reading) {
+        const HTTPRequestParser::Status status = connection->parser.parse(connection->input);
+        if (status == HTTPRequestParser::Status::Incomplete) {
+            return;
+        }
+        if (status == HTTPRequestParser::Status::Error) {
+            const int errorStatus = connection->parser.errorStatus();
+            connection->keepAlive = false;
+            sendResponse(HTTPConnection(connection), errorStatus, "text/plain", httpStatusText(errorStatus));
+            HTTPConnection(connection).close();
+            connection->input.clear();
+            return;
+        }
+        // The worker reads the request in place; reads meanwhile go to a fresh input buffer
+        connection->requestBuffer.swap(connection->input);
+        connection->keepAlive = connection->parser.keepsAlive();
+        connection->phase = HTTPConnectionState::Phase::Processing;
+        connection->taskRunning = true;
+        workers->post([this, connection]() {
+            HTTPRequest request;
+            connection->parser.request(connection->requestBuffer, request);
+            postFinishedTask(connection, handleRequest(HTTPConnection(connection), request));
+        });
+    } else if (connection->phase == HTTPConnectionState::Phase::Streaming && !connection->input.empty()) {
+        HTTPConnection::DataHandler handler;
+        {
+            std::lock_guard<std::mutex> lock(connection->mutex);
+            if (!connection->closing) {
+                handler = connection->dataHandler;
+            }
+        }
+        if (!handler) {
+            connection->input.clear(); // SSE and scope clients have nothing to say
+            return;
+        }
+        std::string data;
+        data.swap(connection->input);
+        connection->taskRunning = true;
+        workers->post([this, connection, handler, data = std::move(data)]() {
+            postFinishedTask(connection, handler(data));
+        });
+    }
+}
+
+// result: for a request, whether its response is complete (false: it became
+// a stream); for stream data, whether to keep the connection
+void StaticServer::finishTask(const std::shared_ptr<HTTPConnectionState>& connection, bool result) {
+    if (!connections.count(connection->id)) {
         return;
     }
+    connection->taskRunning = false;
+    if (connection->phase == HTTPConnectionState::Phase::Processing) {
+        // Whatever followed the request (the next pipelined request, or the
+        // first WebSocket frames) goes back in front of what arrived since
+        std::string& previous = connection->requestBuffer;
+        previous.erase(0, connection->parser.consumed());
+        previous += connection->input;
+        connection->input.swap(previous);
+        previous.clear();
+        connection->parser.reset();
+
+        if (!result) {
+            connection->phase = HTTPConnectionState::Phase::Streaming;
+        } else if (connection->keepAlive) {
+            connection->phase = HTTPConnectionState::Phase::Reading;
+            connection->lastRead = std::chrono::steady_clock::now(); // the idle timeout starts now
+        } else {
+            HTTPConnection(connection).close();
+        }
+    } else if (!result) {
+        HTTPConnection(connection).close(); // after whatever the handler sent last, e.g. a close frame
+    }
+    flushConnection(connection);
+    if (connections.count(connection->id)) {
+        dispatch(connection);
+        closeIfPeerDone(connection);
+    }
+}
 
-    std::string request(buffer, bytesReceived);
-    std::string method, path, headers, body;
-    
-    std::string version = parseHTTPRequest(request, method, path, headers, body);
-    if (version.empty()) {
-        send500(clientSocket);
+void StaticServer::postFinishedTask(const std::shared_ptr<HTTPConnectionState>& connection, bool result) {
+    bool wake;
+    {
+        std::lock_guard<std::mutex> lock(loopMutex);
+        finishedTasks.emplace_back(connection, result);
+        wake = !wakePending;
+        wakePending = true;
+    }
+    if (wake) {
+        wakeLoop();
+    }
+}
+
+void StaticServer::queueWrite(const std::shared_ptr<HTTPConnectionState>& connection) {
+    bool wake;
+    {
+        std::lock_guard<std::mutex> lock(loopMutex);
+        pendingWrites.push_back(connection);
+        wake = !wakePending;
+        wakePending = true;
+    }
+    if (wake) {
+        wakeLoop();
+    }
+}
+
+void StaticServer::closeConnection(const std::shared_ptr<HTTPConnectionState>& connection) {
+    unwatchSocket(connection->socket);
+    closesocket(connection->socket);
+    connections.erase(connection->id);
+
+    HTTPConnection::CloseHandler handler;
+    {
+        std::lock_guard<std::mutex> lock(connection->mutex);
+        connection->closed = true;
+        connection->output.clear();
+        connection->outputOffset = 0;
+        connection->queuedBytes = 0;
+        connection->dataHandler = nullptr;
+        handler.swap(connection->closeHandler);
+    }
+    if (handler) {
+        handler();
+    }
+}
+
+void StaticServer::closeIdleConnections() {
+    const auto now = std::chrono::steady_clock::now();
+    std::vector<std::shared_ptr<HTTPConnectionState>> idle;
+    for (const auto& [id, connection] : connections) {
+        bool requestStalled = connection->phase == HTTPConnectionState::Phase::Reading
+            && now - connection->lastRead > std::chrono::milliseconds(REQUEST_TIMEOUT_MS);
+        bool writeStalled = connection->writeInterest
+            && now - connection->lastWrite > std::chrono::milliseconds(WRITE_TIMEOUT_MS);
+        if (requestStalled || writeStalled) {
+            idle.push_back(connection);
+        }
+    }
+    for (const auto& connection : idle) {
+        closeConnection(connection);
+    }
+}
+
+#ifdef _WIN32
+
+// Windows has no epoll; WSAPoll over every socket is fine for a few hundred
+// connections. A UDP socket connected to itself wakes it up.
+bool StaticServer::openPoller() {
+    wakeSocket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    int addressLength = sizeof(address);
+    if (wakeSocket == INVALID_SOCKET
+        || bind(wakeSocket, (sockaddr*)&address, sizeof(address)) == SOCKET_ERROR
+        || getsockname(wakeSocket, (sockaddr*)&address, &addressLength) == SOCKET_ERROR
+        || connect(wakeSocket, (sockaddr*)&address, sizeof(address)) == SOCKET_ERROR) {
+        closePoller();
+        return false;
+    }
+    setNonBlocking(wakeSocket);
+    return true;
+}
+
+void StaticServer::closePoller() {
+    if (wakeSocket != INVALID_SOCKET) {
+        closesocket(wakeSocket);
+        wakeSocket = INVALID_SOCKET;
+    }
+}
+
+void StaticServer::watchSocket(socket_t, uint64_t) {
+    // pollEvents() builds the set from connections on every call
+}
+
+void StaticServer::updateInterest(const HTTPConnectionState&) {
+    // pollEvents() reads writeInterest and peerClosed
+}
+
+void StaticServer::unwatchSocket(socket_t) {
+}
+
+void StaticServer::pollEvents(int timeoutMs, std::vector<PollEvent>& events) {
+    std::vector<WSAPOLLFD> fds;
+    std::vector<uint64_t> ids;
+    if (!acceptPaused) {
+        fds.push_back({listenSocket, POLLRDNORM, 0});
+        ids.push_back(LISTEN_ID);
+    }
+    fds.push_back({wakeSocket, POLLRDNORM, 0});
+    ids.push_back(WAKE_ID);
+    for (const auto& [id, connection] : connections) {
+        const SHORT interest = static_cast<SHORT>((connection->peerClosed ? 0 : POLLRDNORM) | (connection->writeInterest ? POLLWRNORM : 0));
+        fds.push_back({connection->socket, interest, 0});
+        ids.push_back(id);
+    }
+
+    events.clear();
+    if (WSAPoll(fds.data(), static_cast<ULONG>(fds.size()), timeoutMs) <= 0) {
         return;
     }
+    for (size_t i = 0; i < fds.size(); ++i) {
+        if (fds[i].revents != 0) {
+            events.push_back({ids[i], (fds[i].revents & (POLLRDNORM | POLLHUP | POLLERR)) != 0, (fds[i].revents & POLLWRNORM) != 0});
+        }
+    }
+}
+
+void StaticServer::drainWakeups() {
+    char buffer[64];
+    while (recv(wakeSocket, buffer, sizeof(buffer), 0) > 0) {
+    }
+}
 
+void StaticServer::wakeLoop() {
+    ::send(wakeSocket, "w", 1, 0);
+}
+
+#else
+
+bool StaticServer::openPoller() {
+    pollFd = epoll_create1(EPOLL_CLOEXEC);
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (pollFd < 0 || wakeFd < 0) {
+        closePoller();
+        return false;
+    }
+    watchSocket(wakeFd, WAKE_ID);
+    return true;
+}
+
+void StaticServer::closePoller() {
+    if (wakeFd >= 0) {
+        close(wakeFd);
+        wakeFd = -1;
+    }
+    if (pollFd >= 0) {
+        close(pollFd);
+        pollFd = -1;
+    }
+}
+
+void StaticServer::watchSocket(socket_t socket, uint64_t id) {
+    epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.u64 = id;
+    epoll_ctl(pollFd, EPOLL_CTL_ADD, socket, &event);
+}
+
+void StaticServer::updateInterest(const HTTPConnectionState& connection) {
+    epoll_event event = {};
+    event.events = (connection.peerClosed ? 0u : static_cast<uint32_t>(EPOLLIN))
+                 | (connection.writeInterest ? static_cast<uint32_t>(EPOLLOUT) : 0u);
+    event.data.u64 = connection.id;
+    epoll_ctl(pollFd, EPOLL_CTL_MOD, connection.socket, &event);
+}
+
+void StaticServer::unwatchSocket(socket_t socket) {
+    epoll_ctl(pollFd, EPOLL_CTL_DEL, socket, nullptr);
+}
+
+void StaticServer::pollEvents(int timeoutMs, std::vector<PollEvent>& events) {
+    epoll_event ready[256];
+    int count = epoll_wait(pollFd, ready, 256, timeoutMs);
+    events.clear();
+    for (int i = 0; i < count; ++i) {
+        const uint32_t flags = ready[i].events;
+        events.push_back({ready[i].data.u64, (flags & (EPOLLIN | EPOLLHUP | EPOLLERR)) != 0, (flags & EPOLLOUT) != 0});
+    }
+}
+
+void StaticServer::drainWakeups() {
+    uint64_t count;
+    while (read(wakeFd, &count, sizeof(count)) > 0) {
+    }
+}
+
+void StaticServer::wakeLoop() {
+    const uint64_t one = 1;
+    ssize_t written = write(wakeFd, &one, sizeof(one));
+    (void)written; // only fails when the counter is already non-zero
+}
+
+#endif
+
+// Worker thread: answers one request. Returns true when the response is
+// complete, false when the connection became a stream.
+bool StaticServer::handleRequest(const HTTPConnection& connection, const HTTPRequest& request) {
     // Remove query parameters from path
-    size_t queryPos = path.find('?');
-    if (queryPos != std::string::npos) {
-        path = path.substr(0, queryPos);
+    std::string_view target = request.target;
+    size_t queryPos = target.find('?');
+    if (queryPos != std::string_view::npos) {
+        target = target.substr(0, queryPos);
     }
 
     // URL decode path
-    path = urlDecode(path);
+    const std::string path = urlDecode(target);
 
     // Route the request
-    shouldCloseSocket = handleHTTPRequest(clientSocket, method, path, headers, body);
-    if (!shouldCloseSocket && path != "/events") {
-        // If we're not closing the socket but it's not an SSE endpoint, something went wrong
-        send500(clientSocket);
-        shouldCloseSocket = true;
+    bool complete = handleHTTPRequest(connection, request, path);
+    if (!complete && path != "/events" && path != "/ws" && path.rfind("/api/scope/stream/", 0) != 0) {
+        // If we're not closing the socket but it's not a streaming endpoint, something went wrong
+        send500(connection);
+        complete = true;
     }
+    return complete;
 }
 
-bool StaticServer::handleHTTPRequest(socket_t clientSocket, const std::string& method, const std::string& path, const std::string& headers, const std::string& body) {
+bool StaticServer::handleHTTPRequest(const HTTPConnection& connection, const HTTPRequest& request, const std::string& path) {
+    const std::string_view method = request.method;
+
     // Handle SSE endpoint
     if (path == "/events" && method == "GET") {
         if (sseServer) {
-            sseServer->addClient(clientSocket);
+            sseServer->addClient(connection);
             // Send initial state to new client - this will be handled by a callback
             return false; // Don't close the socket, SSE will handle it
         } else {
-            send500(clientSocket);
+            send500(connection);
             return true;
         }
     }
     
+    // Handle WebSocket upgrade
+    if (path == "/ws" && method == "GET") {
+        if (webSocketServer) {
+            return !webSocketServer->upgrade(connection, request);
+        } else {
+            send500(connection);
+            return true;
+        }
+    }
+
     // Handle API endpoints
     if (path.substr(0, 5) == "/api/") {
         if (httpAPIHandler) {
-            return httpAPIHandler->handleAPIRequest(clientSocket, method, path, body);
+            return httpAPIHandler->handleAPIRequest(connection, method, path, request.body);
         } else {
-            send500(clientSocket);
+            send500(connection);
             return true;
         }
     }
     
     // Handle static files
     if (method == "GET") {
-        handleStaticFile(clientSocket, path);
+        handleStaticFile(connection, request, path);
         return true;
     }
     
     // Method not allowed
-    sendResponse(clientSocket, 405, "text/plain", "Method Not Allowed");
+    sendResponse(connection, 405, "text/plain", "Method Not Allowed");
     return true;
 }
 
-void StaticServer::handleStaticFile(socket_t clientSocket, const std::string& path) {
+void StaticServer::handleStaticFile(const HTTPConnection& connection, const HTTPRequest& request, const std::string& path) {
     std::string filePath = path;
     
     // Map root to gui.html
@@ -211,44 +881,44 @@ void StaticServer::handleStaticFile(socket_t clientSocket, const std::string& pa
 
     // Security check
     if (!isPathSafe(filePath)) {
-        send404(clientSocket);
+        send404(connection);
         return;
     }
 
-    // Build full file path
-    std::filesystem::path fullPath = std::filesystem::path(rootDirectory) / filePath.substr(1); // Remove leading '/'
-    
+    std::shared_ptr<const Asset> asset;
     try {
-        if (!std::filesystem::exists(fullPath) || !std::filesystem::is_regular_file(fullPath)) {
-            send404(clientSocket);
-            return;
-        }
-
-        std::ifstream file(fullPath, std::ios::binary);
-        if (!file) {
-            send500(clientSocket);
-            return;
-        }
-
-        // Get file size
-        file.seekg(0, std::ios::end);
-        size_t fileSize = file.tellg();
-        file.seekg(0, std::ios::beg);
-
-        // Read file content
-        std::string content(fileSize, '\0');
-        file.read(&content[0], fileSize);
-
-        // Get MIME type
-        std::string extension = fullPath.extension().string();
-        std::string mimeType = getMimeType(extension);
-
-        sendResponse(clientSocket, 200, mimeType, content);
-
+        asset = assets->get(filePath);
     } catch (const std::exception& e) {
         std::cerr << "StaticServer: Error serving file " << filePath << ": " << e.what() << std::endl;
-        send500(clientSocket);
+        send500(connection);
+        return;
+    }
+    if (!asset) {
+        send404(connection);
+        return;
+    }
+
+    // Browsers revalidate each load (no-cache) and get a 304 while the file is unchanged
+    const Asset::Representation& representation = asset->select(request.header("Accept-Encoding"));
+    std::string headers = "ETag: " + representation.etag + "\r\nCache-Control: no-cache\r\n";
+    if (asset->hasVariants()) {
+        headers += "Vary: Accept-Encoding\r\n";
+    }
+    const std::string_view ifNoneMatch = request.header("If-None-Match");
+    std::string head;
+    if (!ifNoneMatch.empty() && etagMatches(ifNoneMatch, representation.etag)) {
+        appendResponseHead(head, 304, "", NO_CONTENT_LENGTH, connection.keepAlive(), headers);
+        connection.send(std::move(head));
+        return;
+    }
+    if (representation.encoding) {
+        headers += "Content-Encoding: ";
+        headers += representation.encoding;
+        headers += "\r\n";
     }
+    appendResponseHead(head, 200, asset->contentType, representation.bytes->size(), connection.keepAlive(), headers);
+    connection.send(std::move(head));
+    connection.send(representation.bytes);
 }
 
 std::string StaticServer::getMimeType(const std::string& extension) {
@@ -273,20 +943,16 @@ std::string StaticServer::getMimeType(const std::string& extension) {
     return (it != mimeTypes.end()) ? it->second : "application/octet-stream";
 }
 
-std::string StaticServer::urlDecode(const std::string& encoded) {
+std::string StaticServer::urlDecode(std::string_view encoded) {
     std::string decoded;
     decoded.reserve(encoded.length());
 
     for (size_t i = 0; i < encoded.length(); ++i) {
-        if (encoded[i] == '%' && i + 2 < encoded.length()) {
-            int value;
-            std::istringstream is(encoded.substr(i + 1, 2));
-            if (is >> std::hex >> value) {
-                decoded += static_cast<char>(value);
-                i += 2;
-            } else {
-                decoded += encoded[i];
-            }
+        unsigned value = 0;
+        if (encoded[i] == '%' && i + 2 < encoded.length()
+            && std::from_chars(encoded.data() + i + 1, encoded.data() + i + 3, value, 16).ptr == encoded.data() + i + 3) {
+            decoded += static_cast<char>(value);
+            i += 2;
         } else if (encoded[i] == '+') {
             decoded += ' ';
         } else {
@@ -316,69 +982,20 @@ bool StaticServer::isPathSafe(const std::string& path) {
     return true;
 }
 
-void StaticServer::sendResponse(socket_t clientSocket, int statusCode, const std::string& contentType, const std::string& body) {
-    std::ostringstream response;
-    response << "HTTP/1.1 " << statusCode;
-    
-    switch (statusCode) {
-        case 200: response << " OK"; break;
-        case 404: response << " Not Found"; break;
-        case 500: response << " Internal Server Error"; break;
-        default: response << " Unknown"; break;
-    }
-    
-    response << "\r\n";
-    response << "Content-Type: " << contentType << "\r\n";
-    response << "Content-Length: " << body.length() << "\r\n";
-    response << "Connection: close\r\n";
-    response << "\r\n";
-    response << body;
-
-    std::string responseStr = response.str();
-    send(clientSocket, responseStr.c_str(), responseStr.length(), 0);
+void StaticServer::sendResponse(const HTTPConnection& connection, int statusCode, const std::string& contentType, const std::string& body) {
+    std::string response;
+    response.reserve(128 + body.size());
+    appendResponseHead(response, statusCode, contentType, body.size(), connection.keepAlive());
+    response += body;
+    connection.send(std::move(response));
 }
 
-void StaticServer::send404(socket_t clientSocket) {
+void StaticServer::send404(const HTTPConnection& connection) {
     std::string body = "<html><body><h1>404 Not Found</h1></body></html>";
-    sendResponse(clientSocket, 404, "text/html", body);
+    sendResponse(connection, 404, "text/html", body);
 }
 
-void StaticServer::send500(socket_t clientSocket) {
+void StaticServer::send500(const HTTPConnection& connection) {
     std::string body = "<html><body><h1>500 Internal Server Error</h1></body></html>";
-    sendResponse(clientSocket, 500, "text/html", body);
+    sendResponse(connection, 500, "text/html", body);
 }
-
-std::string StaticServer::parseHTTPRequest(const std::string& request, std::string& method, std::string& path, std::string& headers, std::string& body) {
-    std::istringstream stream(request);
-    std::string version;
-    
-    // Parse first line: METHOD PATH VERSION
-    if (!(stream >> method >> path >> version)) {
-        return "";
-    }
-    
-    // Read rest of the first line
-    std::string line;
-    std::getline(stream, line);
-    
-    // Read headers until empty line
-    std::ostringstream headerStream;
-    while (std::getline(stream, line) && line != "\r" && !line.empty()) {
-        headerStream << line << "\n";
-    }
-    headers = headerStream.str();
-    
-    // Read body (everything after headers)
-    std::ostringstream bodyStream;
-    while (std::getline(stream, line)) {
-        bodyStream << line << "\n";
-    }
-    body = bodyStream.str();
-    
-    // Remove trailing newline from body if present
-    if (!body.empty() && body.back() == '\n') {
-        body.pop_back();
-    }
-    
-    return version;
-} 
\ No newline at end of file
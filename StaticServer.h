@@ -19,27 +19,106 @@ typedef int socket_t;
 #endif
 
 #include <string>
+#include <string_view>
 #include <atomic>
+#include <chrono>
 #include <thread>
 #include <memory>
+#include <mutex>
+#include <vector>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include "HTTPParser.cpp"
 
 // Forward declarations
 class SSEServer;
 class HTTPAPIHandler;
+class WebSocketServer;
+class WorkerPool;
+class AssetCache;
+class StaticServer;
+struct HTTPConnectionState;
 
+// Handle to one client connection of StaticServer, given to request handlers.
+// Cheap to copy; streams (SSE, scope, WebSocket) keep it after their request
+// returns. send() only queues the data for the event loop and never blocks,
+// so it can be called from any thread.
+class HTTPConnection {
+public:
+    using DataHandler = std::function<bool(const std::string& data)>;
+    using CloseHandler = std::function<void()>;
+
+    explicit HTTPConnection(std::shared_ptr<HTTPConnectionState> state = nullptr);
+
+    uint64_t id() const;
+    // Whether the request being answered asked to keep the connection open;
+    // responses say so in their Connection header
+    bool keepAlive() const;
+
+    // False once the connection is closed, or when the client has fallen so
+    // far behind (MAX_QUEUED_BYTES unsent) that it gets dropped
+    bool send(std::string data) const;
+    // Sends a buffer that outlives the call (a cached file) without copying it
+    bool send(std::shared_ptr<const std::string> data) const;
+    // Bytes queued but not yet taken by the socket
+    size_t queuedBytes() const;
+    // Closes once the queued data is written
+    void close() const;
+
+    // For streams that read from the client (WebSocket): called on a worker
+    // with each batch of received bytes, one call at a time; false closes
+    void setDataHandler(DataHandler handler) const;
+    // Called once when the connection closes, from either side
+    void setCloseHandler(CloseHandler handler) const;
+
+    bool operator==(const HTTPConnection& other) const { return state == other.state; }
+
+private:
+    std::shared_ptr<HTTPConnectionState> state;
+
+    bool queue(std::string owned, std::shared_ptr<const std::string> shared) const;
+};
+
+// HTTP server for the GUI: static files, the HTTP API, SSE, scope streams
+// and WebSocket, all on one port. A single event loop (epoll on Linux,
+// WSAPoll on Windows) owns every socket and does all reads and writes
+// without blocking; complete requests are handed to a small worker pool.
+// Each connection moves through
+//     Reading -> Processing (on a worker) -> Reading, or closing once written
+//                                         \-> Streaming (SSE, scope, WebSocket)
+// and back to Reading after a response when the client keeps the connection
+// alive; pipelined requests are answered one after another, in order. A
+// connection is dropped when it sits for REQUEST_TIMEOUT_MS without a
+// complete request, or its output makes no progress for WRITE_TIMEOUT_MS.
 class StaticServer {
 public:
+    static constexpr size_t MAX_REQUEST_BYTES = 1 << 20;
+    static constexpr size_t MAX_QUEUED_BYTES = 4 << 20;
+    static constexpr int REQUEST_TIMEOUT_MS = 10000;
+    static constexpr int WRITE_TIMEOUT_MS = 10000;
+    static constexpr int ACCEPT_RETRY_MS = 500; // pause after accept() fails, e.g. out of descriptors
+
     StaticServer(const std::string& rootDir, uint16_t port = 8080);
     ~StaticServer();
 
     bool start();
     void stop();
-    
+
     // Set handlers for SSE and API
     void setSSEServer(std::shared_ptr<SSEServer> sseServer);
     void setHTTPAPIHandler(std::shared_ptr<HTTPAPIHandler> apiHandler);
+    void setWebSocketServer(std::shared_ptr<WebSocketServer> webSocketServer);
 
 private:
+    friend class HTTPConnection;
+
+    struct PollEvent {
+        uint64_t id;
+        bool readable;
+        bool writable;
+    };
+
     std::string rootDirectory;
     uint16_t serverPort;
     std::atomic<bool> running;
@@ -47,16 +126,58 @@ private:
     socket_t listenSocket;
     std::shared_ptr<SSEServer> sseServer;
     std::shared_ptr<HTTPAPIHandler> httpAPIHandler;
+    std::shared_ptr<WebSocketServer> webSocketServer;
+    std::unique_ptr<WorkerPool> workers;
+    std::unique_ptr<AssetCache> assets;
+
+    // Event loop thread only
+    std::unordered_map<uint64_t, std::shared_ptr<HTTPConnectionState>> connections;
+    uint64_t nextConnectionId;
+    bool acceptPaused;  // listen socket unwatched until acceptResume
+    bool acceptFailing; // logged the current run of accept() failures
+    std::chrono::steady_clock::time_point acceptResume;
+#ifdef _WIN32
+    socket_t wakeSocket;
+#else
+    int pollFd;
+    int wakeFd;
+#endif
+
+    // Work handed to the loop by other threads; guarded by loopMutex
+    std::mutex loopMutex;
+    std::vector<std::shared_ptr<HTTPConnectionState>> pendingWrites;
+    std::vector<std::pair<std::shared_ptr<HTTPConnectionState>, bool>> finishedTasks;
+    bool wakePending;
 
     void serverLoop();
-    void handleClient(socket_t clientSocket, bool& shouldCloseSocket);
-    bool handleHTTPRequest(socket_t clientSocket, const std::string& method, const std::string& path, const std::string& headers, const std::string& body);
-    void handleStaticFile(socket_t clientSocket, const std::string& path);
+    void acceptConnections();
+    void readConnection(const std::shared_ptr<HTTPConnectionState>& connection);
+    void flushConnection(const std::shared_ptr<HTTPConnectionState>& connection);
+    void dispatch(const std::shared_ptr<HTTPConnectionState>& connection);
+    void finishTask(const std::shared_ptr<HTTPConnectionState>& connection, bool result);
+    void postFinishedTask(const std::shared_ptr<HTTPConnectionState>& connection, bool result);
+    void closeConnection(const std::shared_ptr<HTTPConnectionState>& connection);
+    void closeIfPeerDone(const std::shared_ptr<HTTPConnectionState>& connection);
+    void closeIdleConnections();
+    void queueWrite(const std::shared_ptr<HTTPConnectionState>& connection);
+    void wakeLoop();
+
+    // Platform poller
+    bool openPoller();
+    void closePoller();
+    void watchSocket(socket_t socket, uint64_t id);
+    void updateInterest(const HTTPConnectionState& connection); // from writeInterest and peerClosed
+    void unwatchSocket(socket_t socket);
+    void pollEvents(int timeoutMs, std::vector<PollEvent>& events);
+    void drainWakeups();
+
+    bool handleRequest(const HTTPConnection& connection, const HTTPRequest& request);
+    bool handleHTTPRequest(const HTTPConnection& connection, const HTTPRequest& request, const std::string& path);
+    void handleStaticFile(const HTTPConnection& connection, const HTTPRequest& request, const std::string& path);
     std::string getMimeType(const std::string& extension);
-    std::string urlDecode(const std::string& encoded);
+    std::string urlDecode(std::string_view encoded);
     bool isPathSafe(const std::string& path);
-    void sendResponse(socket_t clientSocket, int statusCode, const std::string& contentType, const std::string& body);
-    void send404(socket_t clientSocket);
-    void send500(socket_t clientSocket);
-    std::string parseHTTPRequest(const std::string& request, std::string& method, std::string& path, std::string& headers, std::string& body);
-}; 
\ No newline at end of file
+    void sendResponse(const HTTPConnection& connection, int statusCode, const std::string& contentType, const std::string& body);
+    void send404(const HTTPConnection& connection);
+    void send500(const HTTPConnection& connection);
+};
@@ -0,0 +1,364 @@
+#pragma once
+
+#include <vector>
+#include <array>
+#include <cmath>
+#include <memory>
+#include <random>
+#include <functional>
+#include <type_traits>
+#include "SoundGenerator.cpp"
+#include "ADSRGenerator.cpp"
+#include "math.cpp"
+
+// Compile-time voice composition.
+//
+// The runtime presets chain std::shared_ptr<SoundGenerator> nodes, so the
+// compiler cannot inline across node boundaries. The templates below compose
+// the same DSP by value, e.g.
+//
+//     compose::Voice<compose::ADSR<compose::Tremolo<compose::Osc<compose::Saw>>>>
+//
+// which instantiates a single monomorphic render loop per preset. Nodes are
+// templated on the sample type (float or double). Voice is the only
+// SoundGenerator in the chain; it registers the nested nodes' Parameters with
+// the same names and ranges as the runtime nodes, so ActiveTones and
+// ServerHandler cannot tell the two apart.
+namespace compose {
+
+using ParameterSink = std::function<void(std::unique_ptr<Parameter>)>;
+
+// Matches Oscillator: random start phase to prevent phase alignment between voices
+inline float randomPhase() {
+    static thread_local std::random_device rd;
+    static thread_local std::mt19937 gen(rd());
+    static thread_local std::uniform_real_distribution<float> dis(0.0f, 2.0f * PI);
+    return dis(gen);
+}
+
+// Waveform shapes, evaluated at a phase in [0, 2*PI)
+struct Sine {
+    template <typename T> static T eval(T phase) { return std::sin(phase); }
+};
+struct Square {
+    template <typename T> static T eval(T phase) { return std::sin(phase) >= T(0) ? T(1) : T(-1); }
+};
+struct Triangle {
+    template <typename T> static T eval(T phase) { return T(2.0 / PI) * std::asin(std::sin(phase)); }
+};
+struct Saw {
+    template <typename T> static T eval(T phase) { return T(2.0 / PI) * (phase - T(PI)); }
+};
+
+template <typename Shape, typename Sample = float>
+class Osc {
+public:
+    using sample_type = Sample;
+
+    Osc(float frequency, float volume) : frequency(frequency), volume(volume), phase(randomPhase()) {}
+
+    void render(Sample* out, size_t frames, float sampleRate) {
+        const Sample twoPi = Sample(2.0 * PI);
+        const Sample increment = twoPi * frequency / sampleRate;
+        for (size_t i = 0; i < frames; ++i) {
+            out[i] = Shape::eval(phase) * volume;
+            phase += increment;
+            if (phase >= twoPi) phase -= twoPi;
+        }
+    }
+
+    void noteOn(float) {}
+    void noteOff() {}
+    bool isActive() const { return true; }
+    float level() const { return 1.0f; }
+    void stop() {}
+    void retune(float ratio) { frequency *= ratio; }
+    void bindParameters(const ParameterSink&) {}
+
+private:
+    Sample frequency;
+    Sample volume;
+    Sample phase;
+};
+
+// Same algorithm and parameters as FMVoice, with both sine oscillators inlined
+template <typename Sample = float>
+class FM {
+public:
+    using sample_type = Sample;
+
+    FM(float carrierFreq, float modulatorFreq, float modulationIndex = 1.0f, float selfModulationIndex = 0.7f)
+        : carrierFrequency(carrierFreq), modulatorFrequency(modulatorFreq),
+          modulationIndex(modulationIndex), selfModulationIndex(selfModulationIndex),
+          carrierPhase(randomPhase()), modulatorPhase(randomPhase()),
+          carrierCurrentFrequency(carrierFreq), modulatorCurrentFrequency(modulatorFreq) {}
+
+    void render(Sample* out, size_t frames, float sampleRate) {
+        const Sample twoPi = Sample(2.0 * PI);
+        const Sample radiansPerHz = twoPi / sampleRate;
+        for (size_t i = 0; i < frames; ++i) {
+            Sample modulatorSample = std::sin(modulatorPhase);
+            modulatorPhase += radiansPerHz * modulatorCurrentFrequency;
+            if (modulatorPhase >= twoPi) modulatorPhase -= twoPi;
+
+            modulatorCurrentFrequency = modulatorFrequency + selfModulationIndex * modulatorSample * modulatorFrequency;
+            carrierCurrentFrequency = carrierFrequency + modulationIndex * modulatorSample * carrierFrequency;
+
+            out[i] = std::sin(carrierPhase);
+            carrierPhase += radiansPerHz * carrierCurrentFrequency;
+            if (carrierPhase >= twoPi) carrierPhase -= twoPi;
+        }
+    }
+
+    void noteOn(float) {}
+    void noteOff() {}
+    bool isActive() const { return true; }
+    float level() const { return 1.0f; }
+    void stop() {}
+
+    void retune(float ratio) {
+        carrierFrequency *= ratio;
+        modulatorFrequency *= ratio;
+        carrierCurrentFrequency *= ratio;
+        modulatorCurrentFrequency *= ratio;
+    }
+
+    void bindParameters(const ParameterSink& add) {
+        add(std::make_unique<Parameter>("Modulator Frequency Ratio", static_cast<float>(modulatorFrequency / carrierFrequency), 0.1f, 10.0f, 0.01f, "", [this](float value) {
+            modulatorFrequency = value * carrierFrequency;
+            modulatorCurrentFrequency = modulatorFrequency;
+        }));
+        add(std::make_unique<Parameter>("Modulation Index", static_cast<float>(modulationIndex), 0.0f, 10.0f, 0.01f, "", [this](float value) {
+            modulationIndex = value;
+        }));
+        add(std::make_unique<Parameter>("Self Modulation Index", static_cast<float>(selfModulationIndex), 0.0f, 10.0f, 0.01f, "", [this](float value) {
+            selfModulationIndex = value;
+        }));
+    }
+
+private:
+    Sample carrierFrequency;
+    Sample modulatorFrequency;
+    Sample modulationIndex;
+    Sample selfModulationIndex;
+    Sample carrierPhase;
+    Sample modulatorPhase;
+    Sample carrierCurrentFrequency;
+    Sample modulatorCurrentFrequency;
+};
+
+// Same algorithm and parameters as the runtime Tremolo effect
+template <typename Source>
+class Tremolo {
+public:
+    using sample_type = typename Source::sample_type;
+
+    Tremolo(Source source, float rate, float depth)
+        : source(std::move(source)), rate(rate), depth(depth) {}
+
+    void render(sample_type* out, size_t frames, float sampleRate) {
+        source.render(out, frames, sampleRate);
+
+        const float phaseIncrement = rate / sampleRate;
+        for (size_t i = 0; i < frames; ++i) {
+            sample_type sample = out[i];
+
+            phase += phaseIncrement;
+            if (phase >= 1.0f) phase -= 1.0f;
+
+            // Only move the gain at zero crossings to avoid clicks
+            if ((lastSample <= 0 && sample > 0) || (lastSample >= 0 && sample < 0)) {
+                float modulation = 0.5f * (1.0f + std::sin(2.0f * PI * phase));
+                currentAmplitude = 1.0f - depth * modulation;
+            }
+
+            lastSample = sample;
+            out[i] = sample * currentAmplitude;
+        }
+    }
+
+    void noteOn(float velocity) { source.noteOn(velocity); }
+    void noteOff() { source.noteOff(); }
+    bool isActive() const { return source.isActive(); }
+    float level() const { return source.level(); }
+    void stop() { source.stop(); }
+    void retune(float ratio) { source.retune(ratio); }
+
+    void bindParameters(const ParameterSink& add) {
+        add(std::make_unique<Parameter>("Rate", rate, 0.1f, 20.0f, 0.1f, "Hz", [this](float value) { rate = value; }));
+        add(std::make_unique<Parameter>("Depth", depth, 0.0f, 1.0f, 0.01f, "", [this](float value) { depth = value; }));
+        source.bindParameters(add);
+    }
+
+private:
+    Source source;
+    float rate;
+    float depth;
+    float phase = 0.0f;
+    sample_type lastSample = 0;
+    sample_type currentAmplitude = 1;
+};
+
+template <typename Source>
+class ADSR {
+public:
+    using sample_type = typename Source::sample_type;
+
+    ADSR(Source source, float attack = 0.1f, float decay = 0.1f, float sustain = 0.7f, float release = 0.3f)
+        : source(std::move(source)), envelope(attack, decay, sustain, release) {}
+
+    void render(sample_type* out, size_t frames, float sampleRate) {
+        if (envelope.isIdle()) {
+            std::fill(out, out + frames, sample_type(0));
+            return;
+        }
+        source.render(out, frames, sampleRate);
+        envelope.apply(out, frames, sampleRate);
+    }
+
+    void noteOn(float velocity) {
+        source.noteOn(std::clamp(velocity, 0.0f, 1.0f));
+        envelope.noteOn(velocity);
+    }
+
+    void noteOff() {
+        source.noteOff();
+        envelope.noteOff();
+    }
+
+    bool isActive() const { return envelope.active; }
+    float level() const { return envelope.level(); }
+
+    void stop() {
+        source.stop();
+        envelope.stop();
+    }
+
+    void retune(float ratio) { source.retune(ratio); }
+
+    void bindParameters(const ParameterSink& add) {
+        add(std::make_unique<Parameter>("Attack", envelope.attackTime, 0.01f, 10.0f, 0.01f, "s", [this](float value) { envelope.attackTime = value; }));
+        add(std::make_unique<Parameter>("Decay", envelope.decayTime, 0.01f, 10.0f, 0.01f, "s", [this](float value) { envelope.decayTime = value; }));
+        add(std::make_unique<Parameter>("Sustain", envelope.sustainLevel, 0.0f, 1.0f, 0.01f, "", [this](float value) { envelope.sustainLevel = value; }));
+        add(std::make_unique<Parameter>("Release", envelope.releaseTime, 0.01f, 10.0f, 0.01f, "s", [this](float value) { envelope.releaseTime = value; }));
+        source.bindParameters(add);
+    }
+
+private:
+    Source source;
+    ADSREnvelope envelope;
+};
+
+// Same algorithm and parameters as InterpolatedDelay
+template <typename Source>
+class Delay {
+public:
+    using sample_type = typename Source::sample_type;
+
+    Delay(Source source, float delaySamples, float feedback, float mix, float sampleRate)
+        : source(std::move(source)), delayBuffer(makeDspBuffer<sample_type>(static_cast<size_t>(sampleRate * 2))),
+          feedback(feedback), mix(mix), delaySamples(delaySamples) {}
+
+    void render(sample_type* out, size_t frames, float sampleRate) {
+        source.render(out, frames, sampleRate);
+
+        const size_t bufferSize = delayBuffer.size();
+        for (size_t i = 0; i < frames; ++i) {
+            sample_type inputSample = out[i];
+
+            float readPos = static_cast<float>(writeIndex) - delaySamples;
+            while (readPos < 0.0f) readPos += bufferSize;
+            size_t index1 = static_cast<size_t>(readPos) % bufferSize;
+            size_t index2 = (index1 + 1) % bufferSize;
+            sample_type frac = readPos - std::floor(readPos);
+
+            sample_type delaySample = (1 - frac) * delayBuffer[index1] + frac * delayBuffer[index2];
+            delayBuffer[writeIndex] = inputSample + delaySample * feedback;
+            if (++writeIndex == bufferSize) writeIndex = 0;
+
+            out[i] = inputSample * (1 - mix) + delaySample * mix;
+        }
+
+        // Echoes keep the voice alive after its source has gone quiet
+        if (source.isActive()) {
+            tailRemaining = delayTailSamples(delaySamples, feedback);
+        } else {
+            tailRemaining = std::max(tailRemaining - static_cast<float>(frames), 0.0f);
+        }
+    }
+
+    void noteOn(float velocity) { source.noteOn(velocity); }
+    void noteOff() { source.noteOff(); }
+    bool isActive() const { return tailRemaining > 0.0f || source.isActive(); }
+    float level() const { return source.level(); }
+
+    void stop() {
+        source.stop();
+        std::fill(delayBuffer.begin(), delayBuffer.end(), sample_type(0));
+        tailRemaining = 0.0f;
+    }
+
+    void retune(float ratio) { source.retune(ratio); }
+
+    void bindParameters(const ParameterSink& add) {
+        const float maxDelay = static_cast<float>(delayBuffer.size());
+        add(std::make_unique<Parameter>("Delay Samples", delaySamples, 0.0f, maxDelay, 0.1f, "samples", [this](float value) { delaySamples = value; }));
+        add(std::make_unique<Parameter>("Feedback", feedback, 0.0f, 0.99f, 0.01f, "", [this](float value) { feedback = value; }));
+        add(std::make_unique<Parameter>("Mix", mix, 0.0f, 1.0f, 0.01f, "", [this](float value) { mix = value; }));
+        source.bindParameters(add);
+    }
+
+private:
+    Source source;
+    DspBuffer<sample_type> delayBuffer;
+    size_t writeIndex = 0;
+    float feedback;
+    float mix;
+    float delaySamples;
+    float tailRemaining = 0.0f;
+};
+
+// Adapts a composed node tree to the SoundGenerator interface
+template <typename Root>
+class Voice : public SoundGenerator {
+public:
+    using sample_type = typename Root::sample_type;
+
+    explicit Voice(Root root) : root(std::move(root)) {
+        // Bind after root sits at its final address; the callbacks capture its nodes
+        this->root.bindParameters([this](std::unique_ptr<Parameter> param) {
+            addParam(std::move(param));
+        });
+    }
+
+    void process(float* out, size_t frames, float sampleRate) override {
+        if constexpr (std::is_same_v<sample_type, float>) {
+            root.render(out, frames, sampleRate);
+        } else {
+            root.render(scratch.data(), frames, sampleRate);
+            for (size_t i = 0; i < frames; ++i) {
+                out[i] = static_cast<float>(scratch[i]);
+            }
+        }
+    }
+
+    void noteOn(float velocity) override { root.noteOn(velocity); }
+    void noteOff() override { root.noteOff(); }
+    bool isActive() const override { return root.isActive(); }
+    float getLevel() const override { return root.level(); }
+    void stop() override { root.stop(); }
+    void retune(float ratio) override { root.retune(ratio); }
+
+private:
+    Root root;
+    std::conditional_t<std::is_same_v<sample_type, float>,
+                       std::array<float, 0>,
+                       std::array<sample_type, MAX_BLOCK_FRAMES>> scratch;
+};
+
+template <typename Root>
+std::shared_ptr<SoundGenerator> makeVoice(Root root) {
+    return makeNode<Voice<Root>>(std::move(root));
+}
+
+} // namespace compose
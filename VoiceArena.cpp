@@ -0,0 +1,143 @@
+#pragma once
+
+#include <memory>
+#include <memory_resource>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <new>
+
+// Monotonic arena that owns one voice bank. While a VoiceArena::Scope is
+// active on a thread, makeNode<T>() and DspBuffer place node objects and DSP
+// state in the arena instead of separate heap blocks, so a voice's nodes and
+// delay lines end up next to each other. Deallocation is a no-op; the memory
+// goes back in one step when the arena (and with it the voice bank) is
+// destroyed. Without a scope everything falls back to the default heap.
+//
+// Not thread-safe: give each build thread its own arena.
+class VoiceArena : public std::pmr::memory_resource {
+public:
+    static constexpr size_t CACHE_LINE = 64;
+
+    struct Stats {
+        size_t allocations = 0;
+        size_t bytesUsed = 0;     // requested, including alignment padding
+        size_t bytesReserved = 0; // chunks taken from the heap
+        size_t chunks = 0;
+
+        Stats& operator+=(const Stats& other) {
+            allocations += other.allocations;
+            bytesUsed += other.bytesUsed;
+            bytesReserved += other.bytesReserved;
+            chunks += other.chunks;
+            return *this;
+        }
+    };
+
+    explicit VoiceArena(size_t chunkBytes = 256 * 1024) : chunkBytes(chunkBytes) {}
+
+    ~VoiceArena() override {
+        for (const auto& chunk : chunks) {
+            ::operator delete(chunk.data, std::align_val_t(CACHE_LINE));
+        }
+    }
+
+    VoiceArena(const VoiceArena&) = delete;
+    VoiceArena& operator=(const VoiceArena&) = delete;
+
+    const Stats& getStats() const { return stats; }
+
+    // Routes arena-aware allocations on this thread into arena until destroyed
+    class Scope {
+    public:
+        explicit Scope(VoiceArena* arena) : previous(active()) { active() = arena; }
+        ~Scope() { active() = previous; }
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+    private:
+        VoiceArena* previous;
+    };
+
+    // The arena of the innermost Scope on this thread, or the default resource
+    static std::pmr::memory_resource* current() {
+        VoiceArena* arena = active();
+        return arena ? static_cast<std::pmr::memory_resource*>(arena) : std::pmr::get_default_resource();
+    }
+
+private:
+    struct Chunk {
+        std::byte* data;
+        size_t size;
+    };
+
+    size_t chunkBytes;
+    std::vector<Chunk> chunks;
+    size_t offset = 0; // into chunks.back()
+    Stats stats;
+
+    static VoiceArena*& active() {
+        static thread_local VoiceArena* arena = nullptr;
+        return arena;
+    }
+
+    void* do_allocate(size_t bytes, size_t alignment) override {
+        // Objects of a cache line or more start on their own line
+        if (bytes >= CACHE_LINE) {
+            alignment = std::max(alignment, CACHE_LINE);
+        }
+        stats.allocations++;
+        // Delay lines and other large buffers get a chunk of their own, so
+        // the chunk currently being filled keeps its free space
+        const size_t rounded = (bytes + CACHE_LINE - 1) & ~(CACHE_LINE - 1);
+        if (rounded > chunkBytes) {
+            std::byte* data = newChunk(rounded);
+            stats.bytesUsed += bytes;
+            if (chunks.size() > 1) {
+                std::swap(chunks.back(), chunks[chunks.size() - 2]);
+            } else {
+                offset = rounded;
+            }
+            return data;
+        }
+
+        size_t start = chunks.empty() ? 0 : (offset + alignment - 1) & ~(alignment - 1);
+        if (chunks.empty() || start + bytes > chunks.back().size) {
+            newChunk(chunkBytes);
+            start = 0;
+        }
+        stats.bytesUsed += bytes + (start - std::min(start, offset));
+        offset = start + bytes;
+        return chunks.back().data + start;
+    }
+
+    std::byte* newChunk(size_t size) {
+        chunks.push_back({static_cast<std::byte*>(::operator new(size, std::align_val_t(CACHE_LINE))), size});
+        stats.bytesReserved += size;
+        stats.chunks++;
+        return chunks.back().data;
+    }
+
+    void do_deallocate(void*, size_t, size_t) override {}
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+};
+
+// std::make_shared that allocates from the current VoiceArena, if any. Use it
+// for nodes built by voice factories.
+template <typename T, typename... Args>
+std::shared_ptr<T> makeNode(Args&&... args) {
+    return std::allocate_shared<T>(std::pmr::polymorphic_allocator<T>(VoiceArena::current()), std::forward<Args>(args)...);
+}
+
+// Sample storage for delay lines and other per-voice DSP state. Captures the
+// current arena at construction and keeps it when moved.
+template <typename T>
+using DspBuffer = std::pmr::vector<T>;
+
+template <typename T>
+DspBuffer<T> makeDspBuffer(size_t size, T value = T()) {
+    return DspBuffer<T>(size, value, VoiceArena::current());
+}
@@ -0,0 +1,260 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <cstdint>
+#include "SoundGenerator.cpp"
+#include "Voices.cpp"
+#include "ADSRGenerator.cpp"
+#include "Effects.cpp"
+#include "mixer.cpp"
+
+// Flattens a voice's SoundGenerator tree into a linear list of block ops.
+//
+// VoiceCompiler walks childGenerators once, when the voice is built, and
+// lowers the node types with a fixed topology (Mixer, ADSRGenerator, Tremolo,
+// Oscillator, FMVoice) into ops that call their non-virtual block kernels
+// directly. Any other node becomes a single Generator op that renders its
+// whole subtree through process(). Each op reads and writes numbered scratch
+// buffers. Buffer liveness is computed over the op list so buffers whose value
+// is dead are handed to later ops; the Trio preset needs one scratch buffer
+// besides the output.
+
+enum class VoiceOp : uint8_t {
+    Clear,        // dst = 0
+    Oscillator,   // dst = Oscillator block
+    FMVoice,      // dst = FMVoice block
+    Generator,    // dst = node->render() (opaque subtree)
+    EnvelopeGate, // if the envelope is idle: dst = 0, skip the next `skip` ops
+    Envelope,     // dst *= envelope
+    Tremolo,      // dst = tremolo(dst)
+    MixAdd        // dst += src * gain ramp
+};
+
+struct VoiceInstruction {
+    VoiceOp op;
+    int dst = 0;
+    int src = 0;
+    size_t skip = 0;
+    SoundGenerator* node = nullptr;
+    ADSREnvelope* envelope = nullptr;
+    SmoothedValue* gain = nullptr;
+};
+
+class VoiceProgram {
+public:
+    // Buffer 0 is the caller's output; buffers 1..scratchBufferCount live in scratch
+    std::vector<VoiceInstruction> instructions;
+    int scratchBufferCount = 0;
+
+    void allocateScratch() {
+        scratch.assign(static_cast<size_t>(scratchBufferCount) * MAX_BLOCK_FRAMES, 0.0f);
+    }
+
+    void run(float* out, size_t frames, float sampleRate) {
+        const size_t count = instructions.size();
+        for (size_t pc = 0; pc < count; ++pc) {
+            const VoiceInstruction& ins = instructions[pc];
+            float* dst = buffer(ins.dst, out);
+
+            // Lowered nodes are timed here, so the profile still shows them one by one
+            if (ins.node && ins.op != VoiceOp::Generator && nodeProfilingEnabled()) {
+                NodeProfiler::Timer timer(ins.node->profileSlot(), frames);
+                runNodeOp(ins, dst, frames, sampleRate);
+                continue;
+            }
+
+            switch (ins.op) {
+                case VoiceOp::Clear:
+                    std::fill(dst, dst + frames, 0.0f);
+                    break;
+                case VoiceOp::Oscillator:
+                case VoiceOp::FMVoice:
+                case VoiceOp::Tremolo:
+                    runNodeOp(ins, dst, frames, sampleRate);
+                    break;
+                case VoiceOp::Generator:
+                    ins.node->render(dst, frames, sampleRate);
+                    break;
+                case VoiceOp::EnvelopeGate:
+                    if (ins.envelope->isIdle()) {
+                        std::fill(dst, dst + frames, 0.0f);
+                        pc += ins.skip;
+                    }
+                    break;
+                case VoiceOp::Envelope:
+                    ins.envelope->apply(dst, frames, sampleRate);
+                    break;
+                case VoiceOp::MixAdd: {
+                    const float* src = buffer(ins.src, out);
+                    BlockRamp gain = ins.gain->nextBlock(frames, sampleRate);
+                    for (size_t i = 0; i < frames; ++i) {
+                        dst[i] += src[i] * gain.next();
+                    }
+                    break;
+                }
+            }
+        }
+    }
+
+private:
+    std::vector<float> scratch;
+
+    // The ops that call a node's non-virtual block kernel
+    static void runNodeOp(const VoiceInstruction& ins, float* dst, size_t frames, float sampleRate) {
+        switch (ins.op) {
+            case VoiceOp::Oscillator:
+                static_cast<Oscillator*>(ins.node)->Oscillator::process(dst, frames, sampleRate);
+                break;
+            case VoiceOp::FMVoice:
+                static_cast<FMVoice*>(ins.node)->FMVoice::process(dst, frames, sampleRate);
+                break;
+            case VoiceOp::Tremolo:
+                static_cast<Tremolo*>(ins.node)->applyTremolo(dst, frames, sampleRate);
+                break;
+            default:
+                break;
+        }
+    }
+
+    float* buffer(int index, float* out) {
+        return index == 0 ? out : scratch.data() + static_cast<size_t>(index - 1) * MAX_BLOCK_FRAMES;
+    }
+};
+
+class VoiceCompiler {
+public:
+    static VoiceProgram compile(SoundGenerator* root) {
+        VoiceCompiler compiler;
+        compiler.emit(root, compiler.newBuffer());
+        compiler.assignBuffers();
+        compiler.program.allocateScratch();
+        return std::move(compiler.program);
+    }
+
+private:
+    VoiceProgram program;
+    int virtualBufferCount = 0;
+
+    int newBuffer() { return virtualBufferCount++; }
+
+    size_t emitOp(VoiceInstruction ins) {
+        program.instructions.push_back(ins);
+        return program.instructions.size() - 1;
+    }
+
+    // Emits ops that leave node's block in virtual buffer `dst`
+    void emit(SoundGenerator* node, int dst) {
+        if (auto* mixer = dynamic_cast<Mixer*>(node)) {
+            emitOp({VoiceOp::Clear, dst});
+            for (size_t channel = 0; channel < mixer->childGenerators.size(); ++channel) {
+                int source = newBuffer();
+                emit(mixer->childGenerators[channel].get(), source);
+                VoiceInstruction mix{VoiceOp::MixAdd, dst, source};
+                mix.gain = &mixer->volumes[channel];
+                emitOp(mix);
+            }
+        } else if (auto* adsr = dynamic_cast<ADSRGenerator*>(node)) {
+            VoiceInstruction gate{VoiceOp::EnvelopeGate, dst};
+            gate.envelope = &adsr->envelope;
+            size_t gateIndex = emitOp(gate);
+            emit(adsr->sourceGenerator.get(), dst);
+            VoiceInstruction envelope{VoiceOp::Envelope, dst};
+            envelope.envelope = &adsr->envelope;
+            emitOp(envelope);
+            // An idle envelope skips its source subtree and the envelope op itself
+            program.instructions[gateIndex].skip = program.instructions.size() - gateIndex - 1;
+        } else if (dynamic_cast<Tremolo*>(node) && node->childGenerators.size() == 1) {
+            emit(node->childGenerators[0].get(), dst);
+            VoiceInstruction tremolo{VoiceOp::Tremolo, dst};
+            tremolo.node = node;
+            emitOp(tremolo);
+        } else if (dynamic_cast<Oscillator*>(node)) {
+            VoiceInstruction oscillator{VoiceOp::Oscillator, dst};
+            oscillator.node = node;
+            emitOp(oscillator);
+        } else if (dynamic_cast<FMVoice*>(node)) {
+            VoiceInstruction fm{VoiceOp::FMVoice, dst};
+            fm.node = node;
+            emitOp(fm);
+        } else {
+            VoiceInstruction generator{VoiceOp::Generator, dst};
+            generator.node = node;
+            emitOp(generator);
+        }
+    }
+
+    // Linear-scan assignment of virtual buffers to physical scratch buffers.
+    // A virtual buffer is live from its first write to its last read; once dead
+    // its physical buffer is reused. Virtual buffer 0 is always the output.
+    void assignBuffers() {
+        const size_t count = program.instructions.size();
+        std::vector<size_t> lastUse(virtualBufferCount, 0);
+        for (size_t pc = 0; pc < count; ++pc) {
+            const auto& ins = program.instructions[pc];
+            lastUse[ins.dst] = std::max(lastUse[ins.dst], pc);
+            if (ins.op == VoiceOp::MixAdd) {
+                lastUse[ins.src] = std::max(lastUse[ins.src], pc);
+            }
+        }
+
+        std::vector<int> physical(virtualBufferCount, -1);
+        std::vector<int> freeBuffers;
+        physical[0] = 0;
+        int physicalCount = 0;
+
+        for (size_t pc = 0; pc < count; ++pc) {
+            auto& ins = program.instructions[pc];
+            if (physical[ins.dst] < 0) {
+                if (freeBuffers.empty()) {
+                    physical[ins.dst] = ++physicalCount;
+                } else {
+                    physical[ins.dst] = freeBuffers.back();
+                    freeBuffers.pop_back();
+                }
+            }
+
+            int dst = ins.dst;
+            int src = ins.src;
+            ins.dst = physical[dst];
+            if (ins.op == VoiceOp::MixAdd) {
+                ins.src = physical[src];
+                if (src != 0 && lastUse[src] == pc) {
+                    freeBuffers.push_back(physical[src]);
+                }
+            }
+            if (dst != 0 && lastUse[dst] == pc) {
+                freeBuffers.push_back(physical[dst]);
+            }
+        }
+
+        program.scratchBufferCount = physicalCount;
+    }
+};
+
+// Runs a voice through its compiled program. The original tree stays attached
+// as the only child, so parameters and noteOn/noteOff reach it unchanged.
+class CompiledVoice : public SoundGenerator {
+public:
+    CompiledVoice(std::shared_ptr<SoundGenerator> root, VoiceProgram program)
+        : program(std::move(program)) {
+        addChildGenerator(std::move(root));
+    }
+
+    void process(float* out, size_t frames, float sampleRate) override {
+        program.run(out, frames, sampleRate);
+    }
+
+private:
+    VoiceProgram program;
+};
+
+// Compiles a voice tree, returning it unchanged when there is nothing to flatten
+inline std::shared_ptr<SoundGenerator> compileVoice(std::shared_ptr<SoundGenerator> voice) {
+    VoiceProgram program = VoiceCompiler::compile(voice.get());
+    if (program.instructions.size() == 1 && program.instructions[0].op == VoiceOp::Generator) {
+        return voice;
+    }
+    return makeNode<CompiledVoice>(std::move(voice), std::move(program));
+}
@@ -4,14 +4,22 @@
 #include <memory>
 #include <string>
 #include <functional>
+#include <optional>
+#include <stdexcept>
 #include "Voices.cpp"
+#include "SimdVoices.cpp"
 
 class VoiceGeneratorRepository {
 public:
     using VoiceFactory = std::function<std::shared_ptr<SoundGenerator>(float, float)>;
 
     void addVoiceGenerator(const std::string& name, VoiceFactory factory) {
-        voiceGenerators.push_back({name, factory});
+        voiceGenerators.push_back({name, factory, std::nullopt});
+    }
+
+    // Registers a preset that SimdVoiceBank can also render; factory stays the per-voice fallback
+    void addSimdVoiceGenerator(const std::string& name, VoiceFactory factory, const SimdVoiceSpec& spec) {
+        voiceGenerators.push_back({name, factory, spec});
     }
 
     std::vector<std::string> getVoiceGeneratorNames() const {
@@ -31,10 +39,21 @@ public:
         throw std::runtime_error("Voice generator not found: " + name);
     }
 
+    // Returns nullptr when the preset has no SIMD bank equivalent
+    const SimdVoiceSpec* getSimdVoiceSpec(const std::string& name) const {
+        for (const auto& vg : voiceGenerators) {
+            if (vg.name == name) {
+                return vg.simdSpec ? &*vg.simdSpec : nullptr;
+            }
+        }
+        return nullptr;
+    }
+
 private:
     struct VoiceGeneratorEntry {
         std::string name;
         VoiceFactory factory;
+        std::optional<SimdVoiceSpec> simdSpec;
     };
 
     std::vector<VoiceGeneratorEntry> voiceGenerators;
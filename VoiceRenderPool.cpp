@@ -0,0 +1,184 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#include <immintrin.h>
+#endif
+
+// Fork-join pool for the voices of one audio block. The calling (audio)
+// thread takes part as participant 0; the pool's worker threads are
+// participants 1..N-1.
+//
+// run() splits the task indices into one contiguous range per participant.
+// Each participant claims tasks from the front of its own range with an
+// atomic counter and, once that is empty, steals from the other ranges the
+// same way. Which thread runs a task therefore varies from block to block, so
+// tasks must write to their own output and leave the mixing to the caller.
+//
+// Between blocks the workers spin for SPIN_MICROSECONDS, which covers the
+// gap to the next block while audio is running, and only then sleep on a
+// condition variable. Waking a sleeping worker takes a mutex on the calling
+// thread; that happens only after the pool has been idle.
+class VoiceRenderPool {
+public:
+    // Plain function pointer rather than std::function: run() is called on the
+    // audio thread and must not allocate
+    using TaskFunction = void (*)(void* context, size_t task);
+
+    static constexpr size_t MAX_THREADS = 64;
+    static constexpr int SPIN_MICROSECONDS = 2000;
+
+    explicit VoiceRenderPool(unsigned threads) : threadCount(std::clamp<unsigned>(threads, 1, MAX_THREADS)) {
+        ranges = std::make_unique<Range[]>(threadCount);
+        for (unsigned id = 1; id < threadCount; ++id) {
+            workers.emplace_back([this, id]() { workerLoop(id); });
+        }
+    }
+
+    ~VoiceRenderPool() {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+
+    VoiceRenderPool(const VoiceRenderPool&) = delete;
+    VoiceRenderPool& operator=(const VoiceRenderPool&) = delete;
+
+    unsigned getThreadCount() const { return threadCount; }
+
+    // Runs task(context, i) for every i in [0, count) on up to `maxParticipants`
+    // threads, the caller included, and returns once all of them are done
+    void run(size_t count, TaskFunction task, void* context, unsigned maxParticipants = MAX_THREADS) {
+        const unsigned participants = static_cast<unsigned>(
+            std::max<size_t>(1, std::min<size_t>({count, threadCount, maxParticipants})));
+        if (participants == 1) {
+            for (size_t i = 0; i < count; ++i) {
+                task(context, i);
+            }
+            return;
+        }
+
+        jobTask = task;
+        jobContext = context;
+        for (unsigned p = 0; p < participants; ++p) {
+            ranges[p].next.store(count * p / participants, std::memory_order_relaxed);
+            ranges[p].end = count * (p + 1) / participants;
+        }
+        finished.store(0, std::memory_order_relaxed);
+
+        // Epoch and participant count in one word, so a worker never pairs a
+        // new epoch with a stale count
+        epoch++;
+        job.store((epoch << PARTICIPANT_BITS) | participants, std::memory_order_seq_cst);
+        if (sleepingWorkers.load(std::memory_order_seq_cst) > 0) {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            wake.notify_all();
+        }
+
+        work(0, participants);
+        for (unsigned spins = 0; finished.load(std::memory_order_acquire) < participants - 1; ++spins) {
+            backOff(spins);
+        }
+    }
+
+private:
+    static constexpr uint64_t PARTICIPANT_BITS = 8;
+
+    // One cache line per range so claiming tasks does not bounce a line
+    // shared with another participant's counter
+    struct alignas(64) Range {
+        std::atomic<size_t> next{0};
+        size_t end = 0;
+    };
+
+    const unsigned threadCount;
+    std::unique_ptr<Range[]> ranges;
+    std::vector<std::thread> workers;
+
+    // Written by run() before the job is published
+    TaskFunction jobTask = nullptr;
+    void* jobContext = nullptr;
+    uint64_t epoch = 0;
+
+    alignas(64) std::atomic<uint64_t> job{0};
+    alignas(64) std::atomic<unsigned> finished{0}; // workers done with the current job
+
+    alignas(64) std::atomic<int> sleepingWorkers{0};
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    bool stopping = false; // guarded by sleepMutex
+
+    // Pauses the core while spinning; every 64th round yields the CPU in
+    // case the thread being waited for shares it
+    static void backOff(unsigned spins) {
+        if ((spins & 63) == 63) {
+            std::this_thread::yield();
+            return;
+        }
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+        _mm_pause();
+#else
+        std::this_thread::yield();
+#endif
+    }
+
+    void work(unsigned self, unsigned participants) {
+        for (unsigned offset = 0; offset < participants; ++offset) {
+            Range& range = ranges[(self + offset) % participants];
+            for (size_t task = range.next.fetch_add(1, std::memory_order_relaxed); task < range.end;
+                 task = range.next.fetch_add(1, std::memory_order_relaxed)) {
+                jobTask(jobContext, task);
+            }
+        }
+    }
+
+    void workerLoop(unsigned id) {
+        uint64_t seen = 0;
+        while (true) {
+            uint64_t current = waitForJob(seen);
+            if (current == seen) {
+                return; // stopping
+            }
+            seen = current;
+            const unsigned participants = static_cast<unsigned>(current & ((1u << PARTICIPANT_BITS) - 1));
+            if (id < participants) {
+                work(id, participants);
+                finished.fetch_add(1, std::memory_order_release);
+            }
+        }
+    }
+
+    // Returns the next job word, or `seen` once the pool is stopping
+    uint64_t waitForJob(uint64_t seen) {
+        const auto spinUntil = std::chrono::steady_clock::now() + std::chrono::microseconds(SPIN_MICROSECONDS);
+        for (unsigned spins = 0;; ++spins) {
+            uint64_t current = job.load(std::memory_order_acquire);
+            if (current != seen) {
+                return current;
+            }
+            if ((spins & 63) == 63 && std::chrono::steady_clock::now() > spinUntil) {
+                break;
+            }
+            backOff(spins);
+        }
+
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        sleepingWorkers.fetch_add(1, std::memory_order_seq_cst);
+        wake.wait(lock, [&]() { return stopping || job.load(std::memory_order_seq_cst) != seen; });
+        sleepingWorkers.fetch_sub(1, std::memory_order_relaxed);
+        return stopping ? seen : job.load(std::memory_order_acquire);
+    }
+};
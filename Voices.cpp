@@ -1,6 +1,8 @@
 #pragma once
 
+#include <algorithm>
 #include <vector>
+#include <array>
 #include <cmath>
 #include <memory>
 #include <random>
@@ -21,14 +23,53 @@ class Oscillator : public SoundGenerator {
 public:
     Oscillator(float frequency = 440.0f, float volume = 1.0f, Waveform waveform = Waveform::Sine)
         : frequency(frequency), volume(volume), waveform(waveform) {
-        // Randomize initial phase to prevent phase alignment issues
-        static std::random_device rd;
-        static std::mt19937 gen(rd());
-        static std::uniform_real_distribution<float> dis(0.0f, 2.0f * PI);
+        // Randomize initial phase to prevent phase alignment issues. Per
+        // thread, since voice banks may be built on several threads at once.
+        static thread_local std::random_device rd;
+        static thread_local std::mt19937 gen(rd());
+        static thread_local std::uniform_real_distribution<float> dis(0.0f, 2.0f * PI);
         phase = dis(gen);
     }
 
     float generateSample(float sampleRate) override {
+        return tick(sampleRate);
+    }
+
+    void process(float* out, size_t frames, float sampleRate) override {
+        const float increment = 2.0f * PI * frequency / sampleRate;
+
+        // Dispatch on the waveform once per block instead of once per sample
+        switch (waveform) {
+            case Waveform::Square:
+                for (size_t i = 0; i < frames; ++i) {
+                    out[i] = (std::sin(phase) >= 0.0f ? 1.0f : -1.0f) * volume;
+                    advancePhase(increment);
+                }
+                break;
+            case Waveform::Triangle:
+                for (size_t i = 0; i < frames; ++i) {
+                    out[i] = (2.0f / PI) * std::asin(std::sin(phase)) * volume;
+                    advancePhase(increment);
+                }
+                break;
+            case Waveform::Sawtooth:
+                for (size_t i = 0; i < frames; ++i) {
+                    out[i] = (2.0f / PI) * (phase - PI) * volume;
+                    advancePhase(increment);
+                }
+                break;
+            case Waveform::Sine:
+            default:
+                for (size_t i = 0; i < frames; ++i) {
+                    out[i] = std::sin(phase) * volume;
+                    advancePhase(increment);
+                }
+                break;
+        }
+    }
+
+    // Non-virtual single-sample step for owners that modulate the frequency per sample
+    inline float tick(float sampleRate) {
         float sampleValue = 0.0f;
 
         switch (waveform) {
@@ -49,13 +90,13 @@ public:
                 break;
         }
 
-        phase += 2.0f * PI * frequency / sampleRate;
-        if (phase >= 2.0f * PI)
-            phase -= 2.0f * PI;
+        advancePhase(2.0f * PI * frequency / sampleRate);
 
         return sampleValue;
     }
 
+    void retune(float ratio) override { frequency *= ratio; }
+
     void setFrequency(float freq) { frequency = freq; }
     float getFrequency() const { return frequency; }
     void setVolume(float vol) { volume = vol; }
@@ -70,34 +111,55 @@ private:
     float volume;
     float phase;
     Waveform waveform;
+
+    inline void advancePhase(float increment) {
+        phase += increment;
+        if (phase >= 2.0f * PI)
+            phase -= 2.0f * PI;
+    }
 };
 
-// Tone class adjusted to use oscillators as SoundGenerators
+// Tone class adjusted to use oscillators as SoundGenerators.
+//
+// All MAX_OSCILLATORS oscillators are built up front and only the first
+// oscillatorsPerTone of them are rendered: the "Oscillators" parameter is
+// applied on the audio thread, which must not allocate or restructure the
+// voice it is rendering.
 class Tone : public SoundGenerator {
 public:
+    static constexpr int MAX_OSCILLATORS = 10;
+
     Tone(float frequency = 440.0f, float volume = 1.0f, int oscillatorsPerTone = 3, float detuneFactor = 0.001f)
-        : frequency(frequency), volume(volume), oscillatorsPerTone(oscillatorsPerTone), detuneFactor(detuneFactor) {
-        // Add fundamental frequency oscillators
-        for (int i = 0; i < oscillatorsPerTone; ++i) {
-            float detune = (i - (oscillatorsPerTone - 1) / 2.0f) * detuneFactor;
-            auto osc = std::make_shared<Oscillator>(frequency * (1.0f + detune));
+        : frequency(frequency), volume(volume), oscillatorsPerTone(std::clamp(oscillatorsPerTone, 1, MAX_OSCILLATORS)),
+          detuneFactor(detuneFactor) {
+        for (int i = 0; i < MAX_OSCILLATORS; ++i) {
+            auto osc = makeNode<Oscillator>(frequency);
             oscillators.push_back(osc);
             addChildGenerator(osc);
         }
+        updateOscillators();
 
         // Initialize parameters
-        addParam(std::make_unique<Parameter>("Oscillators", static_cast<float>(oscillatorsPerTone), 1.0f, 10.0f, 1.0f, "",
+        addParam(std::make_unique<Parameter>("Oscillators", static_cast<float>(this->oscillatorsPerTone), 1.0f,
+            static_cast<float>(MAX_OSCILLATORS), 1.0f, "",
             [this](float value) { setOscillatorsPerTone(static_cast<int>(value)); }));
         addParam(std::make_unique<Parameter>("Detune Factor", detuneFactor, 0.0f, 0.1f, 0.0001f, "",
             [this](float value) { setDetuneFactor(value); }));
     }
 
-    float generateSample(float sampleRate) override {
-        float sample = 0.0f;
-        for (auto& osc : oscillators) {
-            sample += osc->generateSample(sampleRate);
+    void process(float* out, size_t frames, float sampleRate) override {
+        std::fill(out, out + frames, 0.0f);
+        for (int osc = 0; osc < oscillatorsPerTone; ++osc) {
+            oscillators[osc]->render(scratch.data(), frames, sampleRate);
+            for (size_t i = 0; i < frames; ++i) {
+                out[i] += scratch[i];
+            }
+        }
+
+        const float gain = volume / oscillatorsPerTone;
+        for (size_t i = 0; i < frames; ++i) {
+            out[i] *= gain;
         }
-        return sample * volume / oscillators.size();
     }
 
     void setFrequency(float freq) {
@@ -105,19 +167,22 @@ public:
         updateOscillators();
     }
 
+    // Keeps the existing oscillators (and their phases), unlike setFrequency
+    void retune(float ratio) override {
+        frequency *= ratio;
+        SoundGenerator::retune(ratio);
+    }
+
     void setVolume(float vol) { volume = vol; }
 
     void setOscillatorsPerTone(int count) {
-        oscillatorsPerTone = count;
+        oscillatorsPerTone = std::clamp(count, 1, MAX_OSCILLATORS);
         updateOscillators();
     }
 
     void setDetuneFactor(float factor) {
         detuneFactor = factor;
-        for (long long unsigned int i = 0; i < oscillators.size(); ++i) {
-            float detune = (i - (oscillators.size() - 1) / 2.0f) * detuneFactor;
-            oscillators[i]->setFrequency(frequency * (1.0f + detune));
-        }
+        updateOscillators();
     }
 
 private:
@@ -126,15 +191,14 @@ private:
     int oscillatorsPerTone;
     float detuneFactor;
     std::vector<std::shared_ptr<Oscillator>> oscillators;
+    std::array<float, MAX_BLOCK_FRAMES> scratch;
 
+    // Spreads the active oscillators evenly around the tone's frequency; the
+    // idle ones are retuned here when they become active
     void updateOscillators() {
-        oscillators.clear();
-        childGenerators.clear();
         for (int i = 0; i < oscillatorsPerTone; ++i) {
             float detune = (i - (oscillatorsPerTone - 1) / 2.0f) * detuneFactor;
-            auto osc = std::make_shared<Oscillator>(frequency * (1.0f + detune));
-            oscillators.push_back(osc);
-            addChildGenerator(osc);
+            oscillators[i]->setFrequency(frequency * (1.0f + detune));
         }
     }
 };
@@ -149,12 +213,27 @@ public:
             [this](float value) { setDetuneFactor(value); }));
     }
 
-    float generateSample(float sampleRate) override {
-        float sample = 0.0f;
+    void process(float* out, size_t frames, float sampleRate) override {
+        std::fill(out, out + frames, 0.0f);
+        for (auto& tone : tones) {
+            tone->render(scratch.data(), frames, sampleRate);
+            for (size_t i = 0; i < frames; ++i) {
+                out[i] += scratch[i];
+            }
+        }
+
+        const float normalization = 1.0f / std::sqrt(static_cast<float>(tones.size()));
+        for (size_t i = 0; i < frames; ++i) {
+            out[i] = std::tanh(out[i] * normalization);
+        }
+    }
+
+    // The harmonic tones are not child generators, so retune them all here
+    void retune(float ratio) override {
+        frequency *= ratio;
         for (auto& tone : tones) {
-            sample += tone->generateSample(sampleRate);
+            tone->retune(ratio);
         }
-        return std::tanh(sample/std::sqrt(tones.size()));
     }
 
 private:
@@ -162,10 +241,11 @@ private:
     float volume;
     float detuneFactor;
     std::vector<std::shared_ptr<Tone>> tones;
+    std::array<float, MAX_BLOCK_FRAMES> scratch;
 
     void initializeTones() {
         // Add the main tone
-        auto mainTone = std::make_shared<Tone>(frequency, volume);
+        auto mainTone = makeNode<Tone>(frequency, volume);
         tones.push_back(mainTone);
         addChildGenerator(mainTone);
 
@@ -178,7 +258,7 @@ private:
     }
 
     void addHarmonicTone(float freqMultiplier, float volMultiplier) {
-        auto tone = std::make_shared<Tone>(frequency * freqMultiplier, volume * volMultiplier);
+        auto tone = makeNode<Tone>(frequency * freqMultiplier, volume * volMultiplier);
         tones.push_back(tone);
         //addChildGenerator(tone);
     }
@@ -215,14 +295,23 @@ public:
 
     }
 
-    float generateSample(float sampleRate) override {
-        float modulatorSample = modulatorOscillator.generateSample(sampleRate);
-        float selfModulatedFrequency = modulatorFrequency + selfModulationIndex * modulatorSample * modulatorFrequency;
-        modulatorOscillator.setFrequency(selfModulatedFrequency);
+    void process(float* out, size_t frames, float sampleRate) override {
+        // The modulator retunes both oscillators every sample, so this stays a
+        // per-sample loop, but over non-virtual inlined oscillator steps
+        for (size_t i = 0; i < frames; ++i) {
+            float modulatorSample = modulatorOscillator.tick(sampleRate);
+            float selfModulatedFrequency = modulatorFrequency + selfModulationIndex * modulatorSample * modulatorFrequency;
+            modulatorOscillator.setFrequency(selfModulatedFrequency);
+
+            float modulatedFrequency = carrierFrequency + modulationIndex * modulatorSample * carrierFrequency;
+            carrierOscillator.setFrequency(modulatedFrequency);
+            out[i] = carrierOscillator.tick(sampleRate);
+        }
+    }
 
-        float modulatedFrequency = carrierFrequency + modulationIndex * modulatorSample * carrierFrequency;
-        carrierOscillator.setFrequency(modulatedFrequency);
-        return carrierOscillator.generateSample(sampleRate);
+    void retune(float ratio) override {
+        carrierFrequency *= ratio;
+        modulatorFrequency *= ratio;
     }
 
 private:
@@ -0,0 +1,204 @@
+#pragma once
+
+#ifdef _WIN32
+
+#include <windows.h>
+#include <mmdeviceapi.h>
+#include <audioclient.h>
+#include <iostream>
+#include "AudioBackend.cpp"
+
+// Shared-mode WASAPI output on the default render endpoint. The requested
+// rate and channel count are handed to the audio engine, which converts them
+// to the device mix format (AUTOCONVERTPCM).
+class WasapiAudioBackend : public AudioBackend {
+public:
+    ~WasapiAudioBackend() override {
+        close();
+    }
+
+    const char* getName() const override { return "wasapi"; }
+
+    bool open(const AudioStreamConfig& requested) override {
+        setConfig(requested);
+
+        HRESULT hr = CoInitializeEx(nullptr, COINIT_MULTITHREADED | COINIT_DISABLE_OLE1DDE);
+        if (FAILED(hr)) {
+            std::cerr << "Failed to initialize COM library." << std::endl;
+            return false;
+        }
+        comInitialized = true;
+
+        hr = CoCreateInstance(__uuidof(MMDeviceEnumerator), NULL, CLSCTX_ALL, __uuidof(IMMDeviceEnumerator), (void**)&enumerator);
+        if (FAILED(hr)) {
+            std::cerr << "Failed to create MMDeviceEnumerator instance." << std::endl;
+            return false;
+        }
+
+        hr = enumerator->GetDefaultAudioEndpoint(eRender, eConsole, &endpoint);
+        if (FAILED(hr)) {
+            std::cerr << "Failed to get default audio endpoint." << std::endl;
+            return false;
+        }
+
+        hr = endpoint->Activate(__uuidof(IAudioClient), CLSCTX_ALL, NULL, (void**)&audioClient);
+        if (FAILED(hr)) {
+            std::cerr << "Failed to activate audio client." << std::endl;
+            return false;
+        }
+
+        WAVEFORMATEX* mixFormat = nullptr;
+        hr = audioClient->GetMixFormat(&mixFormat);
+        if (FAILED(hr)) {
+            std::cerr << "Failed to get mix format." << std::endl;
+            return false;
+        }
+        printMixFormat(mixFormat);
+        CoTaskMemFree(mixFormat);
+
+        WAVEFORMATEX format = {};
+        format.wFormatTag = WAVE_FORMAT_IEEE_FLOAT;
+        format.nChannels = static_cast<WORD>(config.channels);
+        format.nSamplesPerSec = static_cast<DWORD>(config.sampleRate);
+        format.wBitsPerSample = sizeof(float) * 8;
+        format.nBlockAlign = static_cast<WORD>(config.channels * sizeof(float));
+        format.nAvgBytesPerSec = format.nSamplesPerSec * format.nBlockAlign;
+        format.cbSize = 0;
+
+        REFERENCE_TIME defaultDevicePeriod = 0;
+        REFERENCE_TIME minDevicePeriod = 0;
+        hr = audioClient->GetDevicePeriod(&defaultDevicePeriod, &minDevicePeriod);
+        if (FAILED(hr)) {
+            std::cerr << "Failed to get device period." << std::endl;
+            return false;
+        }
+
+        hr = audioClient->Initialize(
+            AUDCLNT_SHAREMODE_SHARED,
+            AUDCLNT_STREAMFLAGS_AUTOCONVERTPCM,
+            defaultDevicePeriod,
+            0,
+            &format,
+            0
+        );
+        if (FAILED(hr)) {
+            std::cerr << "Failed to initialize audio client." << std::endl;
+            return false;
+        }
+
+        hr = audioClient->GetService(__uuidof(IAudioRenderClient), (void**)&renderClient);
+        if (FAILED(hr)) {
+            std::cerr << "Failed to get render client service." << std::endl;
+            return false;
+        }
+
+        hr = audioClient->GetBufferSize(&bufferSampleCount);
+        if (FAILED(hr)) {
+            std::cerr << "Failed to get buffer size." << std::endl;
+            return false;
+        }
+        std::cout << "Buffer size: " << bufferSampleCount << std::endl;
+
+        hr = audioClient->Start();
+        if (FAILED(hr)) {
+            std::cerr << "Failed to start audio stream." << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    void run(const RenderCallback& render) override {
+        bool primed = false;
+        while (!stopRequested) {
+            UINT32 paddingSampleCount;
+            HRESULT hr = audioClient->GetCurrentPadding(&paddingSampleCount);
+            if (FAILED(hr)) {
+                std::cerr << "Failed to get current padding." << std::endl;
+                break;
+            }
+
+            UINT32 availableSamples = bufferSampleCount - paddingSampleCount;
+
+            // An empty buffer after the first fill means the device ran dry
+            if (primed && paddingSampleCount == 0) {
+                underruns.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            BYTE* buffer;
+            hr = renderClient->GetBuffer(availableSamples, &buffer);
+            if (SUCCEEDED(hr)) {
+                float* floatBuffer = reinterpret_cast<float*>(buffer);
+
+                // Render the whole device period in blocks of at most blockFrames
+                for (UINT32 offset = 0; offset < availableSamples; offset += static_cast<UINT32>(config.blockFrames)) {
+                    size_t frames = std::min<size_t>(config.blockFrames, availableSamples - offset);
+                    render(floatBuffer + static_cast<size_t>(offset) * config.channels, frames, config.channels);
+                }
+
+                hr = renderClient->ReleaseBuffer(availableSamples, 0);
+                if (FAILED(hr)) {
+                    std::cerr << "Failed to release buffer." << std::endl;
+                    break;
+                }
+
+                // Allow other threads to run
+                Sleep(0);
+            }
+            else {
+                skippedBuffers.fetch_add(1, std::memory_order_relaxed); // no console I/O on the audio thread
+                Sleep(0);
+            }
+
+            primed = true;
+        }
+    }
+
+    // The shared-mode buffer the engine keeps filled
+    size_t getLatencyFrames() const override { return bufferSampleCount; }
+
+private:
+    bool comInitialized = false;
+    IMMDeviceEnumerator* enumerator = nullptr;
+    IMMDevice* endpoint = nullptr;
+    IAudioClient* audioClient = nullptr;
+    IAudioRenderClient* renderClient = nullptr;
+    UINT32 bufferSampleCount = 0;
+
+    void close() {
+        if (audioClient) {
+            audioClient->Stop();
+        }
+        if (renderClient) {
+            renderClient->Release();
+            renderClient = nullptr;
+        }
+        if (audioClient) {
+            audioClient->Release();
+            audioClient = nullptr;
+        }
+        if (endpoint) {
+            endpoint->Release();
+            endpoint = nullptr;
+        }
+        if (enumerator) {
+            enumerator->Release();
+            enumerator = nullptr;
+        }
+        if (comInitialized) {
+            CoUninitialize();
+            comInitialized = false;
+        }
+    }
+
+    static void printMixFormat(const WAVEFORMATEX* mixFormat) {
+        std::cout << "Audio Format:" << std::endl;
+        std::cout << "  Format Tag: " << mixFormat->wFormatTag << std::endl;
+        std::cout << "  Channels: " << mixFormat->nChannels << std::endl;
+        std::cout << "  Samples per Second: " << mixFormat->nSamplesPerSec << std::endl;
+        std::cout << "  Bits per Sample: " << mixFormat->wBitsPerSample << std::endl;
+        std::cout << "  Block Align: " << mixFormat->nBlockAlign << std::endl;
+        std::cout << "  Average Bytes per Second: " << mixFormat->nAvgBytesPerSec << std::endl;
+    }
+};
+
+#endif // _WIN32
@@ -0,0 +1,412 @@
+#include "WebSocketServer.h"
+#include <iostream>
+#include <sstream>
+#include <algorithm>
+#include <array>
+#include <cctype>
+
+namespace {
+
+const char* const WEBSOCKET_GUID = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+enum Opcode : uint8_t {
+    OPCODE_CONTINUATION = 0x0,
+    OPCODE_TEXT = 0x1,
+    OPCODE_BINARY = 0x2,
+    OPCODE_CLOSE = 0x8,
+    OPCODE_PING = 0x9,
+    OPCODE_PONG = 0xA
+};
+
+// SHA-1 (FIPS 180-4); only used for the handshake
+std::array<uint8_t, 20> sha1(const std::string& input) {
+    uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+    std::string data = input;
+    const uint64_t bitLength = static_cast<uint64_t>(input.size()) * 8;
+    data += static_cast<char>(0x80);
+    while (data.size() % 64 != 56) {
+        data += '\0';
+    }
+    for (int i = 7; i >= 0; --i) {
+        data += static_cast<char>((bitLength >> (8 * i)) & 0xff);
+    }
+
+    auto rotl = [](uint32_t value, int bits) { return (value << bits) | (value >> (32 - bits)); };
+    for (size_t chunk = 0; chunk < data.size(); chunk += 64) {
+        uint32_t w[80];
+        for (int i = 0; i < 16; ++i) {
+            w[i] = (static_cast<uint32_t>(static_cast<uint8_t>(data[chunk + 4 * i])) << 24)
+                 | (static_cast<uint32_t>(static_cast<uint8_t>(data[chunk + 4 * i + 1])) << 16)
+                 | (static_cast<uint32_t>(static_cast<uint8_t>(data[chunk + 4 * i + 2])) << 8)
+                 | static_cast<uint32_t>(static_cast<uint8_t>(data[chunk + 4 * i + 3]));
+        }
+        for (int i = 16; i < 80; ++i) {
+            w[i] = rotl(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+        }
+
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+        for (int i = 0; i < 80; ++i) {
+            uint32_t f, k;
+            if (i < 20) {
+                f = (b & c) | (~b & d);
+                k = 0x5A827999;
+            } else if (i < 40) {
+                f = b ^ c ^ d;
+                k = 0x6ED9EBA1;
+            } else if (i < 60) {
+                f = (b & c) | (b & d) | (c & d);
+                k = 0x8F1BBCDC;
+            } else {
+                f = b ^ c ^ d;
+                k = 0xCA62C1D6;
+            }
+            const uint32_t temp = rotl(a, 5) + f + e + k + w[i];
+            e = d;
+            d = c;
+            c = rotl(b, 30);
+            b = a;
+            a = temp;
+        }
+        h[0] += a;
+        h[1] += b;
+        h[2] += c;
+        h[3] += d;
+        h[4] += e;
+    }
+
+    std::array<uint8_t, 20> digest;
+    for (int i = 0; i < 20; ++i) {
+        digest[i] = static_cast<uint8_t>(h[i / 4] >> (24 - 8 * (i % 4)));
+    }
+    return digest;
+}
+
+std::string base64(const uint8_t* data, size_t length) {
+    static const char* alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string encoded;
+    for (size_t i = 0; i < length; i += 3) {
+        uint32_t group = static_cast<uint32_t>(data[i]) << 16;
+        if (i + 1 < length) group |= static_cast<uint32_t>(data[i + 1]) << 8;
+        if (i + 2 < length) group |= data[i + 2];
+        encoded += alphabet[(group >> 18) & 63];
+        encoded += alphabet[(group >> 12) & 63];
+        encoded += i + 1 < length ? alphabet[(group >> 6) & 63] : '=';
+        encoded += i + 2 < length ? alphabet[group & 63] : '=';
+    }
+    return encoded;
+}
+
+std::string toLower(std::string text) {
+    std::transform(text.begin(), text.end(), text.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return text;
+}
+
+} // namespace
+
+WebSocketServer::WebSocketServer() {
+}
+
+WebSocketServer::~WebSocketServer() {
+    stop();
+}
+
+void WebSocketServer::stop() {
+    std::vector<std::shared_ptr<Client>> closing;
+    {
+        std::lock_guard<std::mutex> lock(clientsMutex);
+        closing.swap(clients);
+    }
+    for (const auto& client : closing) {
+        client->connection.close();
+    }
+}
+
+void WebSocketServer::setParameterCallback(ParameterCallback callback) {
+    parameterCallback = callback;
+}
+
+void WebSocketServer::setNoteCallback(NoteCallback callback) {
+    noteCallback = callback;
+}
+
+void WebSocketServer::setVoiceChangeCallback(VoiceChangeCallback callback) {
+    voiceChangeCallback = callback;
+}
+
+void WebSocketServer::setSubscribeCallback(SubscribeCallback callback) {
+    subscribeCallback = callback;
+}
+
+std::string WebSocketServer::computeAcceptKey(const std::string& key) {
+    const std::array<uint8_t, 20> digest = sha1(key + WEBSOCKET_GUID);
+    return base64(digest.data(), digest.size());
+}
+
+bool WebSocketServer::upgrade(const HTTPConnection& connection, const HTTPRequest& request) {
+    const std::string key(request.header("Sec-WebSocket-Key"));
+    if (key.empty() || toLower(std::string(request.header("Upgrade"))) != "websocket"
+        || request.header("Sec-WebSocket-Version") != "13") {
+        std::string response;
+        appendResponseHead(response, 400, "", 0, connection.keepAlive(), "Sec-WebSocket-Version: 13\r\n");
+        connection.send(std::move(response));
+        return false;
+    }
+
+    if (!connection.send("HTTP/1.1 101 Switching Protocols\r\n"
+                         "Upgrade: websocket\r\n"
+                         "Connection: Upgrade\r\n"
+                         "Sec-WebSocket-Accept: " + computeAcceptKey(key) + "\r\n"
+                         "\r\n")) {
+        return false;
+    }
+
+    auto client = std::make_shared<Client>();
+    client->connection = connection;
+    {
+        std::lock_guard<std::mutex> lock(clientsMutex);
+        client->id = nextClientId++;
+        clients.push_back(client);
+        std::cout << "WebSocket client connected. Total clients: " << clients.size() << std::endl;
+    }
+    // The handlers hold the client, not the server's list; both are dropped when the connection closes
+    connection.setDataHandler([this, client](const std::string& data) {
+        return readFrames(*client, data);
+    });
+    connection.setCloseHandler([this, client]() {
+        removeClient(client);
+    });
+    return true;
+}
+
+void WebSocketServer::sendText(ClientId id, const std::string& message) {
+    auto client = findClient(id);
+    if (client && !sendFrame(*client, OPCODE_TEXT, message)) {
+        removeClient(client);
+    }
+}
+
+void WebSocketServer::broadcast(const std::string& topic, const std::string& message, ClientId except) {
+    std::vector<std::shared_ptr<Client>> targets;
+    {
+        std::lock_guard<std::mutex> lock(clientsMutex);
+        for (const auto& client : clients) {
+            if (client->id != except && client->topics.count(topic)) {
+                targets.push_back(client);
+            }
+        }
+    }
+    for (const auto& client : targets) {
+        if (!sendFrame(*client, OPCODE_TEXT, message)) {
+            removeClient(client);
+        }
+    }
+}
+
+bool WebSocketServer::sendFrame(Client& client, uint8_t opcode, const std::string& payload) {
+    // Server frames are never masked or fragmented
+    std::string frame;
+    frame.reserve(payload.size() + 10);
+    frame += static_cast<char>(0x80 | opcode);
+    if (payload.size() < 126) {
+        frame += static_cast<char>(payload.size());
+    } else if (payload.size() <= 0xffff) {
+        frame += static_cast<char>(126);
+        frame += static_cast<char>((payload.size() >> 8) & 0xff);
+        frame += static_cast<char>(payload.size() & 0xff);
+    } else {
+        frame += static_cast<char>(127);
+        for (int i = 7; i >= 0; --i) {
+            frame += static_cast<char>((static_cast<uint64_t>(payload.size()) >> (8 * i)) & 0xff);
+        }
+    }
+    frame += payload;
+
+    // Queued whole, so frames sent from different threads never interleave
+    return client.connection.send(std::move(frame));
+}
+
+void WebSocketServer::removeClient(const std::shared_ptr<Client>& client) {
+    {
+        std::lock_guard<std::mutex> lock(clientsMutex);
+        auto it = std::find(clients.begin(), clients.end(), client);
+        if (it == clients.end()) {
+            return;
+        }
+        clients.erase(it);
+        std::cout << "WebSocket client disconnected. Total clients: " << clients.size() << std::endl;
+    }
+    client->connection.close();
+}
+
+std::shared_ptr<WebSocketServer::Client> WebSocketServer::findClient(ClientId id) {
+    std::lock_guard<std::mutex> lock(clientsMutex);
+    for (const auto& client : clients) {
+        if (client->id == id) {
+            return client;
+        }
+    }
+    return nullptr;
+}
+
+// Parses every complete frame received so far; false once the connection should close
+bool WebSocketServer::readFrames(Client& client, const std::string& data) {
+    std::string& input = client.input;
+    input += data;
+    size_t offset = 0;
+    while (input.size() - offset >= 2) {
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(input.data()) + offset;
+        const size_t available = input.size() - offset;
+        const bool fin = (bytes[0] & 0x80) != 0;
+        const uint8_t opcode = bytes[0] & 0x0f;
+        const bool masked = (bytes[1] & 0x80) != 0;
+        uint64_t length = bytes[1] & 0x7f;
+        size_t header = 2;
+        if (length == 126) {
+            if (available < 4) break;
+            length = (static_cast<uint64_t>(bytes[2]) << 8) | bytes[3];
+            header = 4;
+        } else if (length == 127) {
+            if (available < 10) break;
+            length = 0;
+            for (int i = 0; i < 8; ++i) {
+                length = (length << 8) | bytes[2 + i];
+            }
+            header = 10;
+        }
+        if (!masked || length > MAX_MESSAGE_BYTES) {
+            // Clients must mask (RFC 6455 5.1); oversized messages are refused
+            sendFrame(client, OPCODE_CLOSE, std::string(masked ? "\x03\xf1" : "\x03\xea", 2));
+            return false;
+        }
+        if (available < header + 4 + length) {
+            break;
+        }
+
+        const uint8_t* mask = bytes + header;
+        std::string payload(reinterpret_cast<const char*>(bytes + header + 4), static_cast<size_t>(length));
+        for (size_t i = 0; i < payload.size(); ++i) {
+            payload[i] = static_cast<char>(payload[i] ^ mask[i % 4]);
+        }
+        offset += header + 4 + static_cast<size_t>(length);
+
+        switch (opcode) {
+            case OPCODE_TEXT:
+            case OPCODE_BINARY:
+            case OPCODE_CONTINUATION:
+                if (opcode != OPCODE_CONTINUATION) {
+                    client.message.clear();
+                }
+                client.message += payload;
+                if (client.message.size() > MAX_MESSAGE_BYTES) {
+                    sendFrame(client, OPCODE_CLOSE, std::string("\x03\xf1", 2));
+                    return false;
+                }
+                if (fin) {
+                    handleMessage(client, client.message);
+                    client.message.clear();
+                }
+                break;
+            case OPCODE_CLOSE:
+                sendFrame(client, OPCODE_CLOSE, payload.substr(0, 2));
+                return false;
+            case OPCODE_PING:
+                if (!sendFrame(client, OPCODE_PONG, payload)) {
+                    return false;
+                }
+                break;
+            case OPCODE_PONG:
+                break;
+            default:
+                sendFrame(client, OPCODE_CLOSE, std::string("\x03\xea", 2));
+                return false;
+        }
+    }
+    input.erase(0, offset);
+    return true;
+}
+
+void WebSocketServer::handleMessage(Client& client, const std::string& message) {
+    std::vector<std::pair<std::string, float>> parameters;
+    std::istringstream lines(message);
+    std::string line;
+    while (std::getline(lines, line)) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        std::istringstream words(line);
+        std::string command;
+        if (!(words >> command)) {
+            continue;
+        }
+
+        if (command == "p") {
+            float value;
+            std::string name;
+            if (words >> value && std::getline(words >> std::ws, name) && !name.empty()) {
+                parameters.emplace_back(name, value);
+            }
+        } else if (command == "+" || command == "-") {
+            int note;
+            if (!(words >> note) || note < 0 || note >= 128) {
+                sendError(client, "note must be 0..127: " + line);
+                continue;
+            }
+            float velocity = 0.8f;
+            if (command == "+" && !(words >> std::ws).eof()
+                && (!(words >> velocity) || !(words >> std::ws).eof() || velocity < 0.0f || velocity > 1.0f)) {
+                sendError(client, "velocity must be 0..1: " + line);
+                continue;
+            }
+            if (noteCallback) {
+                noteCallback(note, velocity, command == "+");
+            }
+        } else if (command == "v") {
+            std::string name;
+            if (std::getline(words >> std::ws, name) && !name.empty() && voiceChangeCallback) {
+                voiceChangeCallback(name);
+            }
+        } else if (command == "s" || command == "u") {
+            std::vector<std::string> added;
+            {
+                std::lock_guard<std::mutex> lock(clientsMutex);
+                for (std::string topic; words >> topic;) {
+                    if (command == "u") {
+                        client.topics.erase(topic);
+                    } else if (client.topics.insert(topic).second) {
+                        added.push_back(topic);
+                    }
+                }
+            }
+            for (const auto& topic : added) {
+                if (subscribeCallback) {
+                    subscribeCallback(client.id, topic);
+                }
+            }
+        } else {
+            std::cerr << "WebSocket: unknown command '" << command << "'" << std::endl;
+        }
+    }
+
+    // Applying part of the message would break its one-block promise
+    if (parameters.size() > MAX_PARAMETERS_PER_MESSAGE) {
+        sendError(client, "too many parameter changes in one message: " + std::to_string(parameters.size())
+                          + " (at most " + std::to_string(MAX_PARAMETERS_PER_MESSAGE) + ")");
+        return;
+    }
+    if (!parameters.empty() && parameterCallback) {
+        parameterCallback(client.id, parameters);
+    }
+}
+
+void WebSocketServer::sendError(Client& client, const std::string& error) {
+    std::cerr << "WebSocket: " << error << std::endl;
+    std::string escaped;
+    for (char c : error) {
+        if (c == '"' || c == '\\') {
+            escaped += '\\';
+        }
+        escaped += static_cast<unsigned char>(c) < 0x20 ? ' ' : c;
+    }
+    sendFrame(client, OPCODE_TEXT, "{\"type\":\"error\",\"error\":\"" + escaped + "\"}");
+}
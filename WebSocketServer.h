@@ -0,0 +1,91 @@
+#pragma once
+
+#include "StaticServer.h"
+
+#include <string>
+#include <vector>
+#include <set>
+#include <mutex>
+#include <memory>
+#include <cstdint>
+#include <functional>
+
+// Persistent control channel at /ws (RFC 6455). StaticServer hands the
+// upgrade request over; afterwards its event loop delivers each client's
+// bytes to a worker, one batch at a time, and queues the frames sent back.
+//
+// Messages are short text lines, several per message allowed:
+//   client -> server
+//     p <value> <name>   set a parameter; all of a message's p lines land in the same audio block,
+//                        so a message may carry at most MAX_PARAMETERS_PER_MESSAGE of them
+//     + <note> [velocity] note on (velocity 0..1, defaults to 0.8)
+//     - <note>           note off
+//     v <name>           switch the voice generator
+//     s <topic>...       subscribe to params, voices or stats
+//     u <topic>...       unsubscribe
+//   server -> client
+//     p <value> <name>   a parameter changed (not echoed to the client that set it)
+//     {...}              the JSON messages of /events (all_params, all_voices,
+//                        voice_generator_change, audio_stats), and
+//                        {"type":"error","error":"..."} for a rejected line or message
+// Subscribing to params or voices first sends the current state.
+class WebSocketServer {
+public:
+    using ClientId = uint64_t;
+    static constexpr ClientId NO_CLIENT = 0;
+    // One ParameterChangeBatch (ParameterChangeBatch::MAX_CHANGES; handlers.cpp checks they agree)
+    static constexpr size_t MAX_PARAMETERS_PER_MESSAGE = 32;
+
+    using ParameterCallback = std::function<void(ClientId, const std::vector<std::pair<std::string, float>>&)>;
+    using NoteCallback = std::function<void(int note, float velocity, bool on)>;
+    using VoiceChangeCallback = std::function<void(const std::string&)>;
+    using SubscribeCallback = std::function<void(ClientId, const std::string& topic)>;
+
+    WebSocketServer();
+    ~WebSocketServer();
+
+    // Closes every connection
+    void stop();
+
+    void setParameterCallback(ParameterCallback callback);
+    void setNoteCallback(NoteCallback callback);
+    void setVoiceChangeCallback(VoiceChangeCallback callback);
+    void setSubscribeCallback(SubscribeCallback callback);
+
+    // Answers a GET /ws request; on success the connection stays open as a WebSocket
+    bool upgrade(const HTTPConnection& connection, const HTTPRequest& request);
+
+    void sendText(ClientId client, const std::string& message);
+    // Sends to every client subscribed to topic, except `except`
+    void broadcast(const std::string& topic, const std::string& message, ClientId except = NO_CLIENT);
+
+    // Sec-WebSocket-Accept for a Sec-WebSocket-Key
+    static std::string computeAcceptKey(const std::string& key);
+
+private:
+    static constexpr size_t MAX_MESSAGE_BYTES = 1 << 20;
+
+    struct Client {
+        ClientId id;
+        HTTPConnection connection;
+        std::set<std::string> topics; // guarded by clientsMutex
+        std::string input;            // data handler only: bytes not yet parsed
+        std::string message;          // data handler only: fragments of the current message
+    };
+
+    std::vector<std::shared_ptr<Client>> clients;
+    std::mutex clientsMutex;
+    ClientId nextClientId = 1;
+
+    ParameterCallback parameterCallback;
+    NoteCallback noteCallback;
+    VoiceChangeCallback voiceChangeCallback;
+    SubscribeCallback subscribeCallback;
+
+    bool readFrames(Client& client, const std::string& data);
+    void handleMessage(Client& client, const std::string& message);
+    void sendError(Client& client, const std::string& error);
+    bool sendFrame(Client& client, uint8_t opcode, const std::string& payload);
+    void removeClient(const std::shared_ptr<Client>& client);
+    std::shared_ptr<Client> findClient(ClientId id);
+};
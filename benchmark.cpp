@@ -0,0 +1,606 @@
+// Offline DSP benchmarks. Builds without any audio device or Windows API:
+//     g++ -std=c++17 -O2 -I. benchmark.cpp -o bin/benchmark -pthread
+// Add -mavx2 for the 8-lane SIMD voice bank (AVX CPUs only, see SimdVoices.cpp).
+#include <array>
+#include <unordered_map>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <random>
+#include <fstream>
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+#include "Effects.cpp"
+#include "SoundGenerator.cpp"
+#include "Parameter.cpp"
+#include "Voices.cpp"
+#include "ADSRGenerator.cpp"
+#include "ActiveTones.cpp"
+#include "math.cpp"
+#include "VoiceGeneratorRepository.cpp"
+#include "mixer.cpp"
+#include "presets.cpp"
+#include "HTTPParser.cpp"
+
+#define BENCH_SAMPLE_RATE 44100
+#define BENCH_BLOCK_FRAMES 256
+
+// Silences std::cout while in scope; ActiveTones logs every note and parameter.
+// The sink keeps no state, so the builder and producer threads may log at once.
+class QuietCout {
+public:
+    QuietCout() : previous(std::cout.rdbuf(&sink)) {}
+    ~QuietCout() { std::cout.rdbuf(previous); }
+private:
+    struct NullBuffer : std::streambuf {
+        int overflow(int c) override { return traits_type::not_eof(c); }
+    };
+    NullBuffer sink;
+    std::streambuf* previous;
+};
+
+// Renders `seconds` of audio with `notes` held and returns nanoseconds per output sample
+double measureNsPerSample(const VoiceGeneratorRepository::VoiceFactory& factory, int notes, float seconds,
+                          const SimdVoiceSpec* simdSpec = nullptr, unsigned renderThreads = 1) {
+    std::shared_ptr<ActiveTones> activeTones;
+    {
+        QuietCout quiet;
+        activeTones = std::make_shared<ActiveTones>(factory);
+        if (simdSpec) {
+            activeTones->setSimdVoiceGenerator(*simdSpec);
+        }
+        // Rebuild up front if the pool is too small, rather than in the background mid-run
+        activeTones->setMaxPolyphony(notes);
+        if (!simdSpec && activeTones->getPoolCapacity() < notes) {
+            activeTones->setVoiceGenerator(factory);
+        }
+        activeTones->setRenderThreads(renderThreads);
+        for (int i = 0; i < notes; ++i) {
+            activeTones->noteOn(i % MIDI_NOTE_COUNT, 0, 0.0f, 0.8f);
+        }
+    }
+
+    std::array<float, BENCH_BLOCK_FRAMES> block;
+    const size_t totalFrames = static_cast<size_t>(seconds * BENCH_SAMPLE_RATE);
+    auto start = std::chrono::steady_clock::now();
+    for (size_t rendered = 0; rendered < totalFrames; rendered += BENCH_BLOCK_FRAMES) {
+        activeTones->process(block.data(), BENCH_BLOCK_FRAMES, BENCH_SAMPLE_RATE);
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::nano>(elapsed).count() / totalFrames;
+}
+
+void printRow(const std::string& name, double staticNs, double dynamicNs) {
+    std::cout << std::left << std::setw(28) << name << std::right << std::fixed << std::setprecision(1)
+              << std::setw(12) << staticNs << std::setw(12) << dynamicNs
+              << std::setw(9) << std::setprecision(2) << dynamicNs / staticNs << "x" << std::endl;
+}
+
+// Compile-time compositions (loadPresets) against the runtime graphs (loadDynamicPresets)
+void benchmarkStaticVsDynamic(int notes, float seconds) {
+    VoiceGeneratorRepository staticRepo;
+    VoiceGeneratorRepository dynamicRepo;
+    loadPresets(staticRepo);
+    loadDynamicPresets(dynamicRepo);
+
+    std::cout << "Static vs dynamic voices, " << notes << " notes, " << seconds << " s per preset" << std::endl;
+    std::cout << std::left << std::setw(28) << "Preset" << std::right << std::setw(12) << "static ns"
+              << std::setw(12) << "dynamic ns" << std::setw(10) << "speedup" << std::endl;
+
+    for (const auto& name : staticRepo.getVoiceGeneratorNames()) {
+        double staticNs = measureNsPerSample(staticRepo.getVoiceGenerator(name), notes, seconds);
+        double dynamicNs = measureNsPerSample(dynamicRepo.getVoiceGenerator(name), notes, seconds);
+        printRow(name, staticNs, dynamicNs);
+    }
+
+    // The compositions are templated on the sample type; show the double variant as well
+    auto sineDouble = [](float frequency, float volume) {
+        return compose::makeVoice(compose::ADSR(compose::Osc<compose::Sine, double>(frequency, volume), 0.05f, 0.1f, 0.7f, 0.3f));
+    };
+    printRow("Sine Oscillator (double)", measureNsPerSample(sineDouble, notes, seconds),
+             measureNsPerSample(dynamicRepo.getVoiceGenerator("Sine Oscillator"), notes, seconds));
+}
+
+// SimdVoiceBank against the per-voice engine for the presets it covers
+void benchmarkSimdVoices(int notes, float seconds) {
+    VoiceGeneratorRepository repo;
+    loadPresets(repo);
+
+    std::cout << "SIMD voice bank (" << SimdFloat::width << " lanes) vs per-voice graphs, "
+              << notes << " notes, " << seconds << " s per preset" << std::endl;
+    std::cout << std::left << std::setw(28) << "Preset" << std::right << std::setw(12) << "simd ns"
+              << std::setw(12) << "voice ns" << std::setw(10) << "speedup" << std::endl;
+
+    for (const auto& name : repo.getVoiceGeneratorNames()) {
+        const SimdVoiceSpec* spec = repo.getSimdVoiceSpec(name);
+        if (!spec) {
+            continue;
+        }
+        double simdNs = measureNsPerSample(repo.getVoiceGenerator(name), notes, seconds, spec);
+        double voiceNs = measureNsPerSample(repo.getVoiceGenerator(name), notes, seconds);
+        printRow(name, simdNs, voiceNs);
+    }
+}
+
+// Voice bank arena footprint per preset, for both the static and dynamic graphs
+void benchmarkVoiceBankMemory() {
+    VoiceGeneratorRepository staticRepo;
+    VoiceGeneratorRepository dynamicRepo;
+    loadPresets(staticRepo);
+    loadDynamicPresets(dynamicRepo);
+
+    std::cout << "Voice bank arenas (default polyphony pool)" << std::endl;
+    std::cout << std::left << std::setw(28) << "Preset" << std::right << std::setw(10) << "graph"
+              << std::setw(10) << "allocs" << std::setw(14) << "allocs/voice" << std::setw(12) << "used KB"
+              << std::setw(12) << "reserved KB" << std::setw(8) << "chunks" << std::endl;
+
+    auto printStats = [](const std::string& name, const char* graph, const VoiceGeneratorRepository::VoiceFactory& factory) {
+        VoiceArena::Stats stats;
+        int voices = 1;
+        {
+            QuietCout quiet;
+            ActiveTones activeTones(factory);
+            stats = activeTones.getVoiceBankStats();
+            voices = std::max(activeTones.getPoolCapacity(), 1);
+        }
+        std::cout << std::left << std::setw(28) << name << std::right << std::setw(10) << graph
+                  << std::setw(10) << stats.allocations
+                  << std::setw(14) << std::fixed << std::setprecision(1) << static_cast<double>(stats.allocations) / voices
+                  << std::setw(12) << stats.bytesUsed / 1024.0 << std::setw(12) << stats.bytesReserved / 1024.0
+                  << std::setw(8) << stats.chunks << std::endl;
+    };
+    for (const auto& name : staticRepo.getVoiceGeneratorNames()) {
+        printStats(name, "static", staticRepo.getVoiceGenerator(name));
+        printStats(name, "dynamic", dynamicRepo.getVoiceGenerator(name));
+    }
+}
+
+// Voice rendering on 1..maxThreads render threads, per preset
+void benchmarkRenderThreads(int notes, float seconds, unsigned maxThreads) {
+    VoiceGeneratorRepository repo;
+    loadPresets(repo);
+
+    std::cout << "Render threads, " << notes << " notes, " << seconds << " s per run ("
+              << std::thread::hardware_concurrency() << " hardware threads)" << std::endl;
+    std::cout << std::left << std::setw(28) << "Preset" << std::right << std::setw(8) << "threads"
+              << std::setw(12) << "ns/sample" << std::setw(10) << "speedup" << std::endl;
+
+    for (const auto& name : repo.getVoiceGeneratorNames()) {
+        double serialNs = 0.0;
+        for (unsigned threads = 1; threads <= maxThreads; threads *= 2) {
+            double ns = measureNsPerSample(repo.getVoiceGenerator(name), notes, seconds, nullptr, threads);
+            if (threads == 1) {
+                serialNs = ns;
+            }
+            std::cout << std::left << std::setw(28) << (threads == 1 ? name : "") << std::right << std::setw(8) << threads
+                      << std::fixed << std::setprecision(1) << std::setw(12) << ns
+                      << std::setw(9) << std::setprecision(2) << serialNs / ns << "x" << std::endl;
+        }
+    }
+}
+
+// Result of one measurement run in its own process
+struct IsolatedRun {
+    double nsPerSample = 0.0;
+    long peakRssKb = 0;
+};
+
+// Runs measure() in a forked child so the peak RSS is that of this run
+// alone. On Windows it runs in-process and reports the process-wide peak.
+IsolatedRun runIsolated(const std::function<double()>& measure) {
+    IsolatedRun run;
+#ifdef _WIN32
+    run.nsPerSample = measure();
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        run.peakRssKb = static_cast<long>(counters.PeakWorkingSetSize / 1024);
+    }
+#else
+    int fds[2];
+    if (pipe(fds) != 0) {
+        run.nsPerSample = measure();
+        return run;
+    }
+    std::cout.flush();
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(fds[0]);
+        double ns = measure();
+        ssize_t written = write(fds[1], &ns, sizeof(ns));
+        _exit(written == sizeof(ns) ? 0 : 1);
+    }
+    close(fds[1]);
+    if (pid < 0 || read(fds[0], &run.nsPerSample, sizeof(run.nsPerSample)) != sizeof(run.nsPerSample)) {
+        run.nsPerSample = 0.0;
+    }
+    close(fds[0]);
+    if (pid > 0) {
+        int status = 0;
+        struct rusage usage = {};
+        wait4(pid, &status, 0, &usage);
+#ifdef __APPLE__
+        run.peakRssKb = usage.ru_maxrss / 1024; // bytes on macOS
+#else
+        run.peakRssKb = usage.ru_maxrss;
+#endif
+    }
+#endif
+    return run;
+}
+
+// Every preset of loadPresets at 1, 8, 32 and 128 notes, one render thread,
+// SIMD bank where the preset has one (as msound plays it). Prints a table
+// and writes the same rows as JSON to jsonPath.
+void benchmarkPresets(float seconds, const std::string& jsonPath) {
+    VoiceGeneratorRepository repo;
+    loadPresets(repo);
+    const int noteCounts[] = {1, 8, 32, 128};
+    const double nsPerSampleRealTime = 1e9 / BENCH_SAMPLE_RATE;
+
+    std::cout << "Preset throughput, " << seconds << " s per run, " << BENCH_BLOCK_FRAMES << "-frame blocks at "
+              << BENCH_SAMPLE_RATE << " Hz" << std::endl;
+    std::cout << std::left << std::setw(28) << "Preset" << std::right << std::setw(7) << "notes"
+              << std::setw(12) << "ns/sample" << std::setw(10) << "RTF" << std::setw(14) << "voices/core"
+              << std::setw(14) << "peak RSS MB" << std::endl;
+
+    std::ostringstream json;
+    json << "{\"sampleRate\":" << BENCH_SAMPLE_RATE << ",\"blockFrames\":" << BENCH_BLOCK_FRAMES
+         << ",\"seconds\":" << seconds << ",\"results\":[";
+    bool first = true;
+    for (const auto& name : repo.getVoiceGeneratorNames()) {
+        const SimdVoiceSpec* spec = repo.getSimdVoiceSpec(name);
+        for (int notes : noteCounts) {
+            IsolatedRun run = runIsolated([&]() {
+                return measureNsPerSample(repo.getVoiceGenerator(name), notes, seconds, spec);
+            });
+            // Real-time factor of this run; a core keeps up with RTF times as many voices
+            const double rtf = run.nsPerSample > 0.0 ? nsPerSampleRealTime / run.nsPerSample : 0.0;
+            const double voicesPerCore = rtf * notes;
+
+            std::cout << std::left << std::setw(28) << (notes == noteCounts[0] ? name : "") << std::right
+                      << std::setw(7) << notes << std::fixed << std::setprecision(1) << std::setw(12) << run.nsPerSample
+                      << std::setw(10) << rtf << std::setw(14) << voicesPerCore
+                      << std::setw(14) << run.peakRssKb / 1024.0 << std::endl;
+
+            json << (first ? "" : ",") << "{\"preset\":\"" << name << "\",\"engine\":\"" << (spec ? "simd" : "voice")
+                 << "\",\"notes\":" << notes << ",\"nsPerSample\":" << run.nsPerSample << ",\"realTimeFactor\":" << rtf
+                 << ",\"voicesPerCore\":" << voicesPerCore << ",\"peakRssKb\":" << run.peakRssKb << "}";
+            first = false;
+        }
+    }
+    json << "]}";
+
+    std::ofstream file(jsonPath);
+    file << json.str() << std::endl;
+    std::cout << (file ? "Wrote " : "Could not write ") << jsonPath << std::endl;
+}
+
+// Runs ActiveTones on a paced "audio" thread while producer threads flood it
+// with note events, and reports the distribution of process() times per block
+void benchmarkNoteEventJitter(int producers, float seconds) {
+    VoiceGeneratorRepository repo;
+    loadPresets(repo);
+    std::shared_ptr<ActiveTones> activeTones;
+    {
+        QuietCout quiet;
+        activeTones = std::make_shared<ActiveTones>(repo.getVoiceGenerator("FM Voice"));
+    }
+
+    std::atomic<bool> running{true};
+    std::atomic<long> pushed{0};
+    std::atomic<long> dropped{0};
+    std::vector<std::thread> producerThreads;
+    for (int p = 0; p < producers; ++p) {
+        producerThreads.emplace_back([&, p] {
+            std::mt19937 gen(p);
+            std::uniform_int_distribution<int> noteDist(24, 108);
+            while (running.load(std::memory_order_relaxed)) {
+                uint8_t note = static_cast<uint8_t>(noteDist(gen));
+                bool on = activeTones->pushNoteEvent({NoteEvent::Type::NoteOn, note, 0.8f, noteEventClock()});
+                bool off = activeTones->pushNoteEvent({NoteEvent::Type::NoteOff, note, 0.0f, noteEventClock()});
+                pushed += 2;
+                dropped += (on ? 0 : 1) + (off ? 0 : 1);
+                std::this_thread::sleep_for(std::chrono::microseconds(200));
+            }
+        });
+    }
+
+    // Pace blocks like a device callback would
+    const auto period = std::chrono::nanoseconds(static_cast<long long>(1e9 * BENCH_BLOCK_FRAMES / BENCH_SAMPLE_RATE));
+    const size_t blockCount = static_cast<size_t>(seconds * BENCH_SAMPLE_RATE / BENCH_BLOCK_FRAMES);
+    std::vector<double> blockMicros;
+    blockMicros.reserve(blockCount);
+    std::array<float, BENCH_BLOCK_FRAMES> block;
+    auto deadline = std::chrono::steady_clock::now();
+    for (size_t b = 0; b < blockCount; ++b) {
+        deadline += period;
+        auto start = std::chrono::steady_clock::now();
+        activeTones->process(block.data(), BENCH_BLOCK_FRAMES, BENCH_SAMPLE_RATE);
+        blockMicros.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count());
+        std::this_thread::sleep_until(deadline);
+    }
+
+    running = false;
+    {
+        QuietCout quiet;
+        for (auto& thread : producerThreads) {
+            thread.join();
+        }
+    }
+
+    const double budget = std::chrono::duration<double, std::micro>(period).count();
+    size_t overBudget = std::count_if(blockMicros.begin(), blockMicros.end(), [&](double us) { return us > budget; });
+    double sum = 0.0;
+    for (double us : blockMicros) {
+        sum += us;
+    }
+    std::sort(blockMicros.begin(), blockMicros.end());
+
+    std::cout << "Note event jitter, FM Voice, " << producers << " producer threads, " << seconds << " s" << std::endl;
+    std::cout << std::fixed << std::setprecision(1)
+              << "  events pushed       " << pushed.load() << " (" << dropped.load() << " dropped)" << std::endl
+              << "  blocks              " << blockMicros.size() << ", budget " << budget << " us" << std::endl
+              << "  process() us        min " << blockMicros.front()
+              << "  avg " << sum / blockMicros.size()
+              << "  p99 " << blockMicros[blockMicros.size() * 99 / 100]
+              << "  max " << blockMicros.back() << std::endl
+              << "  over budget         " << overBudget << std::endl;
+}
+
+// Switches presets every 20 ms on the background builder while control
+// threads flood the current preset's parameters and the paced "audio" thread
+// applies them, like POST /api/voice racing WebSocket "p" traffic. Meant to
+// run under -fsanitize=address or thread: replaced voice sets must outlive
+// every change queued for their parameters.
+void benchmarkPresetSwitching(int controllers, float seconds) {
+    VoiceGeneratorRepository repo;
+    loadPresets(repo);
+    const std::vector<std::string> names = repo.getVoiceGeneratorNames();
+    auto quiet = std::make_unique<QuietCout>(); // the builder logs every switch
+    auto activeTones = std::make_shared<ActiveTones>(repo.getVoiceGenerator(names.front()));
+
+    std::atomic<bool> running{true};
+    std::atomic<long> switches{0};
+    std::atomic<long> committed{0};
+    std::vector<std::thread> threads;
+    threads.emplace_back([&] {
+        for (size_t i = 1; running.load(std::memory_order_relaxed); ++i) {
+            const std::string& name = names[i % names.size()];
+            if (const SimdVoiceSpec* simdSpec = repo.getSimdVoiceSpec(name)) {
+                activeTones->setSimdVoiceGeneratorAsync(*simdSpec);
+            } else {
+                activeTones->setVoiceGeneratorAsync(repo.getVoiceGenerator(name));
+            }
+            ++switches;
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        }
+    });
+    for (int c = 0; c < controllers; ++c) {
+        threads.emplace_back([&, c] {
+            std::mt19937 gen(c);
+            std::uniform_real_distribution<float> position(0.0f, 1.0f);
+            while (running.load(std::memory_order_relaxed)) {
+                auto registry = activeTones->getParameterRegistry();
+                ParameterBatch batch;
+                for (ParameterId id = 0; id < registry->size(); ++id) {
+                    Parameter* param = registry->get(id);
+                    if (param->getName() != "Polyphony") {
+                        batch.set(*param, param->getMinValue() + position(gen) * (param->getMaxValue() - param->getMinValue()));
+                    }
+                }
+                committed += batch.commit() ? 1 : 0;
+                std::this_thread::sleep_for(std::chrono::microseconds(200));
+            }
+        });
+    }
+    // Notes keep the pools busy and draining sets alive across switches
+    threads.emplace_back([&] {
+        std::mt19937 gen(controllers);
+        std::uniform_int_distribution<int> noteDist(36, 96);
+        while (running.load(std::memory_order_relaxed)) {
+            int note = noteDist(gen);
+            activeTones->noteOn(note, 0, 440.0f, 0.8f);
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            activeTones->noteOff(note, 0);
+        }
+    });
+
+    const auto period = std::chrono::nanoseconds(static_cast<long long>(1e9 * BENCH_BLOCK_FRAMES / BENCH_SAMPLE_RATE));
+    const size_t blockCount = static_cast<size_t>(seconds * BENCH_SAMPLE_RATE / BENCH_BLOCK_FRAMES);
+    std::array<float, BENCH_BLOCK_FRAMES> block;
+    auto deadline = std::chrono::steady_clock::now();
+    for (size_t b = 0; b < blockCount; ++b) {
+        deadline += period;
+        applyParameterChanges();
+        activeTones->process(block.data(), BENCH_BLOCK_FRAMES, BENCH_SAMPLE_RATE);
+        std::this_thread::sleep_until(deadline);
+    }
+    running = false;
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    activeTones.reset();
+    quiet.reset();
+
+    std::cout << "Preset switching, " << controllers << " parameter threads, " << seconds << " s: "
+              << switches.load() << " switches, " << committed.load() << " batches committed" << std::endl;
+}
+
+// The request parser and response builder StaticServer used before
+// HTTPParser, kept here as the baseline for benchmarkHTTPParser
+std::string legacyParseHTTPRequest(const std::string& request, std::string& method, std::string& path, std::string& headers, std::string& body) {
+    std::istringstream stream(request);
+    std::string version;
+    if (!(stream >> method >> path >> version)) {
+        return "";
+    }
+    std::string line;
+    std::getline(stream, line);
+    std::ostringstream headerStream;
+    while (std::getline(stream, line) && line != "\r" && !line.empty()) {
+        headerStream << line << "\n";
+    }
+    headers = headerStream.str();
+    std::ostringstream bodyStream;
+    while (std::getline(stream, line)) {
+        bodyStream << line << "\n";
+    }
+    body = bodyStream.str();
+    if (!body.empty() && body.back() == '\n') {
+        body.pop_back();
+    }
+    return version;
+}
+
+std::string legacyResponse(int statusCode, const std::string& contentType, const std::string& body) {
+    std::ostringstream response;
+    response << "HTTP/1.1 " << statusCode << " OK\r\n";
+    response << "Content-Type: " << contentType << "\r\n";
+    response << "Content-Length: " << body.length() << "\r\n";
+    response << "Connection: close\r\n";
+    response << "\r\n";
+    response << body;
+    return response.str();
+}
+
+// Requests per second through the old istringstream parser and the
+// streaming HTTPRequestParser, each answering with a small JSON response.
+// No sockets: this is the per-request CPU cost on the worker/event loop.
+void benchmarkHTTPParser(float seconds) {
+    const std::string get =
+        "GET /api/params HTTP/1.1\r\nHost: localhost:8080\r\nUser-Agent: Mozilla/5.0 (X11; Linux x86_64)\r\n"
+        "Accept: application/json\r\nAccept-Encoding: gzip, deflate, br\r\nAccept-Language: en-US,en;q=0.9\r\n"
+        "Connection: keep-alive\r\n\r\n";
+    const std::string body = "{\"param\":\"Attack\",\"value\":0.25}";
+    const std::string post =
+        "POST /api/param HTTP/1.1\r\nHost: localhost:8080\r\nContent-Type: application/json\r\n"
+        "Content-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
+    const std::string chunked =
+        "POST /api/param HTTP/1.1\r\nHost: localhost:8080\r\nContent-Type: application/json\r\n"
+        "Transfer-Encoding: chunked\r\n\r\n10\r\n" + body.substr(0, 16) + "\r\n"
+        + [&] { std::ostringstream size; size << std::hex << body.size() - 16; return size.str(); }()
+        + "\r\n" + body.substr(16) + "\r\n0\r\n\r\n";
+    const std::string json = "{\"status\":\"ok\"}";
+    const int pipelineDepth = 16;
+
+    // Runs step (which handles `batch` requests) until `seconds` pass
+    auto requestsPerSecond = [seconds](int batch, const std::function<void()>& step) {
+        long requests = 0;
+        const auto start = std::chrono::steady_clock::now();
+        const auto end = start + std::chrono::duration<float>(seconds);
+        auto now = start;
+        while (now < end) {
+            for (int i = 0; i < 64; ++i) {
+                step();
+            }
+            requests += 64L * batch;
+            now = std::chrono::steady_clock::now();
+        }
+        return requests / std::chrono::duration<double>(now - start).count();
+    };
+
+    size_t sink = 0;
+    auto legacy = [&](const std::string& text) {
+        return requestsPerSecond(1, [&] {
+            std::string method, path, headers, requestBody;
+            legacyParseHTTPRequest(text, method, path, headers, requestBody);
+            sink += legacyResponse(200, "application/json", json).size() + requestBody.size();
+        });
+    };
+    // One buffer and parser per connection, reused for every request on it
+    HTTPRequestParser parser(1 << 20);
+    HTTPRequest request;
+    std::string buffer;
+    std::string response;
+    auto streaming = [&](const std::string& text, int depth) {
+        std::string input;
+        for (int i = 0; i < depth; ++i) {
+            input += text;
+        }
+        return requestsPerSecond(depth, [&] {
+            buffer.assign(input);
+            while (!buffer.empty()) {
+                if (parser.parse(buffer) != HTTPRequestParser::Status::Complete) {
+                    std::cerr << "HTTP benchmark request did not parse" << std::endl;
+                    std::exit(1);
+                }
+                parser.request(buffer, request);
+                response.clear();
+                appendResponseHead(response, 200, "application/json", json.size(), request.keepAlive);
+                response += json;
+                sink += response.size() + request.body.size();
+                buffer.erase(0, parser.consumed());
+                parser.reset();
+            }
+        });
+    };
+
+    std::cout << "HTTP request parsing + response head, " << seconds << " s per run, requests/s" << std::endl;
+    std::cout << std::left << std::setw(26) << "Request" << std::right << std::setw(14) << "istringstream"
+              << std::setw(14) << "streaming" << std::setw(10) << "speedup"
+              << std::setw(18) << "pipelined x" + std::to_string(pipelineDepth) << std::endl;
+    const std::pair<const char*, const std::string*> cases[] = {
+        {"GET, 7 headers", &get}, {"POST, Content-Length", &post}, {"POST, chunked", &chunked}};
+    for (const auto& [name, text] : cases) {
+        const double before = legacy(*text);
+        const double after = streaming(*text, 1);
+        const double pipelined = streaming(*text, pipelineDepth);
+        std::cout << std::left << std::setw(26) << name << std::right << std::fixed << std::setprecision(0)
+                  << std::setw(14) << before << std::setw(14) << after << std::setprecision(2)
+                  << std::setw(9) << after / before << "x" << std::setprecision(0) << std::setw(18) << pipelined
+                  << std::endl;
+    }
+    if (sink == 0) {
+        std::cout << std::endl;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    std::string suite = (argc > 1) ? argv[1] : "static";
+    if (suite == "presets") {
+        benchmarkPresets((argc > 2) ? std::stof(argv[2]) : 2.0f, (argc > 3) ? argv[3] : "presets.json");
+        return 0;
+    }
+    if (suite == "http") {
+        benchmarkHTTPParser((argc > 2) ? std::stof(argv[2]) : 1.0f);
+        return 0;
+    }
+    int notes = (argc > 2) ? std::stoi(argv[2]) : 16;
+    float seconds = (argc > 3) ? std::stof(argv[3]) : 2.0f;
+
+    if (suite == "static") {
+        benchmarkStaticVsDynamic(notes, seconds);
+    } else if (suite == "simd") {
+        benchmarkSimdVoices(notes, seconds);
+    } else if (suite == "jitter") {
+        benchmarkNoteEventJitter((argc > 2) ? notes : 4, seconds);
+    } else if (suite == "memory") {
+        benchmarkVoiceBankMemory();
+    } else if (suite == "switch") {
+        benchmarkPresetSwitching((argc > 2) ? notes : 3, seconds);
+    } else if (suite == "threads") {
+        const unsigned maxThreads = (argc > 4) ? std::stoul(argv[4]) : std::max(std::thread::hardware_concurrency(), 1u);
+        benchmarkRenderThreads((argc > 2) ? notes : 32, seconds, maxThreads);
+    } else {
+        std::cerr << "Usage: benchmark [static|simd|jitter|switch|memory|threads] [notes|producers] [seconds] [max threads]\n"
+                     "       benchmark presets [seconds] [json file]\n"
+                     "       benchmark http [seconds]" << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -3,9 +3,10 @@
 #ifdef _WIN32
 #include <winsock2.h>
 #include <ws2tcpip.h>
-#endif
 #include <windows.h>
 #include <mmsystem.h>
+#include <shellapi.h>
+#endif
 #include <memory>
 #include <unordered_map>
 #include <string>
@@ -13,19 +14,29 @@
 #include <thread>
 #include <atomic>
 #include <map>
+#include <array>
 #include <cmath>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
 #include "ActiveTones.cpp"
 #include "StaticServer.h"
 #include "SSEServer.h"
 #include "HTTPAPIHandler.h"
+#include "WebSocketServer.h"
 #include "Parameter.cpp"      // Include the Parameter class definition
 #include <sstream>          // For std::ostringstream
 #include <string>           // For std::string
 #include <iostream>         // For std::ostream (if needed)
 #include "VoiceGeneratorRepository.cpp"
+#include "ParameterTreeCache.cpp"
+#include "ScopeStreamer.cpp"
 
 class ActiveTones;
 
+// MIDI input and the computer keyboard use the Windows multimedia and Win32
+// APIs; other platforms are driven through the HTTP API only
+#ifdef _WIN32
 class MidiHandler {
 public:
     MidiHandler(std::shared_ptr<ActiveTones> activeTones)
@@ -70,19 +81,19 @@ public:
     }
 
     void handleControlChange(BYTE controller, BYTE value) {
-        auto params = activeTones->getParameters();
-        auto it = midiToParamName.find(controller);
-        if (it != midiToParamName.end()) {
-            const std::string& paramName = it->second;
-            for (auto& param : params) {
-                if (param->getName() == paramName) {
-                    float normalizedValue = static_cast<float>(value) / 127.0f;
-                    float newValue = param->getMinValue() + normalizedValue * (param->getMaxValue() - param->getMinValue());
-                    param->setValue(newValue);
-                    std::cout << "Parameter " << paramName << " set to " << newValue << " " << param->getUnit() << std::endl;
-                    break;
-                }
-            }
+        if (controller >= controllerIds.size()) {
+            return;
+        }
+        auto registry = activeTones->getParameterRegistry();
+        if (registry->getStructureVersion() != controllerRegistryVersion) {
+            resolveControllers(*registry);
+        }
+        Parameter* param = registry->get(controllerIds[controller]);
+        if (param) {
+            float normalizedValue = static_cast<float>(value) / 127.0f;
+            float newValue = param->getMinValue() + normalizedValue * (param->getMaxValue() - param->getMinValue());
+            param->requestValue(newValue);
+            std::cout << "Parameter " << param->getName() << " set to " << newValue << " " << param->getUnit() << std::endl;
         }
     }
 
@@ -100,6 +111,18 @@ private:
     std::shared_ptr<ActiveTones> activeTones;
     HMIDIIN hMidiIn;
     std::unordered_map<int, std::string> midiToParamName;
+    // Controller -> ParameterId, resolved once per preset. Keyed by the
+    // registry's version rather than holding it, so a replaced preset can be freed.
+    uint64_t controllerRegistryVersion = UINT64_MAX;
+    std::array<ParameterId, 128> controllerIds;
+
+    void resolveControllers(const ParameterRegistry& registry) {
+        controllerRegistryVersion = registry.getStructureVersion();
+        controllerIds.fill(INVALID_PARAMETER_ID);
+        for (const auto& [controller, paramName] : midiToParamName) {
+            controllerIds[controller] = registry.find(paramName);
+        }
+    }
 
     void MidiInProc(HMIDIIN hMidiIn, UINT wMsg, DWORD_PTR dwParam1, DWORD_PTR dwParam2) {
         if (wMsg == MIM_DATA) {
@@ -198,23 +221,29 @@ private:
                 }
             }
 
-            // Handle parameter selection and adjustment
+            // Handle parameter selection and adjustment. The registry is
+            // this preset's parameter list; a preset switch may shorten it.
+            auto registry = activeTones->getParameterRegistry();
+            const size_t paramCount = registry->size();
+            if (selectedParameter >= paramCount) {
+                selectedParameter = 0;
+            }
             if (GetAsyncKeyState(VK_UP) & 0x8000) {
-                selectedParameter = (selectedParameter - 1 + activeTones->getParameters().size()) % activeTones->getParameters().size();
-                std::cout << "Selected Parameter: " << activeTones->getParameters()[selectedParameter]->getName() << std::endl;
+                selectedParameter = (selectedParameter - 1 + paramCount) % paramCount;
+                std::cout << "Selected Parameter: " << registry->get(selectedParameter)->getName() << std::endl;
                 Sleep(200); // Debounce
             }
             if (GetAsyncKeyState(VK_DOWN) & 0x8000) {
-                selectedParameter = (selectedParameter + 1) % activeTones->getParameters().size();
-                std::cout << "Selected Parameter: " << activeTones->getParameters()[selectedParameter]->getName() << std::endl;
+                selectedParameter = (selectedParameter + 1) % paramCount;
+                std::cout << "Selected Parameter: " << registry->get(selectedParameter)->getName() << std::endl;
                 Sleep(200); // Debounce
             }
             if (GetAsyncKeyState(VK_LEFT) & 0x8000) {
-                adjustParameterValue(selectedParameter, -activeTones->getParameters()[selectedParameter]->getStepSize());
+                adjustParameterValue(*registry, selectedParameter, -registry->get(selectedParameter)->getStepSize());
                 Sleep(100); // Debounce
             }
             if (GetAsyncKeyState(VK_RIGHT) & 0x8000) {
-                adjustParameterValue(selectedParameter, activeTones->getParameters()[selectedParameter]->getStepSize());
+                adjustParameterValue(*registry, selectedParameter, registry->get(selectedParameter)->getStepSize());
                 Sleep(100); // Debounce
             }
 
@@ -222,21 +251,23 @@ private:
         }
     }
 
-    void adjustParameterValue(size_t paramIndex, float delta) {
-        auto& params = activeTones->getParameters();
-        if (paramIndex >= 0 && paramIndex < params.size()) {
-            auto& param = params[paramIndex]; // Cast away constness if necessary
+    void adjustParameterValue(const ParameterRegistry& registry, size_t paramIndex, float delta) {
+        if (Parameter* param = registry.get(static_cast<ParameterId>(paramIndex))) {
             float currentValue = param->getValue();
             float newValue = std::clamp(currentValue + delta, param->getMinValue(), param->getMaxValue());
-            param->setValue(newValue);
+            param->requestValue(newValue);
             std::cout << "Parameter " << param->getName() << " adjusted to " << newValue << " " << param->getUnit() << std::endl;
         }
     }
 };
+#endif // _WIN32
 
 
 class AudioEngine; // Forward declaration
 
+static_assert(WebSocketServer::MAX_PARAMETERS_PER_MESSAGE == ParameterChangeBatch::MAX_CHANGES,
+              "a WebSocket message's parameter changes must fit one batch");
+
 class ServerHandler {
 public:
     ServerHandler(std::shared_ptr<SoundGenerator> soundGeneratorPtr,
@@ -244,9 +275,12 @@ public:
                   std::shared_ptr<ActiveTones> activeTonesPtr,
                   AudioEngine* audioEnginePtr = nullptr)
         : soundGenerator(soundGeneratorPtr), voiceGeneratorRepo(voiceRepo),
-          activeTones(activeTonesPtr), audioEngine(audioEnginePtr) {}
+          activeTones(activeTonesPtr), audioEngine(audioEnginePtr),
+          parameterCache(std::make_unique<ParameterTreeCache>(
+              [activeTonesPtr]() { return activeTonesPtr->getParameterRegistry(); })) {}
 
     bool initialize() {
+#ifdef _WIN32
         // Get the executable's path
         char exePath[MAX_PATH];
         GetModuleFileNameA(NULL, exePath, MAX_PATH);
@@ -259,42 +293,103 @@ public:
 
         // Change to the executable's directory
         SetCurrentDirectoryA(exePath);
+#endif
 
         // Create SSE server
         sseServer = std::make_shared<SSEServer>();
-        sseServer->setInitialStateCallback([this](socket_t clientSocket) {
+        sseServer->setInitialStateCallback([this](const HTTPConnection& connection) {
             std::string allParamsJson = getAllParametersJSON();
             std::string allVoicesJson = getAllVoicesJSON();
-            sseServer->sendInitialState(clientSocket, allParamsJson, allVoicesJson);
+            sseServer->sendInitialState(connection, allParamsJson, allVoicesJson);
         });
         
+        // Create WebSocket server; its clients subscribe to what they want pushed
+        webSocketServer = std::make_shared<WebSocketServer>();
+        webSocketServer->setParameterCallback([this](WebSocketServer::ClientId client, const std::vector<std::pair<std::string, float>>& values) {
+            updateParameters(values, client);
+        });
+        webSocketServer->setNoteCallback([this](int note, float velocity, bool on) {
+            if (on) {
+                float frequency = 440.0f * powf(2.0f, (note - 69) / 12.0f);
+                activeTones->noteOn(note, 0, frequency, velocity); // Channel 0, like the keyboard
+            } else {
+                activeTones->noteOff(note, 0);
+            }
+        });
+        webSocketServer->setVoiceChangeCallback([this](const std::string& voiceName) {
+            changeVoiceGenerator(voiceName);
+        });
+        webSocketServer->setSubscribeCallback([this](WebSocketServer::ClientId client, const std::string& topic) {
+            if (topic == "params") {
+                webSocketServer->sendText(client, getAllParametersJSON());
+            } else if (topic == "voices") {
+                webSocketServer->sendText(client, getAllVoicesJSON());
+            }
+        });
+
         // Create HTTP API handler
         httpAPIHandler = std::make_shared<HTTPAPIHandler>();
         httpAPIHandler->setParameterUpdateCallback([this](const std::string& name, float value) {
             updateParameter(name, value);
         });
+        httpAPIHandler->setParameterBatchUpdateCallback([this](const std::vector<std::pair<std::string, float>>& values) {
+            updateParameters(values);
+        });
         httpAPIHandler->setVoiceChangeCallback([this](const std::string& voiceName) {
             changeVoiceGenerator(voiceName);
         });
+        httpAPIHandler->setParameterChangesCallback([this](uint64_t since) {
+            return parameterCache->changesSince(since);
+        });
+        httpAPIHandler->setProfileReportCallback([]() {
+            return NodeProfiler::instance().toJSON();
+        });
+        httpAPIHandler->setProfileEnableCallback([](bool enabled) {
+            NodeProfiler::instance().setEnabled(enabled);
+        });
         
         // Set up waveform data callback if audio engine is available
         if (audioEngine) {
             httpAPIHandler->setWaveformDataCallback([this]() -> std::vector<float> {
                 return audioEngine->getWaveformData();
             });
+            httpAPIHandler->setStatsCallback([this]() {
+                return audioEngine->getStatsJSON();
+            });
+            httpAPIHandler->setScopeFrameCallback([this](ScopeFormat format, uint64_t since, std::string& frame) {
+                const AudioEngine::WaveformTap& tap = audioEngine->getWaveformTap();
+                if (tap.unchangedSince(since, AudioEngine::WAVEFORM_BUFFER_SIZE)) {
+                    return false; // same check as ScopeStreamer: not moved on, or still silent
+                }
+                std::vector<float> samples(AudioEngine::WAVEFORM_BUFFER_SIZE);
+                const uint64_t position = tap.snapshot(samples.data(), samples.size());
+                encodeScopeFrame(samples.data(), samples.size(), position, format, frame);
+                return true;
+            });
+            scopeStreamer = std::make_unique<ScopeStreamer>(audioEngine->getWaveformTap(), AudioEngine::WAVEFORM_BUFFER_SIZE);
+            scopeStreamer->start();
+            httpAPIHandler->setScopeStreamCallback([this](const HTTPConnection& connection, ScopeFormat format, unsigned fps) {
+                scopeStreamer->addClient(connection, format, fps);
+            });
         }
 
         // Create and configure static server
         staticServer = std::make_unique<StaticServer>("./", 8080);
         staticServer->setSSEServer(sseServer);
         staticServer->setHTTPAPIHandler(httpAPIHandler);
+        staticServer->setWebSocketServer(webSocketServer);
 
         if (!staticServer->start()) {
             std::cerr << "Failed to start static server on port 8080" << std::endl;
             return false;
         }
 
-        std::cout << "Server started on port 8080 (Static files, SSE, and API)" << std::endl;
+        std::cout << "Server started on port 8080 (Static files, SSE, WebSocket, and API)" << std::endl;
+
+        if (audioEngine) {
+            statsRunning = true;
+            statsThread = std::thread(&ServerHandler::pushStats, this);
+        }
         
         // Open the default web browser
         openDefaultBrowser();
@@ -303,9 +398,23 @@ public:
     }
 
     void shutdown() {
+        {
+            std::lock_guard<std::mutex> lock(statsMutex);
+            statsRunning = false;
+        }
+        statsWake.notify_all();
+        if (statsThread.joinable()) {
+            statsThread.join();
+        }
+        if (scopeStreamer) {
+            scopeStreamer->stop();
+        }
         if (sseServer) {
             sseServer->cleanup();
         }
+        if (webSocketServer) {
+            webSocketServer->stop();
+        }
         if (staticServer) {
             staticServer->stop();
             staticServer.reset();
@@ -319,27 +428,31 @@ private:
     AudioEngine* audioEngine;
     std::unique_ptr<StaticServer> staticServer;
     std::shared_ptr<SSEServer> sseServer;
+    std::shared_ptr<WebSocketServer> webSocketServer;
     std::shared_ptr<HTTPAPIHandler> httpAPIHandler;
+    std::unique_ptr<ParameterTreeCache> parameterCache;
+    std::unique_ptr<ScopeStreamer> scopeStreamer;
+    std::thread statsThread;
+    std::mutex statsMutex;
+    std::condition_variable statsWake;
+    bool statsRunning = false; // guarded by statsMutex
+
+    static constexpr auto STATS_PUSH_INTERVAL = std::chrono::seconds(1);
+
+    // Sends the /api/stats summary to every SSE client and stats subscriber once per interval
+    void pushStats() {
+        std::unique_lock<std::mutex> lock(statsMutex);
+        while (!statsWake.wait_for(lock, STATS_PUSH_INTERVAL, [this]() { return !statsRunning; })) {
+            lock.unlock();
+            const std::string stats = audioEngine->getStatsJSON();
+            sseServer->broadcastSSEEvent(stats);
+            webSocketServer->broadcast("stats", stats);
+            lock.lock();
+        }
+    }
 
     std::string getAllParametersJSON() {
-        std::ostringstream oss;
-        oss << "{\"type\":\"all_params\",\"params\":[";
-    
-        auto params = soundGenerator->getParameters();
-        for (size_t i = 0; i < params.size(); ++i) {
-            const auto& param = params[i];
-            oss << "{\"name\":\"" << param->getName() << "\","
-                << "\"value\":" << param->getValue() << ","
-                << "\"min\":" << param->getMinValue() << ","
-                << "\"max\":" << param->getMaxValue() << ","
-                << "\"step\":" << param->getStepSize() << ","
-                << "\"unit\":\"" << param->getUnit() << "\"}";
-            if (i < params.size() - 1) {
-                oss << ",";
-            }
-        }
-        oss << "]}";
-        return oss.str();
+        return parameterCache->allParams();
     }
 
     std::string getAllVoicesJSON() {
@@ -357,36 +470,65 @@ private:
         return oss.str();
     }
 
-    void broadcastParameterUpdate(const std::string& paramName, float paramValue) {
+    // origin is the WebSocket client that made the change; it already has the value
+    void broadcastParameterUpdate(const std::string& paramName, float paramValue,
+                                  WebSocketServer::ClientId origin = WebSocketServer::NO_CLIENT) {
         if (sseServer) {
             sseServer->broadcastParameterUpdate(paramName, paramValue);
         }
+        if (webSocketServer) {
+            std::ostringstream oss;
+            oss << "p " << paramValue << " " << paramName;
+            webSocketServer->broadcast("params", oss.str(), origin);
+        }
     }
 
     void updateParameter(const std::string& paramName, float paramValue) {
-        auto& params = soundGenerator->getParameters();
-        for (auto& param : params) {
-            if (param->getName() == paramName) {
-                param->setValue(paramValue);
-                std::cout << "Parameter " << paramName << " updated to " << paramValue << std::endl;
-                broadcastParameterUpdate(paramName, paramValue);
-                break;
+        updateParameters({{paramName, paramValue}});
+    }
+
+    // Publishes all values as one batch so the audio thread applies them in the same block
+    void updateParameters(const std::vector<std::pair<std::string, float>>& values,
+                          WebSocketServer::ClientId origin = WebSocketServer::NO_CLIENT) {
+        auto registry = activeTones->getParameterRegistry();
+        ParameterBatch batch;
+        std::vector<std::pair<std::string, float>> accepted;
+        for (const auto& [paramName, paramValue] : values) {
+            Parameter* param = registry->get(paramName);
+            if (param && batch.set(*param, paramValue)) {
+                accepted.emplace_back(paramName, paramValue);
             }
         }
+        if (!batch.commit()) {
+            return;
+        }
+        for (const auto& [paramName, paramValue] : accepted) {
+            std::cout << "Parameter " << paramName << " updated to " << paramValue << std::endl;
+            broadcastParameterUpdate(paramName, paramValue, origin);
+        }
     }
 
     void changeVoiceGenerator(const std::string& voiceGeneratorName) {
         try {
             auto newVoiceGenerator = voiceGeneratorRepo.getVoiceGenerator(voiceGeneratorName);
-            activeTones->setVoiceGenerator(newVoiceGenerator);
-            std::cout << "Voice generator changed to: " << voiceGeneratorName << std::endl;
-            broadcastVoiceGeneratorChange(voiceGeneratorName);
-            
-            // Rebroadcast all parameters after voice change
-            if (sseServer) {
-                std::string allParamsJson = getAllParametersJSON();
-                sseServer->broadcastSSEEvent(allParamsJson);
+            // The voices are built in the background; rebroadcast all
+            // parameters once the new set is published
+            auto onReady = [this, voiceGeneratorName]() {
+                std::cout << "Voice generator changed to: " << voiceGeneratorName << std::endl;
+                const std::string allParams = getAllParametersJSON();
+                if (sseServer) {
+                    sseServer->broadcastSSEEvent(allParams);
+                }
+                if (webSocketServer) {
+                    webSocketServer->broadcast("params", allParams);
+                }
+            };
+            if (const SimdVoiceSpec* simdSpec = voiceGeneratorRepo.getSimdVoiceSpec(voiceGeneratorName)) {
+                activeTones->setSimdVoiceGeneratorAsync(*simdSpec, onReady);
+            } else {
+                activeTones->setVoiceGeneratorAsync(newVoiceGenerator, onReady);
             }
+            broadcastVoiceGeneratorChange(voiceGeneratorName);
         } catch (const std::runtime_error& e) {
             std::cerr << "Error changing voice generator: " << e.what() << std::endl;
         }
@@ -396,11 +538,18 @@ private:
         if (sseServer) {
             sseServer->broadcastVoiceChange(voiceGeneratorName);
         }
+        if (webSocketServer) {
+            webSocketServer->broadcast("voices", "{\"type\":\"voice_generator_change\",\"voiceGenerator\":\"" + voiceGeneratorName + "\"}");
+        }
     }
 
     void openDefaultBrowser() {
         const char* url = "http://localhost:8080/gui.html";
+#ifdef _WIN32
         ShellExecuteA(NULL, "open", url, NULL, NULL, SW_SHOWNORMAL);
         std::cout << "Opening default web browser to " << url << std::endl;
+#else
+        std::cout << "GUI available at " << url << std::endl;
+#endif
     }
 };
@@ -1,12 +1,15 @@
+// Windows (WASAPI, MIDI, keyboard) or Linux (null/WAV backends only):
+//     g++ -std=c++17 -O2 -I. main.cpp StaticServer.cpp SSEServer.cpp HTTPAPIHandler.cpp WebSocketServer.cpp -o bin/msound -pthread
+// Add -mavx2 for the 8-lane SIMD voice bank (AVX CPUs only, see SimdVoices.cpp).
+// Add -DMSOUND_EMBED_GUI to compile gui.html into the binary instead of serving it from the working directory.
+// Usage: msound [--backend wasapi|null|wav] [--realtime] [--out file.wav] [--seconds N] [--sample-rate Hz]
+//               [--render-threads N] [--dynamic] [--profile]
 #include <inttypes.h>
 #include <math.h>
-#include <mmdeviceapi.h>
-#include <audioclient.h>
 #include <stdio.h>
 #include <random>
 #include <algorithm>
 #include <cmath>
-#include <mmsystem.h>
 #include <iostream>
 #include <iomanip>
 #include <string>
@@ -26,293 +29,116 @@
 #include "Voices.cpp"
 #include "ADSRGenerator.cpp"
 #include "ActiveTones.cpp"
-#include <shellapi.h>
 #include "math.cpp"
 #include "VoiceGeneratorRepository.cpp"
 #include "mixer.cpp"
 #include "presets.cpp"
+#include "AudioBackend.cpp"
+#include "WasapiAudioBackend.cpp"
+#include "AudioEngine.cpp"
 
-// Constants
-#define BYTES_PER_CHANNEL sizeof(float)
-#define CHANNELS_PER_SAMPLE 1
-#define SAMPLES_PER_SECOND 44100
-#define OSCILLATORS_PER_TONE 3
-#define REVERB_BUFFER_SIZE (SAMPLES_PER_SECOND / 10)
-#define NUM_REVERB_TAPS 64
-
-// Forward Declarations
-class SoundGenerator;
-class Tone;
-class AudioEngine;
-
-// AudioEngine class with adjusted constructor and processAudio method
-class AudioEngine {
-public:
-    // Waveform buffer for the last 100ms (4410 samples at 44100 Hz)
-    static constexpr int WAVEFORM_BUFFER_SIZE = SAMPLES_PER_SECOND / 10; // 100ms = 4410 samples
-    std::array<float, WAVEFORM_BUFFER_SIZE> waveformBuffer;
-    std::atomic<int> waveformBufferIndex{0};
-    mutable std::mutex waveformMutex;
-    
-    AudioEngine(std::shared_ptr<SoundGenerator> generator)
-        : soundGenerator(generator),
-          running(true),
-          enumerator(nullptr),
-          endpoint(nullptr),
-          audioClient(nullptr),
-          renderClient(nullptr),
-          mixFormat(nullptr),
-          defaultDevicePeriod(0),
-          minDevicePeriod(0),
-          bufferSampleCount(0) {
-        waveformBuffer.fill(0.0f);
-    }
-
-    ~AudioEngine() {
-        shutdown();
-    }
-
-    bool initialize() {
-    HRESULT hr = CoInitializeEx(nullptr, COINIT_MULTITHREADED | COINIT_DISABLE_OLE1DDE);
-    if (FAILED(hr)) {
-        std::cerr << "Failed to initialize COM library." << std::endl;
-        return false;
-    }
-
-    hr = CoCreateInstance(__uuidof(MMDeviceEnumerator), NULL, CLSCTX_ALL, __uuidof(IMMDeviceEnumerator), (void**)&enumerator);
-    if (FAILED(hr)) {
-        std::cerr << "Failed to create MMDeviceEnumerator instance." << std::endl;
-        return false;
-    }
-
-    hr = enumerator->GetDefaultAudioEndpoint(eRender, eConsole, &endpoint);
-    if (FAILED(hr)) {
-        std::cerr << "Failed to get default audio endpoint." << std::endl;
-        return false;
-    }
-
-    hr = endpoint->Activate(__uuidof(IAudioClient), CLSCTX_ALL, NULL, (void**)&audioClient);
-    if (FAILED(hr)) {
-        std::cerr << "Failed to activate audio client." << std::endl;
-        return false;
-    }
-
-    hr = audioClient->GetMixFormat(&mixFormat);
-    if (FAILED(hr)) {
-        std::cerr << "Failed to get mix format." << std::endl;
-        return false;
-    }
-
-    printMixFormat();
-
-    // Free mixFormat as we will create our own format
-    CoTaskMemFree(mixFormat);
-    mixFormat = nullptr;
-
-    WAVEFORMATEX* format = nullptr;
-    format = (WAVEFORMATEX*)CoTaskMemAlloc(sizeof(WAVEFORMATEX));
-    ZeroMemory(format, sizeof(WAVEFORMATEX));
-
-    format->wFormatTag = WAVE_FORMAT_IEEE_FLOAT;
-    format->nChannels = CHANNELS_PER_SAMPLE;
-    format->nSamplesPerSec = SAMPLES_PER_SECOND;
-    format->wBitsPerSample = BYTES_PER_CHANNEL * 8;
-    format->nBlockAlign = (CHANNELS_PER_SAMPLE * BYTES_PER_CHANNEL);
-    format->nAvgBytesPerSec = SAMPLES_PER_SECOND * format->nBlockAlign;
-    format->cbSize = 0;
-
-    hr = audioClient->GetDevicePeriod(&defaultDevicePeriod, &minDevicePeriod);
-    if (FAILED(hr)) {
-        std::cerr << "Failed to get device period." << std::endl;
-        CoTaskMemFree(format);
-        return false;
-    }
-
-    hr = audioClient->Initialize(
-        AUDCLNT_SHAREMODE_SHARED,
-        AUDCLNT_STREAMFLAGS_AUTOCONVERTPCM,
-        defaultDevicePeriod,
-        0,
-        format,
-        0
-    );
-    if (FAILED(hr)) {
-        std::cerr << "Failed to initialize audio client." << std::endl;
-        CoTaskMemFree(format);
-        return false;
-    }
-
-    hr = audioClient->GetService(__uuidof(IAudioRenderClient), (void**)&renderClient);
-    if (FAILED(hr)) {
-        std::cerr << "Failed to get render client service." << std::endl;
-        CoTaskMemFree(format);
-        return false;
-    }
+#include "handlers.cpp"
 
-    hr = audioClient->GetBufferSize(&bufferSampleCount);
-    if (FAILED(hr)) {
-        std::cerr << "Failed to get buffer size." << std::endl;
-        CoTaskMemFree(format);
-        return false;
-    }
-    std::cout << "Buffer size: " << bufferSampleCount << std::endl;
+struct Options {
+#ifdef _WIN32
+    std::string backend = "wasapi";
+#else
+    std::string backend = "null";
+#endif
+    bool realtime = false;
+    std::string outputPath = "msound.wav";
+    float seconds = 0.0f; // 0 = until Enter
+    float sampleRate = AudioEngine::DEFAULT_SAMPLE_RATE;
+    unsigned renderThreads = std::max(std::thread::hardware_concurrency() / 2, 1u);
+    bool dynamic = false; // runtime graphs instead of compositions / SIMD, so the profile shows every node
+    bool profile = false; // node profiling from the start (GET /api/profile)
+};
 
-    hr = audioClient->Start();
-    if (FAILED(hr)) {
-        std::cerr << "Failed to start audio stream." << std::endl;
-        CoTaskMemFree(format);
-        return false;
+bool parseOptions(int argc, char* argv[], Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--backend" && hasValue) {
+            options.backend = argv[++i];
+        } else if (arg == "--realtime") {
+            options.realtime = true;
+        } else if (arg == "--out" && hasValue) {
+            options.outputPath = argv[++i];
+        } else if (arg == "--seconds" && hasValue) {
+            options.seconds = std::stof(argv[++i]);
+        } else if (arg == "--sample-rate" && hasValue) {
+            options.sampleRate = std::stof(argv[++i]);
+        } else if (arg == "--render-threads" && hasValue) {
+            options.renderThreads = static_cast<unsigned>(std::stoul(argv[++i]));
+        } else if (arg == "--dynamic") {
+            options.dynamic = true;
+        } else if (arg == "--profile") {
+            options.profile = true;
+        } else {
+            return false;
+        }
     }
-
-    // Free the format structure after initialization
-    CoTaskMemFree(format);
-
     return true;
 }
 
-    void processAudio() {
-        UINT32 prevAvailableSamples = 0;
-        while (running) {
-            UINT32 paddingSampleCount;
-            HRESULT hr = audioClient->GetCurrentPadding(&paddingSampleCount);
-            if (FAILED(hr)) {
-                std::cerr << "Failed to get current padding." << std::endl;
-                break;
-            }
-
-            UINT32 availableSamples = bufferSampleCount - paddingSampleCount;
-
-            if (availableSamples > 100 && prevAvailableSamples > 100) {
-                std::cout << "Überlastet" << std::endl;
-            }
-
-            BYTE* buffer;
-            hr = renderClient->GetBuffer(availableSamples, &buffer);
-            if (SUCCEEDED(hr)) {
-                float* floatBuffer = reinterpret_cast<float*>(buffer);
-
-                for (UINT32 i = 0; i < availableSamples; ++i) {
-                    float outputSample = soundGenerator->generateSample(SAMPLES_PER_SECOND);
-
-                    // Apply soft clipping
-                    outputSample = std::tanh(outputSample);
-
-                    floatBuffer[i] = outputSample;
-                    
-                    // Store sample in waveform buffer
-                    {
-                        std::lock_guard<std::mutex> lock(waveformMutex);
-                        int index = waveformBufferIndex.load();
-                        waveformBuffer[index] = outputSample;
-                        waveformBufferIndex = (index + 1) % WAVEFORM_BUFFER_SIZE;
-                    }
-                }
-
-                hr = renderClient->ReleaseBuffer(availableSamples, 0);
-                if (FAILED(hr)) {
-                    std::cerr << "Failed to release buffer." << std::endl;
-                    break;
-                }
-
-                // Allow other threads to run
-                Sleep(0);
-            }
-            else {
-                std::cout << "No buffer available" << std::endl;
-                Sleep(0);
-            }
-
-            prevAvailableSamples = availableSamples;
-        }
+std::unique_ptr<AudioBackend> createAudioBackend(const Options& options) {
+    const uint64_t maxFrames = static_cast<uint64_t>(options.seconds * options.sampleRate);
+    if (options.backend == "null") {
+        // Without a duration this is a headless server, which should keep real time
+        return std::make_unique<NullAudioBackend>(options.realtime || maxFrames == 0, maxFrames);
     }
-
-    void shutdown() {
-        running = false;
-        if (audioClient) {
-            audioClient->Stop();
-        }
-        if (renderClient) {
-            renderClient->Release();
-            renderClient = nullptr;
-        }
-        if (audioClient) {
-            audioClient->Release();
-            audioClient = nullptr;
-        }
-        if (endpoint) {
-            endpoint->Release();
-            endpoint = nullptr;
-        }
-        if (enumerator) {
-            enumerator->Release();
-            enumerator = nullptr;
-        }
-        if (mixFormat) {
-            CoTaskMemFree(mixFormat);
-            mixFormat = nullptr;
-        }
-        CoUninitialize();
+    if (options.backend == "wav") {
+        return std::make_unique<WavFileAudioBackend>(options.outputPath, maxFrames);
     }
-    
-    // Get waveform data for visualization
-    std::vector<float> getWaveformData() const {
-        std::lock_guard<std::mutex> lock(waveformMutex);
-        std::vector<float> result;
-        result.reserve(WAVEFORM_BUFFER_SIZE);
-        
-        int currentIndex = waveformBufferIndex.load();
-        // Read from current position backwards to get the most recent samples first
-        for (int i = 0; i < WAVEFORM_BUFFER_SIZE; ++i) {
-            int readIndex = (currentIndex - 1 - i + WAVEFORM_BUFFER_SIZE) % WAVEFORM_BUFFER_SIZE;
-            result.push_back(waveformBuffer[readIndex]);
-        }
-        
-        return result;
+#ifdef _WIN32
+    if (options.backend == "wasapi") {
+        return std::make_unique<WasapiAudioBackend>();
     }
+#endif
+    return nullptr;
+}
 
-private:
-    std::shared_ptr<SoundGenerator> soundGenerator;
-    bool running;
-    IMMDeviceEnumerator* enumerator;
-    IMMDevice* endpoint;
-    IAudioClient* audioClient;
-    IAudioRenderClient* renderClient;
-    WAVEFORMATEX* mixFormat;
-    REFERENCE_TIME defaultDevicePeriod;
-    REFERENCE_TIME minDevicePeriod;
-    UINT32 bufferSampleCount;
-
-    void printMixFormat() {
-        std::cout << "Audio Format:" << std::endl;
-        std::cout << "  Format Tag: " << mixFormat->wFormatTag << std::endl;
-        std::cout << "  Channels: " << mixFormat->nChannels << std::endl;
-        std::cout << "  Samples per Second: " << mixFormat->nSamplesPerSec << std::endl;
-        std::cout << "  Bits per Sample: " << mixFormat->wBitsPerSample << std::endl;
-        std::cout << "  Block Align: " << mixFormat->nBlockAlign << std::endl;
-        std::cout << "  Average Bytes per Second: " << mixFormat->nAvgBytesPerSec << std::endl;
-    }
-};
-
-#include "handlers.cpp"
 // Main function
-int main()
+int main(int argc, char* argv[])
 {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        std::cerr << "Usage: msound [--backend wasapi|null|wav] [--realtime] [--out file.wav] [--seconds N] [--sample-rate Hz] [--render-threads N] [--dynamic] [--profile]" << std::endl;
+        return 1;
+    }
+    auto backend = createAudioBackend(options);
+    if (!backend) {
+        std::cerr << "Audio backend not available: " << options.backend << std::endl;
+        return 1;
+    }
+
     // Use the chosen factory function to create ActiveTones
     VoiceGeneratorRepository voiceRepo;
-    
+
     // Load presets from presets.cpp
-    loadPresets(voiceRepo);
+    if (options.dynamic) {
+        loadDynamicPresets(voiceRepo);
+    } else {
+        loadPresets(voiceRepo);
+    }
+    NodeProfiler::instance().setEnabled(options.profile);
 
     // Use the first voice generator by default
     auto activeTones = std::make_shared<ActiveTones>(voiceRepo.getVoiceGenerator("Sine Oscillator"));
+    if (const SimdVoiceSpec* simdSpec = voiceRepo.getSimdVoiceSpec("Sine Oscillator")) {
+        activeTones->setSimdVoiceGenerator(*simdSpec);
+    }
+    activeTones->setRenderThreads(options.renderThreads);
 
     auto tremolo = std::make_shared<Tremolo>(activeTones, 5.0f, 0.5f);
     auto interpolatedChorus = std::make_shared<InterpolatedChorus>(tremolo, 0.5f, 0.5f, 0.5f, 0.5f);
     auto final = activeTones;
 
     // Initialize the audio engine
-    AudioEngine audioEngine(final);
-    if (!audioEngine.initialize()) {
+    AudioEngine audioEngine(final, std::move(backend));
+    AudioStreamConfig streamConfig;
+    streamConfig.sampleRate = options.sampleRate;
+    if (!audioEngine.initialize(streamConfig)) {
         std::cerr << "Failed to initialize audio engine." << std::endl;
         return 1;
     }
@@ -320,7 +146,8 @@ int main()
     // Update the ServerHandler initialization to pass the VoiceGeneratorRepository, ActiveTones, and AudioEngine
     ServerHandler serverHandler(final, voiceRepo, activeTones, &audioEngine);
     serverHandler.initialize();
-    
+
+#ifdef _WIN32
     // Initialize KeyboardHandler
     KeyboardHandler keyboardHandler(activeTones);
     keyboardHandler.start();
@@ -330,16 +157,24 @@ int main()
     if (!midiHandler.initialize()) {
         std::cerr << "Failed to initialize MIDI handler." << std::endl;
     }
+#endif
     // Start audio processing in a separate thread
     std::thread audioThread(&AudioEngine::processAudio, &audioEngine);
 
-    // Keep the main thread running until termination
-    std::cout << "Press Enter to exit..." << std::endl;
-    std::cin.get();
+    if (options.seconds > 0.0f) {
+        // The backend stops by itself after the requested duration
+        audioThread.join();
+    } else {
+        // Keep the main thread running until termination
+        std::cout << "Press Enter to exit..." << std::endl;
+        std::cin.get();
+    }
 
     // Shutdown procedures
+#ifdef _WIN32
     keyboardHandler.stop();
     midiHandler.shutdown();
+#endif
     audioEngine.shutdown();
     serverHandler.shutdown();
 
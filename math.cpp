@@ -1,3 +1,13 @@
 #pragma once
 
+#include <cmath>
+#include <algorithm>
+
 #define PI 3.14159265358979323846f
+
+// Samples until a feedback delay line's echoes fall below -80 dB once its input stops
+inline float delayTailSamples(float delaySamples, float feedback) {
+    const float silence = 1e-4f;
+    float repeats = std::log(silence) / std::log(std::clamp(feedback, 0.001f, 0.99f));
+    return delaySamples * (1.0f + repeats);
+}
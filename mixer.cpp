@@ -1,9 +1,15 @@
+#pragma once
+
 #include <vector>
+#include <array>
 #include <memory>
+#include <algorithm>
 #include "SoundGenerator.cpp"
+#include "Smoothing.cpp"
 
 
 class Mixer : public SoundGenerator {
+    friend class VoiceCompiler;
 public:
     Mixer(const std::vector<std::shared_ptr<SoundGenerator>>& sources, 
           const std::vector<std::string>& suffixes = std::vector<std::string>())
@@ -13,7 +19,7 @@ public:
             std::string suffix = (i < suffixes.size()) ? suffixes[i] : "";
             auto param = std::make_unique<Parameter>(
                 "Channel " + std::to_string(i + 1) + " Volume" + suffix,
-                0.3f,  // initial value
+                DEFAULT_VOLUME, // initial value
                 0.0f,  // min value
                 2.0f,  // max value
                 0.01f, // step size
@@ -22,22 +28,31 @@ public:
             );
             volumeParams.push_back(param.get()); // Store raw pointer before moving
             addParam(std::move(param));
-            volumes.push_back(1.0f);
+            volumes.emplace_back(DEFAULT_VOLUME, RampCurve::Linear, DEFAULT_VOLUME_RAMP_SECONDS);
             
             // Add source as child generator
             addChildGenerator(sources[i]);
         }
     }
 
-    float generateSample(float sampleRate) override {
-        float mixedSample = 0.0f;
-        
+    void process(float* out, size_t frames, float sampleRate) override {
+        std::fill(out, out + frames, 0.0f);
+
         // Mix all sources with their respective volumes
-        for (size_t i = 0; i < sources.size(); ++i) {
-            mixedSample += sources[i]->generateSample(sampleRate) * volumes[i];
+        for (size_t channel = 0; channel < sources.size(); ++channel) {
+            sources[channel]->render(scratch.data(), frames, sampleRate);
+            BlockRamp volume = volumes[channel].nextBlock(frames, sampleRate);
+            for (size_t i = 0; i < frames; ++i) {
+                out[i] += scratch[i] * volume.next();
+            }
+        }
+    }
+
+    // Volume changes glide over this long instead of jumping
+    void setVolumeRampTime(float seconds) {
+        for (auto& volume : volumes) {
+            volume.setRampTime(seconds);
         }
-        
-        return mixedSample;
     }
 
     // Get parameter by index
@@ -49,13 +64,17 @@ public:
     }
 
 private:
+    static constexpr float DEFAULT_VOLUME = 0.3f;
+    static constexpr float DEFAULT_VOLUME_RAMP_SECONDS = 0.02f;
+
     std::vector<std::shared_ptr<SoundGenerator>> sources;
-    std::vector<float> volumes;
+    std::vector<SmoothedValue> volumes;
     std::vector<Parameter*> volumeParams; // Store raw pointers to parameters
+    std::array<float, MAX_BLOCK_FRAMES> scratch;
 
     void setVolume(size_t channel, float volume) {
         if (channel < volumes.size()) {
-            volumes[channel] = volume;
+            volumes[channel].setTarget(volume);
         }
     }
 };
@@ -0,0 +1,365 @@
+// Offline renderer: plays an event script through a preset (and optional
+// effects) as fast as the CPU allows and writes a 32-bit float WAV.
+//     g++ -std=c++17 -O2 -I. render.cpp -o bin/render -pthread
+// Add -mavx2 for the 8-lane SIMD voice bank (AVX CPUs only, see SimdVoices.cpp).
+//
+// Event script, one event per line, times in seconds ('#' starts a comment):
+//     0.0   on    60 0.8     # note, velocity (default 0.8)
+//     0.5   param Attack 0.2 # any parameter of the preset or effect chain
+//     1.0   off   60
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "Effects.cpp"
+#include "SoundGenerator.cpp"
+#include "Parameter.cpp"
+#include "Voices.cpp"
+#include "ADSRGenerator.cpp"
+#include "ActiveTones.cpp"
+#include "math.cpp"
+#include "VoiceGeneratorRepository.cpp"
+#include "mixer.cpp"
+#include "presets.cpp"
+#include "AudioBackend.cpp"
+
+// Silences std::cout while in scope; ActiveTones logs every note and parameter
+class QuietCout {
+public:
+    QuietCout() : previous(std::cout.rdbuf(sink.rdbuf())) {}
+    ~QuietCout() { std::cout.rdbuf(previous); }
+private:
+    std::ostringstream sink;
+    std::streambuf* previous;
+};
+
+struct RenderEvent {
+    enum class Type { NoteOn, NoteOff, Param };
+
+    uint64_t frame = 0;
+    Type type = Type::NoteOn;
+    int note = 0;
+    float value = 0.0f; // velocity or parameter value
+    std::string parameter;
+};
+
+struct RenderOptions {
+    std::string preset;
+    std::vector<std::string> scriptLines; // from --script files and --event
+    std::vector<std::string> effects;
+    std::string outputPath = "render.wav";
+    float seconds = 0.0f; // 0 = last event plus TAIL_SECONDS
+    float sampleRate = 44100.0f;
+    size_t blockFrames = 256;
+    unsigned threads = 1; // voice render threads
+    bool dynamic = false; // runtime graphs instead of compositions / SIMD
+    bool verbose = false;
+    std::string profilePath; // node profile JSON, see NodeProfiler
+};
+
+constexpr float TAIL_SECONDS = 2.0f;
+
+// std::stof that rejects trailing junk and reports failure instead of throwing
+bool parseFloat(const std::string& text, float& value) {
+    try {
+        size_t used = 0;
+        value = std::stof(text, &used);
+        return used == text.size();
+    } catch (const std::exception&) {
+        return false;
+    }
+}
+
+bool parseUnsigned(const std::string& text, unsigned long& value) {
+    if (text.empty() || text[0] == '-') {
+        return false; // stoul would wrap negative numbers
+    }
+    try {
+        size_t used = 0;
+        value = std::stoul(text, &used);
+        return used == text.size();
+    } catch (const std::exception&) {
+        return false;
+    }
+}
+
+// Parses "<time> on <note> [velocity]", "<time> off <note>" or "<time> param <name> <value>".
+// Notes are MIDI notes, 0..127.
+bool parseEvent(const std::string& line, float sampleRate, RenderEvent& event) {
+    std::istringstream in(line.substr(0, line.find('#')));
+    float time;
+    std::string type;
+    if (!(in >> time >> type) || time < 0.0f) {
+        return false;
+    }
+    event.frame = static_cast<uint64_t>(time * sampleRate + 0.5f);
+    if (type == "on") {
+        event.type = RenderEvent::Type::NoteOn;
+        event.value = 0.8f;
+        if (!(in >> event.note) || event.note < 0 || event.note >= MIDI_NOTE_COUNT) {
+            return false;
+        }
+        float velocity;
+        if (in >> velocity) {
+            event.value = velocity;
+        }
+        return true;
+    }
+    if (type == "off") {
+        event.type = RenderEvent::Type::NoteOff;
+        return (in >> event.note) && event.note >= 0 && event.note < MIDI_NOTE_COUNT;
+    }
+    if (type == "param") {
+        // Parameter names contain spaces ("Channel 1 Volume"); the value is the last word
+        std::vector<std::string> words;
+        for (std::string word; in >> word;) {
+            words.push_back(word);
+        }
+        if (words.size() < 2) {
+            return false;
+        }
+        event.type = RenderEvent::Type::Param;
+        if (!parseFloat(words.back(), event.value)) {
+            return false;
+        }
+        words.pop_back();
+        for (size_t i = 0; i < words.size(); ++i) {
+            event.parameter += (i ? " " : "") + words[i];
+        }
+        return true;
+    }
+    return false;
+}
+
+bool isBlank(const std::string& line) {
+    const std::string content = line.substr(0, line.find('#'));
+    return content.find_first_not_of(" \t\r") == std::string::npos;
+}
+
+std::shared_ptr<SoundGenerator> addEffect(const std::string& name, std::shared_ptr<SoundGenerator> source, float sampleRate) {
+    if (name == "tremolo") return std::make_shared<Tremolo>(source, 5.0f, 0.5f);
+    if (name == "chorus") return std::make_shared<InterpolatedChorus>(source, 0.5f, 0.5f, 0.5f, sampleRate);
+    if (name == "delay") return std::make_shared<Delay>(source, static_cast<int>(sampleRate * 0.3f), 0.4f, 0.3f, sampleRate);
+    if (name == "reverb") return std::make_shared<Reverb>(source, 0.7f, 0.5f, 0.3f, 0.7f, sampleRate);
+    if (name == "lowpass") return std::make_shared<LowPassFilter>(source, 2000.0f, sampleRate);
+    if (name == "highpass") return std::make_shared<HighPassFilter>(source, 100.0f, sampleRate);
+    return nullptr;
+}
+
+bool parseOptions(int argc, char* argv[], RenderOptions& options) {
+    if (argc < 2) {
+        return false;
+    }
+    options.preset = argv[1];
+    for (int i = 2; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--script" && hasValue) {
+            std::ifstream file(argv[++i]);
+            if (!file) {
+                std::cerr << "Cannot read script " << argv[i] << std::endl;
+                return false;
+            }
+            for (std::string line; std::getline(file, line);) {
+                options.scriptLines.push_back(line);
+            }
+        } else if (arg == "--event" && hasValue) {
+            options.scriptLines.push_back(argv[++i]);
+        } else if (arg == "--effect" && hasValue) {
+            options.effects.push_back(argv[++i]);
+        } else if (arg == "--out" && hasValue) {
+            options.outputPath = argv[++i];
+        } else if (arg == "--seconds" && hasValue) {
+            if (!parseFloat(argv[++i], options.seconds) || options.seconds < 0.0f) {
+                std::cerr << "Bad --seconds: " << argv[i] << std::endl;
+                return false;
+            }
+        } else if (arg == "--sample-rate" && hasValue) {
+            if (!parseFloat(argv[++i], options.sampleRate) || options.sampleRate <= 0.0f) {
+                std::cerr << "Bad --sample-rate: " << argv[i] << std::endl;
+                return false;
+            }
+        } else if (arg == "--block" && hasValue) {
+            unsigned long frames = 0;
+            if (!parseUnsigned(argv[++i], frames) || frames == 0) {
+                std::cerr << "Bad --block: " << argv[i] << std::endl;
+                return false;
+            }
+            options.blockFrames = std::min<size_t>(frames, MAX_BLOCK_FRAMES);
+        } else if (arg == "--threads" && hasValue) {
+            unsigned long threads = 0;
+            if (!parseUnsigned(argv[++i], threads) || threads == 0) {
+                std::cerr << "Bad --threads: " << argv[i] << std::endl;
+                return false;
+            }
+            options.threads = static_cast<unsigned>(threads);
+        } else if (arg == "--dynamic") {
+            options.dynamic = true;
+        } else if (arg == "--verbose") {
+            options.verbose = true;
+        } else if (arg == "--profile" && hasValue) {
+            options.profilePath = argv[++i];
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+Parameter* findParameter(SoundGenerator& root, const std::string& name) {
+    for (Parameter* param : root.getParameters()) {
+        if (param->getName() == name) {
+            return param;
+        }
+    }
+    return nullptr;
+}
+
+int main(int argc, char* argv[]) {
+    RenderOptions options;
+    if (!parseOptions(argc, argv, options)) {
+        std::cerr << "Usage: render <preset> [--script file] [--event \"<time> on|off|param ...\"]... "
+                     "[--effect tremolo|chorus|delay|reverb|lowpass|highpass]... [--seconds N] "
+                     "[--sample-rate Hz] [--block frames] [--threads N] [--out file.wav] [--dynamic] [--verbose] [--profile file.json]" << std::endl;
+        return 1;
+    }
+
+    std::vector<RenderEvent> events;
+    for (size_t i = 0; i < options.scriptLines.size(); ++i) {
+        const std::string& line = options.scriptLines[i];
+        if (isBlank(line)) {
+            continue;
+        }
+        RenderEvent event;
+        if (!parseEvent(line, options.sampleRate, event)) {
+            // Lines are numbered across all --script files and --event options, in order
+            std::cerr << "Bad event on line " << i + 1 << ": " << line << std::endl;
+            return 1;
+        }
+        events.push_back(event);
+    }
+    std::stable_sort(events.begin(), events.end(),
+                     [](const RenderEvent& a, const RenderEvent& b) { return a.frame < b.frame; });
+
+    uint64_t totalFrames = static_cast<uint64_t>(options.seconds * options.sampleRate);
+    if (totalFrames == 0) {
+        totalFrames = (events.empty() ? 0 : events.back().frame) + static_cast<uint64_t>(TAIL_SECONDS * options.sampleRate);
+    }
+
+    VoiceGeneratorRepository voiceRepo;
+    if (options.dynamic) {
+        loadDynamicPresets(voiceRepo);
+    } else {
+        loadPresets(voiceRepo);
+    }
+
+    std::shared_ptr<ActiveTones> activeTones;
+    std::shared_ptr<SoundGenerator> chain;
+    {
+        std::unique_ptr<QuietCout> quiet(options.verbose ? nullptr : new QuietCout());
+        try {
+            activeTones = std::make_shared<ActiveTones>(voiceRepo.getVoiceGenerator(options.preset));
+        } catch (const std::runtime_error& e) {
+            std::cerr << e.what() << std::endl;
+            return 1;
+        }
+        const SimdVoiceSpec* simdSpec = options.dynamic ? nullptr : voiceRepo.getSimdVoiceSpec(options.preset);
+        if (simdSpec) {
+            activeTones->setSimdVoiceGenerator(*simdSpec);
+        }
+        activeTones->setRenderThreads(options.threads);
+        chain = activeTones;
+        for (const auto& name : options.effects) {
+            chain = addEffect(name, chain, options.sampleRate);
+            if (!chain) {
+                std::cerr << "Unknown effect: " << name << std::endl;
+                return 1;
+            }
+        }
+    }
+
+    // Parameters are resolved up front so a typo fails before rendering
+    std::vector<Parameter*> eventParameters(events.size(), nullptr);
+    for (size_t i = 0; i < events.size(); ++i) {
+        if (events[i].type == RenderEvent::Type::Param) {
+            // Effects list their own parameters; the preset's are in its registry
+            eventParameters[i] = findParameter(*chain, events[i].parameter);
+            if (!eventParameters[i]) {
+                eventParameters[i] = activeTones->getParameterRegistry()->get(events[i].parameter);
+            }
+            if (!eventParameters[i]) {
+                std::cerr << "Unknown parameter: " << events[i].parameter << std::endl;
+                return 1;
+            }
+        }
+    }
+
+    WavFileAudioBackend output(options.outputPath, totalFrames);
+    AudioStreamConfig config;
+    config.sampleRate = options.sampleRate;
+    config.blockFrames = options.blockFrames;
+    if (!output.open(config)) {
+        return 1;
+    }
+
+    // Blocks are split at event frames, so notes start on their exact sample
+    uint64_t frame = 0;
+    size_t nextEvent = 0;
+    std::unique_ptr<QuietCout> quiet(options.verbose ? nullptr : new QuietCout());
+    NodeProfiler::instance().setEnabled(!options.profilePath.empty());
+    const auto start = std::chrono::steady_clock::now();
+    output.run([&](float* out, size_t frames, int) {
+        size_t rendered = 0;
+        while (rendered < frames) {
+            for (; nextEvent < events.size() && events[nextEvent].frame <= frame; ++nextEvent) {
+                const RenderEvent& event = events[nextEvent];
+                switch (event.type) {
+                case RenderEvent::Type::NoteOn:
+                    activeTones->pushNoteEvent({NoteEvent::Type::NoteOn, static_cast<uint8_t>(event.note), event.value, 0});
+                    break;
+                case RenderEvent::Type::NoteOff:
+                    activeTones->pushNoteEvent({NoteEvent::Type::NoteOff, static_cast<uint8_t>(event.note), 0.0f, 0});
+                    break;
+                case RenderEvent::Type::Param:
+                    eventParameters[nextEvent]->requestValue(event.value);
+                    break;
+                }
+            }
+            size_t length = frames - rendered;
+            if (nextEvent < events.size()) {
+                length = static_cast<size_t>(std::min<uint64_t>(length, events[nextEvent].frame - frame));
+            }
+            // Same path as AudioEngine::renderBlock: parameter changes, then soft clipping
+            applyParameterChanges();
+            chain->render(out + rendered, length, options.sampleRate);
+            for (size_t i = rendered; i < rendered + length; ++i) {
+                out[i] = std::tanh(out[i]);
+            }
+            rendered += length;
+            frame += length;
+        }
+    });
+    const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    quiet.reset();
+
+    const double audioSeconds = totalFrames / options.sampleRate;
+    std::cout << "Rendered " << options.preset << ": " << events.size() << " events, " << std::fixed
+              << std::setprecision(2) << audioSeconds << " s at " << options.sampleRate << " Hz to "
+              << options.outputPath << std::endl
+              << "Wall time " << std::setprecision(3) << elapsed << " s, real-time factor "
+              << std::setprecision(1) << audioSeconds / std::max(elapsed, 1e-9) << "x" << std::endl;
+
+    if (!options.profilePath.empty()) {
+        NodeProfiler::instance().setEnabled(false);
+        std::ofstream profile(options.profilePath);
+        profile << NodeProfiler::instance().toJSON() << std::endl;
+        std::cout << "Node profile written to " << options.profilePath << std::endl;
+    }
+    return 0;
+}